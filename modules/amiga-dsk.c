@@ -793,4 +793,5 @@ void de_module_amiga_adf(deark *c, struct deark_module_info *mi)
 	mi->desc = "Amiga disk image";
 	mi->run_fn = de_run_amiga_adf;
 	mi->identify_fn = de_identify_amiga_adf;
+	de_module_add_sig(c, mi, 0, "DOS", 3, 0);
 }
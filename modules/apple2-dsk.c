@@ -220,4 +220,5 @@ void de_module_woz(deark *c, struct deark_module_info *mi)
 	mi->desc2 = "metadata only";
 	mi->run_fn = de_run_woz;
 	mi->identify_fn = de_identify_woz;
+	de_module_add_sig(c, mi, 0, "WOZ", 3, 0);
 }
@@ -173,17 +173,10 @@ static void de_run_ar(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_ar(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "!<arch>\x0a", 8))
-		return 100;
-	return 0;
-}
-
 void de_module_ar(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "ar";
 	mi->desc = "ar archive";
 	mi->run_fn = de_run_ar;
-	mi->identify_fn = de_identify_ar;
+	de_module_add_sig(c, mi, 0, "!<arch>\x0a", 8, 100);
 }
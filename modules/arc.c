@@ -537,6 +537,7 @@ static void do_extract_member_file(deark *c, lctx *d, struct member_data *md,
 	}
 
 	outf = dbuf_create_output_file(c, NULL, fi, 0x0);
+	if(dbuf_output_is_skipped(outf)) goto done;
 
 	dbuf_set_writelistener(outf, our_writelistener_cb, (void*)d->crco);
 	de_crcobj_reset(d->crco);
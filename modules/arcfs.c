@@ -412,13 +412,6 @@ done:
 	}
 }
 
-static int de_identify_arcfs(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "Archive\x00", 8))
-		return 100;
-	return 0;
-}
-
 static void de_help_arcfs(deark *c)
 {
 	de_msg(c, "-opt arcfs:appendtype : Append the file type to the filename");
@@ -429,7 +422,7 @@ void de_module_arcfs(deark *c, struct deark_module_info *mi)
 	mi->id = "arcfs";
 	mi->desc = "ArcFS (RISC OS archive)";
 	mi->run_fn = de_run_arcfs;
-	mi->identify_fn = de_identify_arcfs;
+	de_module_add_sig(c, mi, 0, "Archive\x00", 8, 100);
 	mi->help_fn = de_help_arcfs;
 }
 
@@ -530,17 +523,10 @@ static void de_run_squash(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_squash(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "SQSH", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_squash(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "squash";
 	mi->desc = "Squash (RISC OS compressed file)";
 	mi->run_fn = de_run_squash;
-	mi->identify_fn = de_identify_squash;
+	de_module_add_sig(c, mi, 0, "SQSH", 4, 100);
 }
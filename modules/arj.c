@@ -170,28 +170,10 @@ static void get_flags_descr(struct member_data *md, u8 n1, de_ucstring *s)
 }
 
 struct method4_ctx {
-	i64 nbytes_written;
-	int stop_flag;
 	struct de_dfilter_out_params *dcmpro;
 	struct de_bitreader bitrd;
 };
 
-static void method4_lz77buf_writebytecb(struct de_lz77buffer *rb, const u8 n)
-{
-	struct method4_ctx *cctx = (struct method4_ctx*)rb->userdata;
-
-	if(cctx->stop_flag) return;
-	if(cctx->dcmpro->len_known) {
-		if(cctx->nbytes_written >= cctx->dcmpro->expected_len) {
-			cctx->stop_flag = 1;
-			return;
-		}
-	}
-
-	dbuf_writebyte(cctx->dcmpro->f, n);
-	cctx->nbytes_written++;
-}
-
 static UI method4_read_a_length_code(struct method4_ctx *cctx)
 {
 	UI onescount = 0;
@@ -244,17 +226,14 @@ static void decompress_method_4(deark *c, lctx *d, struct member_data *md,
 
 	// The maximum offset that can be encoded is 15871, so a 16K history is enough.
 	ringbuf = de_lz77buffer_create(c, 16384);
-	ringbuf->writebyte_cb = method4_lz77buf_writebytecb;
-	ringbuf->userdata = (void*)cctx;
+	de_lz77buffer_set_output(ringbuf, dcmpro->f, dcmpro->len_known,
+		dcmpro->expected_len);
 
 	while(1) {
 		UI len_code;
 
 		if(cctx->bitrd.eof_flag) goto done;
-		if(cctx->stop_flag) goto done;
-		if(cctx->dcmpro->len_known && (cctx->nbytes_written >= cctx->dcmpro->expected_len)) {
-			goto done;
-		}
+		if(de_lz77buffer_have_enough_output(ringbuf)) goto done;
 
 		len_code = method4_read_a_length_code(cctx);
 		if(len_code==0) {
@@ -274,6 +253,7 @@ static void decompress_method_4(deark *c, lctx *d, struct member_data *md,
 done:
 	dres->bytes_consumed_valid = 1;
 	dres->bytes_consumed = cctx->bitrd.curpos - dcmpri->pos;
+	de_lz77buffer_flush(ringbuf);
 	de_lz77buffer_destroy(c, ringbuf);
 	de_free(c, cctx);
 }
@@ -353,6 +333,7 @@ static void extract_member_file(deark *c, lctx *d, struct member_data *md)
 	outf = dbuf_create_output_file(c, NULL, fi, 0);
 
 	if(is_dir) goto done;
+	if(dbuf_output_is_skipped(outf)) goto done;
 
 	de_dfilter_init_objects(c, &dcmpri, &dcmpro, &dres);
 	dcmpri.f = c->infile;
@@ -799,5 +780,6 @@ void de_module_arj(deark *c, struct deark_module_info *mi)
 	mi->desc = "ARJ";
 	mi->run_fn = de_run_arj;
 	mi->identify_fn = de_identify_arj;
+	de_module_add_sig(c, mi, 0, "\x60\xea", 2, 0);
 	mi->help_fn = de_help_arj;
 }
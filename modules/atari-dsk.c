@@ -972,13 +972,6 @@ done:
 	}
 }
 
-static int de_identify_pasti(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "RSY\0", 4))
-		return 100;
-	return 0;
-}
-
 static void de_help_pasti(deark *c)
 {
 	de_msg(c, "-opt pasti:toraw : Extract to raw .ST format");
@@ -989,6 +982,6 @@ void de_module_pasti(deark *c, struct deark_module_info *mi)
 	mi->id = "pasti";
 	mi->desc = "Pasti - Atari ST floppy disk image format";
 	mi->run_fn = de_run_pasti;
-	mi->identify_fn = de_identify_pasti;
+	de_module_add_sig(c, mi, 0, "RSY\0", 4, 100);
 	mi->help_fn = de_help_pasti;
 }
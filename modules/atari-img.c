@@ -403,19 +403,12 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_prismpaint(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "PNT\x00", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_prismpaint(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "prismpaint";
 	mi->desc = "Atari Prism Paint .PNT, a.k.a. TruePaint .TPI";
 	mi->run_fn = de_run_prismpaint;
-	mi->identify_fn = de_identify_prismpaint;
+	de_module_add_sig(c, mi, 0, "PNT\x00", 4, 100);
 }
 
 // **************************************************************************
@@ -532,20 +525,12 @@ static void de_run_indypaint(deark *c, de_module_params *mparams)
 	de_free(c, adata);
 }
 
-static int de_identify_indypaint(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "Indy", 4)) {
-		return 70;
-	}
-	return 0;
-}
-
 void de_module_indypaint(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "indypaint";
 	mi->desc = "Atari IndyPaint .TRU";
 	mi->run_fn = de_run_indypaint;
-	mi->identify_fn = de_identify_indypaint;
+	de_module_add_sig(c, mi, 0, "Indy", 4, 70);
 }
 
 // **************************************************************************
@@ -1131,20 +1116,12 @@ done:
 	de_free(c, adata);
 }
 
-static int de_identify_neochrome_ani(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xba\xbe\xeb\xea", 4)) {
-		return 100;
-	}
-	return 0;
-}
-
 void de_module_neochrome_ani(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "neochrome_ani";
 	mi->desc = "NEOchrome Animation";
 	mi->run_fn = de_run_neochrome_ani;
-	mi->identify_fn = de_identify_neochrome_ani;
+	de_module_add_sig(c, mi, 0, "\xba\xbe\xeb\xea", 4, 100);
 	mi->flags |= DE_MODFLAG_NONWORKING;
 }
 
@@ -1206,14 +1183,6 @@ done:
 	de_free(c, adata);
 }
 
-static int de_identify_animatic(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 48, "\x27\x18\x28\x18", 4)) {
-		return 100;
-	}
-	return 0;
-}
-
 static void de_help_animatic(deark *c)
 {
 	fmtutil_atari_help_palbits(c);
@@ -1224,7 +1193,7 @@ void de_module_animatic(deark *c, struct deark_module_info *mi)
 	mi->id = "animatic";
 	mi->desc = "Animatic Film";
 	mi->run_fn = de_run_animatic;
-	mi->identify_fn = de_identify_animatic;
+	de_module_add_sig(c, mi, 48, "\x27\x18\x28\x18", 4, 100);
 	mi->help_fn = de_help_animatic;
 }
 
@@ -1234,10 +1203,10 @@ void de_module_animatic(deark *c, struct deark_module_info *mi)
 
 static void decode_falcon_8bit_image(deark *c, struct atari_img_decode_data *adata, i64 pos)
 {
-	i64 i, j, k;
-	unsigned int v;
-	unsigned int n;
+	i64 j;
 	de_finfo *fi = NULL;
+	u8 *rowbuf_src = NULL;
+	u8 *rowbuf_idx = NULL;
 
 	adata->img = de_bitmap_create(c, adata->w, adata->h, 3);
 
@@ -1248,21 +1217,23 @@ static void decode_falcon_8bit_image(deark *c, struct atari_img_decode_data *ada
 		fi->density.ydens = 200.0;
 	}
 
+	// 8 planes, interleaved in 16-bit words, so each row is w bytes.
+	rowbuf_src = de_malloc(c, adata->w);
+	rowbuf_idx = de_malloc(c, adata->w);
 	for(j=0; j<adata->h; j++) {
-		for(i=0; i<adata->w; i++) {
-			v = 0;
-			for(k=0; k<8; k++) {
-				n = (u32)de_getu16be(pos+j*adata->w + (i-i%16) +2*k);
-				if(n&(1<<(15-i%16))) v |= 1<<k;
-			}
-			de_bitmap_setpixel_rgb(adata->img, i, j, adata->pal[v]);
-		}
+		const u8 *src;
+
+		src = dbuf_borrow(c->infile, pos+j*adata->w, adata->w, rowbuf_src);
+		fmtutil_planar_to_chunky(src, adata->w, 8, 2, 2, 16, rowbuf_idx, 1);
+		de_convert_row_paletted_mem(rowbuf_idx, 8, adata->pal, adata->img, j, 0);
 	}
 
 	de_bitmap_write_to_file_finfo(adata->img, fi, 0);
 	de_bitmap_destroy(adata->img);
 	adata->img = NULL;
 	de_finfo_destroy(c, fi);
+	de_free(c, rowbuf_src);
+	de_free(c, rowbuf_idx);
 }
 
 static void do_atari_falcon_8bit_img(deark *c, i64 width, i64 height)
@@ -1477,18 +1448,10 @@ static void de_run_coke(deark *c, de_module_params *mparams)
 	de_finfo_destroy(c, fi);
 }
 
-static int de_identify_coke(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, (const void*)"COKE format.", 12)) {
-		return 100;
-	}
-	return 0;
-}
-
 void de_module_coke(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "coke";
 	mi->desc = "Atari Falcon COKE image (.TG1)";
 	mi->run_fn = de_run_coke;
-	mi->identify_fn = de_identify_coke;
+	de_module_add_sig(c, mi, 0, "COKE format.", 12, 100);
 }
@@ -384,13 +384,6 @@ done:
 	free_lctx(c, d);
 }
 
-static int de_identify_xbin(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "XBIN\x1a", 5))
-		return 100;
-	return 0;
-}
-
 static void de_help_xbin(deark *c)
 {
 	de_msg(c, "-opt char:output=html : Write HTML instead of an image file");
@@ -402,7 +395,7 @@ void de_module_xbin(deark *c, struct deark_module_info *mi)
 	mi->id = "xbin";
 	mi->desc = "XBIN character graphics";
 	mi->run_fn = de_run_xbin;
-	mi->identify_fn = de_identify_xbin;
+	de_module_add_sig(c, mi, 0, "XBIN\x1a", 5, 100);
 	mi->help_fn = de_help_xbin;
 }
 
@@ -673,19 +666,11 @@ static void de_run_icedraw(deark *c, de_module_params *mparams)
 	de_err(c, "iCEDraw format is not supported");
 }
 
-static int de_identify_icedraw(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x04\x31\x2e\x34", 4)) {
-		return 100;
-	}
-	return 0;
-}
-
 void de_module_icedraw(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "icedraw";
 	mi->desc = "iCEDraw character graphics format";
 	mi->run_fn = de_run_icedraw;
-	mi->identify_fn = de_identify_icedraw;
+	de_module_add_sig(c, mi, 0, "\x04\x31\x2e\x34", 4, 100);
 	mi->flags |= DE_MODFLAG_NONWORKING;
 }
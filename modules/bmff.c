@@ -1774,13 +1774,6 @@ static void de_run_bmff(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_jpeg2000(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x00\x00\x00\x0c\x6a\x50\x20\x20\x0d\x0a\x87\x0a", 12))
-		return 100;
-	return 0;
-}
-
 static void de_help_bmff(deark *c)
 {
 	de_msg(c, "-opt bmff:maxentries=<n> : Number of sample table entries to print with -d");
@@ -1792,7 +1785,7 @@ void de_module_jpeg2000(deark *c, struct deark_module_info *mi)
 	mi->desc = "JPEG 2000 image";
 	mi->desc2 = "resources only";
 	mi->run_fn = de_run_bmff;
-	mi->identify_fn = de_identify_jpeg2000;
+	de_module_add_sig(c, mi, 0, "\x00\x00\x00\x0c\x6a\x50\x20\x20\x0d\x0a\x87\x0a", 12, 100);
 }
 
 static int de_identify_bmff(deark *c)
@@ -297,17 +297,10 @@ done:
 	}
 }
 
-static int de_identify_bmi(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "ZonerBMIa", 9))
-		return 100;
-	return 0;
-}
-
 void de_module_bmi(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "bmi";
 	mi->desc = "Zoner BMI bitmap";
 	mi->run_fn = de_run_bmi;
-	mi->identify_fn = de_identify_bmi;
+	de_module_add_sig(c, mi, 0, "ZonerBMIa", 9, 100);
 }
@@ -402,17 +402,10 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_cab(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "MSCF", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_cab(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "cab";
 	mi->desc = "Microsoft Cabinet (CAB)";
 	mi->run_fn = de_run_cab;
-	mi->identify_fn = de_identify_cab;
+	de_module_add_sig(c, mi, 0, "MSCF", 4, 100);
 }
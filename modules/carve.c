@@ -0,0 +1,210 @@
+// This file is part of Deark.
+// Copyright (C) 2020 Jason Summers
+// See the file COPYING for terms of use.
+
+// Extract embedded files of several formats from arbitrary data, by searching
+// for all their signatures in a single pass.
+
+#include <deark-config.h>
+#include <deark-private.h>
+#include <deark-fmtutil.h>
+DE_DECLARE_MODULE(de_module_carve);
+
+typedef struct localctx_struct {
+	i64 num_extracted;
+
+	// Cached result of the most recent search for a ZIP end-of-central-
+	// directory record. If zip_eocd_search_done is set, then the first one at
+	// or after zip_eocd_search_start is at zip_eocd_pos (or there is none, if
+	// !zip_eocd_found).
+	u8 zip_eocd_search_done;
+	u8 zip_eocd_found;
+	i64 zip_eocd_search_start;
+	i64 zip_eocd_pos;
+} lctx;
+
+// Decides whether a file of a given format starts at pos, and if so, how long
+// it is. Returns 0 if it doesn't seem to be valid.
+typedef int (*carve_len_fn)(deark *c, lctx *d, i64 pos, i64 *plen,
+	const char **pext);
+
+struct carve_fmt_info {
+	const char *name;
+	const char *sig;
+	i64 sig_len;
+	carve_len_fn len_fn;
+};
+
+static int carve_jpeg(deark *c, lctx *d, i64 pos, i64 *plen, const char **pext)
+{
+	u8 is_jpegls = 0;
+
+	if(!fmtutil_find_jpeg_len(c, c->infile, pos, c->infile->len-pos, plen,
+		&is_jpegls))
+	{
+		return 0;
+	}
+	*pext = is_jpegls ? "jls" : "jpg";
+	return 1;
+}
+
+static int carve_png(deark *c, lctx *d, i64 pos, i64 *plen, const char **pext)
+{
+	if(!fmtutil_find_png_len(c, c->infile, pos, c->infile->len-pos, plen)) return 0;
+	*pext = "png";
+	return 1;
+}
+
+static int carve_gif(deark *c, lctx *d, i64 pos, i64 *plen, const char **pext)
+{
+	if(!fmtutil_find_gif_len(c, c->infile, pos, c->infile->len-pos, plen)) return 0;
+	*pext = "gif";
+	return 1;
+}
+
+static int carve_bmp(deark *c, lctx *d, i64 pos, i64 *plen, const char **pext)
+{
+	if(!fmtutil_find_bmp_len(c, c->infile, pos, c->infile->len-pos, plen)) return 0;
+	*pext = "bmp";
+	return 1;
+}
+
+static int carve_riff(deark *c, lctx *d, i64 pos, i64 *plen, const char **pext)
+{
+	struct de_fourcc formtype;
+
+	if(!fmtutil_find_iff_len(c, c->infile, pos, c->infile->len-pos, 1, plen,
+		&formtype))
+	{
+		return 0;
+	}
+
+	switch(formtype.id) {
+	case 0x57415645U: *pext = "wav"; break; // WAVE
+	case 0x41564920U: *pext = "avi"; break; // "AVI "
+	case 0x57454250U: *pext = "webp"; break; // WEBP
+	case 0x41434f4eU: *pext = "ani"; break; // ACON
+	case 0x524d4944U: *pext = "rmi"; break; // RMID
+	default: *pext = "riff";
+	}
+	return 1;
+}
+
+static int carve_iff(deark *c, lctx *d, i64 pos, i64 *plen, const char **pext)
+{
+	struct de_fourcc formtype;
+
+	if(!fmtutil_find_iff_len(c, c->infile, pos, c->infile->len-pos, 0, plen,
+		&formtype))
+	{
+		return 0;
+	}
+
+	switch(formtype.id) {
+	case 0x41494646U: case 0x41494643U: *pext = "aiff"; break; // AIFF, AIFC
+	case 0x38535658U: *pext = "8svx"; break; // 8SVX
+	default: *pext = "iff";
+	}
+	return 1;
+}
+
+// Find the first ZIP end-of-central-directory record at or after pos.
+static int find_zip_eocd_after(deark *c, lctx *d, i64 pos, i64 *peocd_pos)
+{
+	if(!d->zip_eocd_search_done || pos < d->zip_eocd_search_start ||
+		(d->zip_eocd_found && pos > d->zip_eocd_pos))
+	{
+		d->zip_eocd_search_start = pos;
+		d->zip_eocd_found = (u8)dbuf_search(c->infile, (const u8*)"PK\x05\x06", 4,
+			pos, c->infile->len-pos, &d->zip_eocd_pos);
+		d->zip_eocd_search_done = 1;
+	}
+
+	*peocd_pos = d->zip_eocd_pos;
+	return (int)d->zip_eocd_found;
+}
+
+static int carve_zip(deark *c, lctx *d, i64 pos, i64 *plen, const char **pext)
+{
+	i64 eocd_pos;
+
+	// Remember where the EOCD record is, so that we don't search the rest of
+	// the file again for every false ZIP signature.
+	if(!find_zip_eocd_after(c, d, pos, &eocd_pos)) return 0;
+	if(!fmtutil_find_zip_len(c, c->infile, pos, c->infile->len-pos, eocd_pos, plen)) {
+		return 0;
+	}
+	*pext = "zip";
+	return 1;
+}
+
+static int carve_cfb(deark *c, lctx *d, i64 pos, i64 *plen, const char **pext)
+{
+	if(!fmtutil_find_cfb_len(c, c->infile, pos, c->infile->len-pos, plen)) return 0;
+	*pext = "cfb";
+	return 1;
+}
+
+static const struct carve_fmt_info carve_fmts[] = {
+	{ "JPEG", "\xff\xd8\xff", 3, carve_jpeg },
+	{ "PNG", "\x89\x50\x4e\x47\x0d\x0a\x1a\x0a", 8, carve_png },
+	{ "GIF", "GIF87a", 6, carve_gif },
+	{ "GIF", "GIF89a", 6, carve_gif },
+	{ "ZIP", "PK\x03\x04", 4, carve_zip },
+	{ "RIFF", "RIFF", 4, carve_riff },
+	{ "IFF", "FORM", 4, carve_iff },
+	{ "BMP", "BM", 2, carve_bmp },
+	{ "CFB", "\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1", 8, carve_cfb }
+};
+
+static void de_run_carve(deark *c, de_module_params *mparams)
+{
+	lctx *d = NULL;
+	struct de_search_needle needles[DE_ARRAYCOUNT(carve_fmts)];
+	i64 pos = 0;
+	size_t k;
+
+	d = de_malloc(c, sizeof(lctx));
+
+	for(k=0; k<DE_ARRAYCOUNT(carve_fmts); k++) {
+		needles[k].data = (const u8*)carve_fmts[k].sig;
+		needles[k].len = carve_fmts[k].sig_len;
+	}
+
+	while(pos < c->infile->len) {
+		const struct carve_fmt_info *fmt;
+		i64 foundpos = 0;
+		i64 fmt_idx = 0;
+		i64 len = 0;
+		const char *ext = NULL;
+
+		if(!dbuf_search_multi(c->infile, needles, (i64)DE_ARRAYCOUNT(carve_fmts),
+			pos, c->infile->len-pos, &foundpos, &fmt_idx))
+		{
+			break;
+		}
+		fmt = &carve_fmts[fmt_idx];
+
+		if(fmt->len_fn(c, d, foundpos, &len, &ext) && len>0) {
+			de_dbg(c, "%s file at %"I64_FMT", len=%"I64_FMT, fmt->name, foundpos, len);
+			dbuf_create_file_from_slice(c->infile, foundpos, len, ext, NULL, 0);
+			d->num_extracted++;
+			// Don't look for files embedded in files we've extracted.
+			pos = foundpos+len;
+		}
+		else {
+			de_dbg2(c, "not a valid %s file at %"I64_FMT, fmt->name, foundpos);
+			pos = foundpos+1;
+		}
+	}
+
+	de_dbg(c, "files extracted: %"I64_FMT, d->num_extracted);
+	de_free(c, d);
+}
+
+void de_module_carve(deark *c, struct deark_module_info *mi)
+{
+	mi->id = "carve";
+	mi->desc = "Extract embedded files of several formats from arbitrary data";
+	mi->run_fn = de_run_carve;
+}
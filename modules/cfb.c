@@ -1518,7 +1518,9 @@ static void do_process_stream(deark *c, lctx *d, struct dir_entry_info *dei)
 		fi_raw->original_filename_flag = 1;
 
 		outf = dbuf_create_output_file(c, NULL, fi_raw, 0);
-		copy_any_stream_to_dbuf(c, d, dei, 0, dei->stream_size, outf);
+		if(!dbuf_output_is_skipped(outf)) {
+			copy_any_stream_to_dbuf(c, d, dei, 0, dei->stream_size, outf);
+		}
 		dbuf_close(outf);
 	}
 
@@ -1882,13 +1884,6 @@ static void de_run_cfb(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_cfb(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1", 8))
-		return 100;
-	return 0;
-}
-
 static void de_help_cfb(deark *c)
 {
 	de_msg(c, "-opt cfb:extractstreams : Extract raw streams, instead of decoding");
@@ -1903,6 +1898,6 @@ void de_module_cfb(deark *c, struct deark_module_info *mi)
 	mi->id = "cfb";
 	mi->desc = "Microsoft Compound File Binary File";
 	mi->run_fn = de_run_cfb;
-	mi->identify_fn = de_identify_cfb;
+	de_module_add_sig(c, mi, 0, "\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1", 8, 100);
 	mi->help_fn = de_help_cfb;
 }
@@ -144,7 +144,6 @@ struct lzh_ctx {
 	struct de_dfilter_results *dres;
 	const char *modname;
 
-	i64 nbytes_written;
 	int err_flag;
 
 	// bitrd.eof_flag: Always set if err_flag is set.
@@ -175,27 +174,6 @@ static u64 lzh_getbits(struct lzh_ctx *cctx, UI nbits)
 	return de_bitreader_getbits(&cctx->bitrd, nbits);
 }
 
-static int lzh_have_enough_output(struct lzh_ctx *cctx)
-{
-	if(cctx->dcmpro->len_known) {
-		if(cctx->nbytes_written >= cctx->dcmpro->expected_len) {
-			return 1;
-		}
-	}
-	return 0;
-}
-
-static void lha5like_lz77buf_writebytecb(struct de_lz77buffer *rb, u8 n)
-{
-	struct lzh_ctx *cctx = (struct lzh_ctx*)rb->userdata;
-
-	if(lzh_have_enough_output(cctx)) {
-		return;
-	}
-	dbuf_writebyte(cctx->dcmpro->f, n);
-	cctx->nbytes_written++;
-}
-
 static UI read_next_code_using_tree(struct lzh_ctx *cctx, struct lzh_tree_wrapper *tree)
 {
 	i32 val = 0;
@@ -309,8 +287,8 @@ static void decompress_dms_heavy(struct lzh_ctx *cctx, struct dmslzh_params *lzh
 		hvst->ringbuf = de_lz77buffer_create(cctx->c, rb_size);
 	}
 
-	hvst->ringbuf->userdata = (void*)cctx;
-	hvst->ringbuf->writebyte_cb = lha5like_lz77buf_writebytecb;
+	de_lz77buffer_set_output(hvst->ringbuf, cctx->dcmpro->f,
+		cctx->dcmpro->len_known, cctx->dcmpro->expected_len);
 
 	if(!cctx->dcmpro->len_known) {
 		// I think we (may) have to know the output length, because zero-length Huffman
@@ -347,7 +325,7 @@ static void decompress_dms_heavy(struct lzh_ctx *cctx, struct dmslzh_params *lzh
 		UI code;
 
 		if(cctx->bitrd.eof_flag) goto done;
-		if(lzh_have_enough_output(cctx)) goto done;
+		if(de_lz77buffer_have_enough_output(hvst->ringbuf)) goto done;
 
 		code = read_next_code_using_tree(cctx, &hvst->codes_tree);
 		if(cctx->bitrd.eof_flag) goto done;
@@ -397,6 +375,7 @@ static void decompress_dms_heavy(struct lzh_ctx *cctx, struct dmslzh_params *lzh
 	}
 
 done:
+	de_lz77buffer_flush(hvst->ringbuf);
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
@@ -580,7 +559,6 @@ struct dmsmedium_params {
 struct medium_ctx {
 	deark *c;
 	struct de_dfilter_out_params *dcmpro;
-	i64 nbytes_written;
 	struct de_bitreader bitrd;
 };
 
@@ -631,23 +609,13 @@ static const u8 g_medium_d_len[16] = {
     0x05, 0x06, 0x06, 0x06, 0x07, 0x07, 0x07, 0x08
 };
 
-static int medium_have_enough_output(struct medium_ctx *mctx)
-{
-	if(mctx->dcmpro->len_known) {
-		if(mctx->nbytes_written >= mctx->dcmpro->expected_len) {
-			return 1;
-		}
-	}
-	return 0;
-}
-
 static void do_mediumlz77_internal(struct medium_ctx *mctx, struct dmsmedium_cmpr_state *mdst)
 {
 	while(1) {
 		UI n;
 
 		if(mctx->bitrd.eof_flag) break;
-		if(medium_have_enough_output(mctx)) break;
+		if(de_lz77buffer_have_enough_output(mdst->ringbuf)) break;
 
 		n = (UI)de_bitreader_getbits(&mctx->bitrd, 1);
 		if(n) {
@@ -686,17 +654,6 @@ static void do_mediumlz77_internal(struct medium_ctx *mctx, struct dmsmedium_cmp
 	de_lz77buffer_set_curpos(mdst->ringbuf, mdst->ringbuf->curpos + 66);
 }
 
-static void medium_lz77buf_writebytecb(struct de_lz77buffer *rb, u8 n)
-{
-	struct medium_ctx *mctx = (struct medium_ctx *)rb->userdata;
-
-	if(medium_have_enough_output(mctx)) {
-		return;
-	}
-	dbuf_writebyte(mctx->dcmpro->f, n);
-	mctx->nbytes_written++;
-}
-
 static void mediumlz77_codectype1(deark *c, struct de_dfilter_in_params *dcmpri,
 	struct de_dfilter_out_params *dcmpro, struct de_dfilter_results *dres,
 	void *codec_private_params)
@@ -722,14 +679,14 @@ static void mediumlz77_codectype1(deark *c, struct de_dfilter_in_params *dcmpri,
 		mdst->ringbuf = de_lz77buffer_create(c, 16*1024);
 		de_lz77buffer_set_curpos(mdst->ringbuf, 0x3fbe);
 	}
-	mdst->ringbuf->userdata = (void*)mctx;
-	mdst->ringbuf->writebyte_cb = medium_lz77buf_writebytecb;
+	de_lz77buffer_set_output(mdst->ringbuf, dcmpro->f, dcmpro->len_known,
+		dcmpro->expected_len);
 
 	do_mediumlz77_internal(mctx, mdst);
 
 	// Give the 'state' object back to the caller.
-	mdst->ringbuf->writebyte_cb = NULL;
-	mdst->ringbuf->userdata = NULL;
+	de_lz77buffer_flush(mdst->ringbuf);
+	de_lz77buffer_set_output(mdst->ringbuf, NULL, 0, 0);
 	mdparams->medium_state = mdst;
 	mdst = NULL;
 
@@ -1250,4 +1207,5 @@ void de_module_amiga_dms(deark *c, struct deark_module_info *mi)
 	mi->desc = "Amiga DMS disk image";
 	mi->run_fn = de_run_amiga_dms;
 	mi->identify_fn = de_identify_amiga_dms;
+	de_module_add_sig(c, mi, 0, "DMS!", 4, 0);
 }
@@ -414,13 +414,6 @@ done:
 	}
 }
 
-static int de_identify_dsstore(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x00\x00\x00\x01" "Bud1", 8))
-		return 100;
-	return 0;
-}
-
 static void de_help_dsstore(deark *c)
 {
 	de_msg(c, "-opt extractplist : Write plist records to files");
@@ -431,6 +424,6 @@ void de_module_dsstore(deark *c, struct deark_module_info *mi)
 	mi->id = "dsstore";
 	mi->desc = "Mac Finder .DS_Store format";
 	mi->run_fn = de_run_dsstore;
-	mi->identify_fn = de_identify_dsstore;
+	de_module_add_sig(c, mi, 0, "\x00\x00\x00\x01" "Bud1", 8, 100);
 	mi->help_fn = de_help_dsstore;
 }
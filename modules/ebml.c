@@ -691,13 +691,6 @@ static void de_run_ebml(deark *c, de_module_params *mparams)
 	}
 }
 
-static int de_identify_ebml(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x1a\x45\xdf\xa3", 4))
-		return 100;
-	return 0;
-}
-
 static void de_help_ebml(deark *c)
 {
 	de_msg(c, "-opt ebml:encodedid : Also print element ID numbers in raw form");
@@ -708,6 +701,6 @@ void de_module_ebml(deark *c, struct deark_module_info *mi)
 	mi->id = "ebml";
 	mi->desc = "EBML";
 	mi->run_fn = de_run_ebml;
-	mi->identify_fn = de_identify_ebml;
+	de_module_add_sig(c, mi, 0, "\x1a\x45\xdf\xa3", 4, 100);
 	mi->help_fn = de_help_ebml;
 }
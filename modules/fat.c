@@ -126,6 +126,7 @@ static void do_extract_file(deark *c, lctx *d, struct member_data *md)
 	de_ucstring *fullfn = NULL;
 	i64 cur_cluster;
 	i64 nbytes_remaining;
+	int skip_data;
 
 	if(!md->is_subdir) {
 		if(md->filesize > d->num_data_region_clusters * d->bytes_per_cluster) {
@@ -147,6 +148,9 @@ static void do_extract_file(deark *c, lctx *d, struct member_data *md)
 	}
 
 	outf = dbuf_create_output_file(c, NULL, fi, 0);
+	// If the file isn't being extracted, we still follow its cluster chain,
+	// so that errors are detected the same way.
+	skip_data = dbuf_output_is_skipped(outf);
 
 	cur_cluster = md->first_cluster;
 	if(md->is_subdir) {
@@ -167,7 +171,9 @@ static void do_extract_file(deark *c, lctx *d, struct member_data *md)
 		if(c->debug_level>=3) de_dbg3(c, "cluster: %d", (int)cur_cluster);
 		dpos = clusternum_to_offset(c, d, cur_cluster);
 		nbytes_to_copy = de_min_int(d->bytes_per_cluster, nbytes_remaining);
-		dbuf_copy(c->infile, dpos, nbytes_to_copy, outf);
+		if(!skip_data) {
+			dbuf_copy(c->infile, dpos, nbytes_to_copy, outf);
+		}
 		nbytes_remaining -= nbytes_to_copy;
 		cur_cluster = (i64)d->fat_nextcluster[cur_cluster];
 	}
@@ -52,6 +52,7 @@ struct image_ctx_type {
 	i64 h;
 	int use_count;
 	int error_flag;
+	u8 change_flag; // Has the image changed since it was last written?
 	struct de_density_info density;
 	de_bitmap *img;
 	u32 pal[256];
@@ -81,6 +82,7 @@ struct localctx_struct {
 	int depth;
 	i64 aspect_x;
 	i64 aspect_y;
+	u8 opt_includedups;
 };
 
 // Caller supplies pal[256]
@@ -117,6 +119,18 @@ static void destroy_image_ctx(deark *c, struct image_ctx_type *ictx)
 	de_free(c, ictx);
 }
 
+// Set a pixel, and keep track of whether the image changed.
+static void set_pixel(struct image_ctx_type *ictx, i64 x, i64 y, UI clridx)
+{
+	de_color clr;
+
+	if(x<0 || y<0 || x>=ictx->w || y>=ictx->h) return;
+	clr = DE_SET_ALPHA(ictx->pal[clridx & 0xff], 0xff);
+	if(ictx->img->bitmap && de_bitmap_getpixel(ictx->img, x, y)==clr) return;
+	de_bitmap_setpixel_rgb(ictx->img, x, y, clr);
+	ictx->change_flag = 1;
+}
+
 static void do_sequence_of_chunks(deark *c, lctx *d, struct chunk_info_type *parent_ci,
 	i64 pos1, i64 max_nchunks);
 
@@ -146,7 +160,7 @@ static void do_chunk_rle(deark *c, lctx *d, struct chunk_info_type *ci)
 			count = (i64)256 - (i64)code;
 			for(k=0; k<count; k++) {
 				clridx = (UI)de_getbyte_p(&pos);
-				de_bitmap_setpixel_rgb(ictx->img, xpos, ypos, ictx->pal[clridx]);
+				set_pixel(ictx, xpos, ypos, clridx);
 				xpos++;
 			}
 		}
@@ -154,7 +168,7 @@ static void do_chunk_rle(deark *c, lctx *d, struct chunk_info_type *ci)
 			count = (i64)code;
 			clridx = (UI)de_getbyte_p(&pos);
 			for(k=0; k<count; k++) {
-				de_bitmap_setpixel_rgb(ictx->img, xpos, ypos, ictx->pal[clridx]);
+				set_pixel(ictx, xpos, ypos, clridx);
 				xpos++;
 			}
 		}
@@ -211,7 +225,7 @@ static void do_chunk_delta_fli(deark *c, lctx *d, struct chunk_info_type *ci)
 				count = (i64)code;
 				for(k=0; k<count; k++) {
 					clridx = (UI)de_getbyte_p(&pos);
-					de_bitmap_setpixel_rgb(ictx->img, xpos, ypos, ictx->pal[clridx]);
+					set_pixel(ictx, xpos, ypos, clridx);
 					xpos++;
 				}
 			}
@@ -219,7 +233,7 @@ static void do_chunk_delta_fli(deark *c, lctx *d, struct chunk_info_type *ci)
 				clridx = (UI)de_getbyte_p(&pos);
 				count = (i64)256 - (i64)code;
 				for(k=0; k<count; k++) {
-					de_bitmap_setpixel_rgb(ictx->img, xpos, ypos, ictx->pal[clridx]);
+					set_pixel(ictx, xpos, ypos, clridx);
 					xpos++;
 				}
 			}
@@ -271,7 +285,7 @@ static void do_chunk_delta_flc(deark *c, lctx *d, struct chunk_info_type *ci)
 				// Set the "last byte of current line".
 				// (UNTESTED) This feature is only expected to be used if the
 				// screen width is odd, and I haven't found such a file.
-				de_bitmap_setpixel_rgb(ictx->img, ictx->w-1, ypos, ictx->pal[wcode & 0x00ff]);
+				set_pixel(ictx, ictx->w-1, ypos, wcode & 0x00ff);
 			}
 		}
 
@@ -290,7 +304,7 @@ static void do_chunk_delta_flc(deark *c, lctx *d, struct chunk_info_type *ci)
 				count = 2 * (i64)code;
 				for(k=0; k<count; k++) {
 					clridx = (UI)de_getbyte_p(&pos);
-					de_bitmap_setpixel_rgb(ictx->img, xpos, ypos, ictx->pal[clridx]);
+					set_pixel(ictx, xpos, ypos, clridx);
 					xpos++;
 				}
 			}
@@ -299,9 +313,9 @@ static void do_chunk_delta_flc(deark *c, lctx *d, struct chunk_info_type *ci)
 				clridx = (UI)de_getbyte_p(&pos);
 				clridx2 = (UI)de_getbyte_p(&pos);
 				for(k=0; k<count; k++) {
-					de_bitmap_setpixel_rgb(ictx->img, xpos, ypos, ictx->pal[clridx]);
+					set_pixel(ictx, xpos, ypos, clridx);
 					xpos++;
-					de_bitmap_setpixel_rgb(ictx->img, xpos, ypos, ictx->pal[clridx2]);
+					set_pixel(ictx, xpos, ypos, clridx2);
 					xpos++;
 				}
 			}
@@ -319,6 +333,7 @@ static void do_chunk_copy(deark *c, lctx *d, struct chunk_info_type *ci)
 {
 	if(!ci->ictx) return;
 	ci->ictx->use_count++;
+	ci->ictx->change_flag = 1;
 	de_convert_image_paletted(c->infile, ci->pos, 8, ci->ictx->w, ci->ictx->pal,
 		ci->ictx->img, 0);
 }
@@ -327,6 +342,7 @@ static void do_chunk_copy(deark *c, lctx *d, struct chunk_info_type *ci)
 static void do_chunk_black(deark *c, lctx *d, struct chunk_info_type *ci)
 {
 	if(!ci->ictx) return;
+	ci->ictx->change_flag = 1;
 	de_bitmap_rect(ci->ictx->img, 0, 0, ci->ictx->w, ci->ictx->h,
 		ci->ictx->pal[0], 0);
 }
@@ -554,10 +570,16 @@ static void do_chunk_frame(deark *c, lctx *d, struct chunk_info_type *ci)
 				goto done;
 			}
 
+			if(!ci->ictx->change_flag && frame_idx>0 && !d->opt_includedups) {
+				de_dbg(c, "[suppressing duplicate frame]");
+				goto done;
+			}
+
 			fi = de_finfo_create(c);
 			fi->density = ci->ictx->density;
 			fi->internal_mod_time = d->mod_timestamp;
 			de_bitmap_write_to_file_finfo(ci->ictx->img, fi, 0);
+			ci->ictx->change_flag = 0;
 		}
 	}
 
@@ -856,6 +878,7 @@ static void de_run_fli(deark *c, de_module_params *mparams)
 	i64 bytes_consumed = 0;
 
 	d = de_malloc(c, sizeof(lctx));
+	d->opt_includedups = (u8)de_get_ext_option_bool(c, "fli:includedups", 0);
 
 	(void)do_chunk(c, d, NULL, 0, c->infile->len, 0, &bytes_consumed);
 
@@ -881,10 +904,16 @@ static int de_identify_fli(deark *c)
 	return 0;
 }
 
+static void de_help_fli(deark *c)
+{
+	de_msg(c, "-opt fli:includedups : Do not suppress duplicate frames");
+}
+
 void de_module_fli(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "fli";
 	mi->desc = "FLI/FLC animation";
 	mi->run_fn = de_run_fli;
 	mi->identify_fn = de_identify_fli;
+	mi->help_fn = de_help_fli;
 }
@@ -48,7 +48,9 @@ struct gif_image_data {
 	struct de_dfilter_ctx *dfctx;
 	i64 local_color_table_size;
 	u16 *interlace_map;
+	u8 *rowbuf; // Palette indices of the row currently being decoded
 	de_color local_ct[256];
+	de_color pal[256]; // The effective palette, including transparency
 };
 
 struct subblock_reader_data {
@@ -123,44 +125,60 @@ static void do_read_subblocks_p(deark *c, lctx *d, dbuf *inf,
 	}
 }
 
-static void do_record_pixel(deark *c, lctx *d, struct gif_image_data *gi, unsigned int coloridx,
-	i64 offset)
+// Figure out the palette to use for the current image, including the
+// transparent color.
+static void make_image_palette(deark *c, lctx *d, struct gif_image_data *gi)
 {
-	i64 pixnum;
-	i64 xi, yi;
-	i64 yi1;
-	de_color clr;
+	UI k;
 
-	if(coloridx>255) return;
+	for(k=0; k<256; k++) {
+		if(gi->has_local_color_table && k<gi->local_color_table_size) {
+			gi->pal[k] = gi->local_ct[k];
+		}
+		else {
+			gi->pal[k] = d->global_ct[k];
+		}
 
-	pixnum = gi->pixels_set + offset;
-	xi = pixnum%gi->width;
-	yi1 = pixnum/gi->width;
-	if(gi->interlace_map && yi1<gi->height) {
-		yi = gi->interlace_map[yi1];
-	}
-	else {
-		yi = yi1;
+		if(d->gce && d->gce->trns_color_idx_valid &&
+			(d->gce->trns_color_idx == k))
+		{
+			// Make this color transparent
+			gi->pal[k] = DE_SET_ALPHA(gi->pal[k], 0);
+		}
+		else {
+			gi->pal[k] = DE_SET_ALPHA(gi->pal[k], 0xff);
+		}
 	}
+}
 
-	if(gi->has_local_color_table && coloridx<gi->local_color_table_size) {
-		clr = gi->local_ct[coloridx];
-	}
-	else {
-		clr = d->global_ct[coloridx];
+// Returns the row number in the image of the given row of the pixel stream.
+static i64 get_image_rownum(struct gif_image_data *gi, i64 yi1)
+{
+	if(gi->interlace_map && yi1<gi->height) {
+		return gi->interlace_map[yi1];
 	}
+	return yi1;
+}
 
-	if(d->gce && d->gce->trns_color_idx_valid &&
-		(d->gce->trns_color_idx == coloridx))
-	{
-		// Make this pixel transparent
-		clr = DE_SET_ALPHA(clr, 0);
+// Write the pixels in gi->rowbuf to the image.
+// npixels is normally the image width, but can be less for the last row
+// of a truncated image.
+static void flush_pixel_row(deark *c, lctx *d, struct gif_image_data *gi,
+	i64 yi1, i64 npixels)
+{
+	i64 yi;
+
+	yi = get_image_rownum(gi, yi1);
+	if(npixels>=gi->width) {
+		de_convert_row_paletted_mem(gi->rowbuf, 8, gi->pal, gi->img, yi, 0);
 	}
 	else {
-		clr = DE_SET_ALPHA(clr, 0xff);
-	}
+		i64 xi;
 
-	de_bitmap_setpixel_rgb(gi->img, xi, yi, clr);
+		for(xi=0; xi<npixels; xi++) {
+			de_bitmap_setpixel_rgba(gi->img, xi, yi, gi->pal[(UI)gi->rowbuf[xi]]);
+		}
+	}
 }
 
 static int do_read_header(deark *c, lctx *d, i64 pos)
@@ -901,14 +919,25 @@ struct my_giflzw_userdata {
 static void my_giflzw_write_cb(dbuf *f, void *userdata,
 	const u8 *buf, i64 size)
 {
-	i64 i;
+	i64 i = 0;
 	struct my_giflzw_userdata *u = (struct my_giflzw_userdata*)userdata;
+	struct gif_image_data *gi = u->gi;
+
+	if(!gi->rowbuf) return;
 
-	for(i=0; i<(i64)size; i++) {
-		do_record_pixel(u->c, u->d, u->gi,
-			buf[i], i);
+	// Collect the pixels one row at a time.
+	while(i < size) {
+		i64 xi, n;
+
+		xi = gi->pixels_set % gi->width;
+		n = de_min_int(size-i, gi->width-xi);
+		de_memcpy(&gi->rowbuf[xi], &buf[i], (size_t)n);
+		gi->pixels_set += n;
+		i += n;
+		if(xi+n >= gi->width) {
+			flush_pixel_row(u->c, u->d, gi, gi->pixels_set/gi->width - 1, gi->width);
+		}
 	}
-	u->gi->pixels_set += (i64)size;
 }
 
 static void callback_for_image_subblock(deark *c, lctx *d, struct subblock_reader_data *sbrd)
@@ -1002,6 +1031,11 @@ static int do_image_internal(deark *c, lctx *d,
 		do_create_interlace_map(c, d, gi);
 	}
 
+	make_image_palette(c, d, gi);
+	if(!gi->failure_flag) {
+		gi->rowbuf = de_malloc(c, gi->width);
+	}
+
 	npixels_total = gi->width * gi->height;
 
 	de_dfilter_init_objects(c, NULL, &dcmpro, &dres);
@@ -1031,6 +1065,11 @@ static int do_image_internal(deark *c, lctx *d,
 
 	de_dfilter_finish(gi->dfctx);
 
+	if(gi->rowbuf && (gi->pixels_set % gi->width)) {
+		// Partial last row
+		flush_pixel_row(c, d, gi, gi->pixels_set/gi->width, gi->pixels_set % gi->width);
+	}
+
 	if(dres.errcode) {
 		de_err(c, "Decompression failed: %s", de_dfilter_get_errmsg(c, &dres));
 		goto done;
@@ -1091,6 +1130,9 @@ static int do_image(deark *c, lctx *d, i64 pos1, i64 *bytesused)
 			0, 0, d->screen_img->width, d->screen_img->height,
 			gi->xpos, gi->ypos, DE_BITMAPFLAG_MERGE);
 
+		// Pixels from earlier frames may not be in this palette, but that's
+		// usually okay.
+		de_bitmap_set_palette_hint(d->screen_img, gi->pal, 256);
 		de_bitmap_write_to_file_finfo(d->screen_img, d->fi, DE_CREATEFLAG_OPT_IMAGE);
 
 		if(disposal_method == DISPOSE_BKGD) {
@@ -1104,6 +1146,7 @@ static int do_image(deark *c, lctx *d, i64 pos1, i64 *bytesused)
 		}
 	}
 	else {
+		de_bitmap_set_palette_hint(gi->img, gi->pal, 256);
 		de_bitmap_write_to_file_finfo(gi->img, d->fi, 0);
 	}
 
@@ -1112,6 +1155,7 @@ done:
 	if(gi) {
 		de_bitmap_destroy(gi->img);
 		de_free(c, gi->interlace_map);
+		de_free(c, gi->rowbuf);
 		de_free(c, gi);
 	}
 
@@ -1250,16 +1294,6 @@ done:
 	}
 }
 
-static int de_identify_gif(deark *c)
-{
-	u8 buf[6];
-
-	de_read(buf, 0, 6);
-	if(!de_memcmp(buf, "GIF87a", 6)) return 100;
-	if(!de_memcmp(buf, "GIF89a", 6)) return 100;
-	return 0;
-}
-
 static void de_help_gif(deark *c)
 {
 	de_msg(c, "-opt gif:raw : Extract individual component images");
@@ -1272,6 +1306,7 @@ void de_module_gif(deark *c, struct deark_module_info *mi)
 	mi->id = "gif";
 	mi->desc = "GIF image";
 	mi->run_fn = de_run_gif;
-	mi->identify_fn = de_identify_gif;
+	de_module_add_sig(c, mi, 0, "GIF87a", 6, 100);
+	de_module_add_sig(c, mi, 0, "GIF89a", 6, 100);
 	mi->help_fn = de_help_gif;
 }
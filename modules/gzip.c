@@ -242,22 +242,11 @@ static void de_run_gzip(deark *c, de_module_params *mparams)
 	}
 }
 
-static int de_identify_gzip(deark *c)
-{
-	u8 buf[3];
-
-	de_read(buf, 0, 3);
-	if(buf[0]==0x1f && buf[1]==0x8b) {
-		if(buf[2]==0x08) return 100;
-		return 10;
-	}
-	return 0;
-}
-
 void de_module_gzip(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "gzip";
 	mi->desc = "gzip compressed file";
 	mi->run_fn = de_run_gzip;
-	mi->identify_fn = de_identify_gzip;
+	de_module_add_sig(c, mi, 0, "\x1f\x8b\x08", 3, 100);
+	de_module_add_sig(c, mi, 0, "\x1f\x8b", 2, 10);
 }
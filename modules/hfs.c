@@ -43,6 +43,7 @@ struct nodedata {
 	int node_level;
 
 	i64 bthFNode; // Used if this is a header node
+	i64 bthNNodes; // Used if this is a header node
 
 	i64 num_offsets;
 	unsigned int *offsets;
@@ -264,8 +265,8 @@ static void do_header_node(deark *c, lctx *d, struct nodedata *nd)
 	de_dbg(c, "bthNodeSize: %"I64_FMT, n);
 	n = de_getu16be_p(&pos);
 	de_dbg(c, "bthKeyLen: %"I64_FMT, n);
-	n = de_getu32be_p(&pos);
-	de_dbg(c, "bthNNodes: %"I64_FMT, n);
+	nd->bthNNodes = de_getu32be_p(&pos);
+	de_dbg(c, "bthNNodes: %"I64_FMT, nd->bthNNodes);
 	n = de_getu32be_p(&pos);
 	de_dbg(c, "bthFree: %"I64_FMT, n);
 
@@ -830,6 +831,13 @@ static int do_catalog(deark *c, lctx *d)
 		goto done;
 	}
 
+	// Avoid having to grow the table repeatedly. Nodes are 512 bytes, so
+	// don't trust a node count that can't fit in the catalog file, or in the
+	// input file.
+	de_inthashtable_reserve(c, d->nodes_seen,
+		de_min_int(hdr_node->bthNNodes,
+		de_min_int(d->drCTFlSize, c->infile->len)/512));
+
 	// TODO: In the leaf list, is it possible/legal for a parent-dir-ID number to
 	// appear before the record for that dir-ID? I haven't seen it happen, but
 	// for all I know it is possible. If it doesn't happen, that would be good,
@@ -1819,13 +1819,6 @@ static void de_run_hlp(deark *c, de_module_params *mparams)
 	}
 }
 
-static int de_identify_hlp(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x3f\x5f\x03\x00", 4))
-		return 100;
-	return 0;
-}
-
 static void de_help_hlp(deark *c)
 {
 	de_msg(c, "-opt hlp:extracttext : Write the text (unformatted) to a file");
@@ -1837,6 +1830,6 @@ void de_module_hlp(deark *c, struct deark_module_info *mi)
 	mi->id = "hlp";
 	mi->desc = "HLP";
 	mi->run_fn = de_run_hlp;
-	mi->identify_fn = de_identify_hlp;
+	de_module_add_sig(c, mi, 0, "\x3f\x5f\x03\x00", 4, 100);
 	mi->help_fn = de_help_hlp;
 }
@@ -580,17 +580,10 @@ static void de_run_iccprofile(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_iccprofile(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 36, "acsp", 4))
-		return 85;
-	return 0;
-}
-
 void de_module_iccprofile(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "iccprofile";
 	mi->desc = "ICC profile";
 	mi->run_fn = de_run_iccprofile;
-	mi->identify_fn = de_identify_iccprofile;
+	de_module_add_sig(c, mi, 36, "acsp", 4, 85);
 }
@@ -520,4 +520,5 @@ void de_module_icns(deark *c, struct deark_module_info *mi)
 	mi->desc = "Macintosh icon";
 	mi->run_fn = de_run_icns;
 	mi->identify_fn = de_identify_icns;
+	de_module_add_sig(c, mi, 0, "icns", 4, 0);
 }
@@ -203,6 +203,10 @@ static void do_image_data(deark *c, lctx *d, struct page_ctx *pg)
 		warn_inv_bkgd(c);
 	}
 
+	if(bi.bitcount<=8) {
+		de_bitmap_set_palette_hint(img, pal, (i64)1<<bi.bitcount);
+	}
+
 	de_optimize_image_alpha(img, (bi.bitcount==32)?0x1:0x0);
 
 	fi = de_finfo_create(c);
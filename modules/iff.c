@@ -302,18 +302,10 @@ static void de_run_midi(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_midi(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "MThd", 4)) {
-		return 100;
-	}
-	return 0;
-}
-
 void de_module_midi(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "midi";
 	mi->desc = "MIDI audio";
 	mi->run_fn = de_run_midi;
-	mi->identify_fn = de_identify_midi;
+	de_module_add_sig(c, mi, 0, "MThd", 4, 100);
 }
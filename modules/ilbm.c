@@ -137,6 +137,14 @@ typedef struct localctx_struct {
 
 	struct frame_ctx *frctx; // Non-NULL means we're inside a frame
 	struct frame_ctx *oldfrctx[2];
+
+	// For animations: The most recently rendered frame, and the frame buffer
+	// and settings it was rendered from. Used to re-render only the rows that
+	// changed.
+	de_bitmap *anim_img;
+	u8 *anim_img_fb;
+	struct imgbody_info anim_img_ibi;
+	u32 anim_img_pal[256];
 	i64 pal_ncolors; // Number of colors we read from the file
 	int pal_is_grayscale;
 	u32 pal_raw[256]; // Palette as read from the file
@@ -1904,7 +1912,7 @@ static void do_ansq(deark *c, lctx *d, i64 pos1, i64 len)
 	de_dbg_indent(c, -1);
 }
 
-static void render_pixel_row_ham6(deark *c, lctx *d, i64 rownum, const u32 *rowbuf,
+static void render_pixel_row_ham6(deark *c, lctx *d, i64 rownum, const u8 *rowbuf,
 	UI rowbuf_size, de_bitmap *img)
 {
 	UI i;
@@ -1918,7 +1926,7 @@ static void render_pixel_row_ham6(deark *c, lctx *d, i64 rownum, const u32 *rowb
 
 	for(i=0; i<rowbuf_size; i++) {
 		u32 clr;
-		u8 val = rowbuf[i] & 0xff;
+		u8 val = rowbuf[i];
 
 		switch((val>>4)&0x3) {
 		case 0x1: // Modify blue value
@@ -1942,7 +1950,7 @@ static void render_pixel_row_ham6(deark *c, lctx *d, i64 rownum, const u32 *rowb
 	}
 }
 
-static void render_pixel_row_ham8(deark *c, lctx *d, i64 rownum, const u32 *rowbuf,
+static void render_pixel_row_ham8(deark *c, lctx *d, i64 rownum, const u8 *rowbuf,
 	UI rowbuf_size, de_bitmap *img)
 {
 	UI i;
@@ -1956,7 +1964,7 @@ static void render_pixel_row_ham8(deark *c, lctx *d, i64 rownum, const u32 *rowb
 
 	for(i=0; i<rowbuf_size; i++) {
 		u32 clr;
-		u8 val = rowbuf[i] & 0xff;
+		u8 val = rowbuf[i];
 
 		switch((val>>6)&0x3) {
 		case 0x1:
@@ -1980,31 +1988,6 @@ static void render_pixel_row_ham8(deark *c, lctx *d, i64 rownum, const u32 *rowb
 	}
 }
 
-static void render_pixel_row_normal(deark *c, lctx *d, struct imgbody_info *ibi,
-	i64 rownum, const u32 *rowbuf, UI rowbuf_size, de_bitmap *img)
-{
-	UI k;
-
-	for(k=0; k<rowbuf_size; k++) {
-		de_bitmap_setpixel_rgb(img, (i64)k, rownum, d->pal[(UI)rowbuf[k] & 0xff]);
-	}
-}
-
-static void render_pixel_row_rgb24(deark *c, lctx *d, struct imgbody_info *ibi,
-	i64 rownum, const u32 *rowbuf, UI rowbuf_size, de_bitmap *img)
-{
-	UI k;
-
-	for(k=0; k<rowbuf_size; k++) {
-		UI r, g, b;
-
-		r = (rowbuf[k] & 0x0000ff);
-		g = (rowbuf[k] & 0x00ff00)>>8;
-		b = (rowbuf[k] & 0xff0000)>>16;
-		de_bitmap_setpixel_rgb(img, (i64)k, rownum, DE_MAKE_RGB(r, g, b));
-	}
-}
-
 static void set_finfo_data(deark *c, lctx *d, struct imgbody_info *ibi, de_finfo *fi)
 {
 	int has_aspect = 0;
@@ -2039,19 +2022,36 @@ static void set_finfo_data(deark *c, lctx *d, struct imgbody_info *ibi, de_finfo
 	}
 }
 
+// Can the previously rendered animation frame be reused as the starting
+// point for this frame?
+static int anim_img_is_reusable(lctx *d, struct imgbody_info *ibi, int bypp)
+{
+	const struct imgbody_info *ibi0 = &d->anim_img_ibi;
+
+	if(!d->anim_img || !d->anim_img_fb) return 0;
+	if(d->anim_img->bytes_per_pixel != bypp) return 0;
+	if(ibi->width!=ibi0->width || ibi->height!=ibi0->height) return 0;
+	if(ibi->planes_fg!=ibi0->planes_fg || ibi->planes_total!=ibi0->planes_total) return 0;
+	if(ibi->masking_code!=ibi0->masking_code) return 0;
+	if(ibi->colortype!=ibi0->colortype) return 0;
+	if(ibi->frame_buffer_rowspan!=ibi0->frame_buffer_rowspan) return 0;
+	if(de_memcmp(d->pal, d->anim_img_pal, sizeof(d->pal))) return 0;
+	return 1;
+}
+
 // Generate the final image and write it to a file.
 static void write_frame(deark *c, lctx *d, struct imgbody_info *ibi, struct frame_ctx *frctx)
 {
 	de_bitmap *img = NULL;
 	i64 j;
-	u32 *rowbuf = NULL; // The current row of pixel (palette or RGB) values
+	u8 *rowbuf_src = NULL; // Scratch space for the current row of the frame buffer
+	u8 *rowbuf = NULL; // The current row of pixel values (palette indices, or RGB)
 	u8 *rowbuf_trns = NULL; // The current row's 1-bit transparency mask values
 	UI rowbuf_size;
 	int bypp;
 	de_finfo *fi = NULL;
 	UI createflags = 0;
-	u32 pixelval[8];
-	u8 pixeltrnsval[8];
+	int reuse_prev_img = 0;
 
 	if(d->errflag) goto done;
 	if(!frctx) goto done;
@@ -2078,7 +2078,8 @@ static void write_frame(deark *c, lctx *d, struct imgbody_info *ibi, struct fram
 	}
 
 	rowbuf_size = (UI)ibi->width;
-	rowbuf = de_mallocarray(c, rowbuf_size, sizeof(rowbuf[0]));
+	rowbuf_src = de_malloc(c, ibi->frame_buffer_rowspan);
+	rowbuf = de_mallocarray(c, rowbuf_size, 3);
 	rowbuf_trns = de_mallocarray(c, rowbuf_size, sizeof(rowbuf_trns[0]));
 
 	if(d->found_cmap && d->pal_is_grayscale && d->planes_raw<=8 && !d->is_ham6 && !d->is_ham8) {
@@ -2094,7 +2095,24 @@ static void write_frame(deark *c, lctx *d, struct imgbody_info *ibi, struct fram
 		}
 	}
 
-	img = de_bitmap_create(c, ibi->width, ibi->height, bypp);
+	if(d->is_anim && !ibi->is_thumb && !ibi->is_pbm) {
+		// Keep the rendered image, so the next frame can reuse it.
+		if(anim_img_is_reusable(d, ibi, bypp)) {
+			reuse_prev_img = 1;
+		}
+		else {
+			de_bitmap_destroy(d->anim_img);
+			de_free(c, d->anim_img_fb);
+			d->anim_img = de_bitmap_create(c, ibi->width, ibi->height, bypp);
+			d->anim_img_fb = de_malloc(c, ibi->frame_buffer_size);
+			d->anim_img_ibi = *ibi;
+		}
+		de_memcpy(d->anim_img_pal, d->pal, sizeof(d->pal));
+		img = d->anim_img;
+	}
+	else {
+		img = de_bitmap_create(c, ibi->width, ibi->height, bypp);
+	}
 
 	if(ibi->is_pbm) {
 		de_convert_image_paletted(frctx->frame_buffer, 0, 8, ibi->frame_buffer_rowspan,
@@ -2103,50 +2121,45 @@ static void write_frame(deark *c, lctx *d, struct imgbody_info *ibi, struct fram
 	}
 
 	for(j=0; j<ibi->height; j++) {
-		i64 z;
+		const u8 *src;
 		i64 plane;
-		UI k;
-
-		// Process 8 pixels at a time
-		for(z=0; z<ibi->bytes_per_row_per_plane; z++) {
-			de_zeromem(pixelval, sizeof(pixelval));
-			de_zeromem(pixeltrnsval, sizeof(pixeltrnsval));
 
-			// Read the zth byte in each plane
-			for(plane=0; plane<ibi->planes_total; plane++) {
-				u8 b;
+		src = dbuf_borrow(frctx->frame_buffer, j*ibi->frame_buffer_rowspan,
+			ibi->frame_buffer_rowspan, rowbuf_src);
 
-				b = dbuf_getbyte(frctx->frame_buffer,
-					j*ibi->frame_buffer_rowspan +
-					plane*ibi->bytes_per_row_per_plane + z);
+		if(img==d->anim_img) {
+			u8 *prevsrc = &d->anim_img_fb[j*ibi->frame_buffer_rowspan];
 
-				for(k=0; k<8; k++) {
-					if(b & (1U<<(7-k))) {
-						if(plane < ibi->planes_fg) {
-							pixelval[k] |= 1U<<(UI)plane;
-						}
-						else {
-							// The only way this can happen is if this plane is a
-							// 1-bit transparency mask.
-							pixeltrnsval[k] = 1;
-						}
-					}
-				}
+			// If this row is the same as last time, the image already has
+			// the right pixels.
+			if(reuse_prev_img && !de_memcmp(src, prevsrc, (size_t)ibi->frame_buffer_rowspan)) {
+				continue;
 			}
+			de_memcpy(prevsrc, src, (size_t)ibi->frame_buffer_rowspan);
+		}
 
-			for(k=0; k<8; k++) {
-				UI idx;
+		// Convert the foreground planes, 8 at a time. For RGB24, this results
+		// in R,G,B samples.
+		for(plane=0; plane<ibi->planes_fg; plane+=8) {
+			fmtutil_planar_to_chunky(&src[plane*ibi->bytes_per_row_per_plane],
+				(i64)rowbuf_size, (UI)de_min_int(ibi->planes_fg-plane, 8),
+				ibi->bytes_per_row_per_plane,
+				ibi->bytes_per_row_per_plane, ibi->bytes_per_row_per_plane,
+				&rowbuf[plane/8], (ibi->colortype==COLORTYPE_RGB24) ? 3 : 1);
+		}
 
-				idx = (UI)z*8+k;
-				if(idx < rowbuf_size) {
-					rowbuf[idx] = pixelval[k];
-					rowbuf_trns[idx] = pixeltrnsval[k];
-				}
-			}
+		if(ibi->planes_total > ibi->planes_fg) {
+			// The only way this can happen is if this plane is a
+			// 1-bit transparency mask.
+			fmtutil_planar_to_chunky(&src[ibi->planes_fg*ibi->bytes_per_row_per_plane],
+				(i64)rowbuf_size, 1,
+				ibi->bytes_per_row_per_plane,
+				ibi->bytes_per_row_per_plane, ibi->bytes_per_row_per_plane,
+				rowbuf_trns, 1);
 		}
 
 		if(ibi->colortype==COLORTYPE_RGB24) {
-			render_pixel_row_rgb24(c, d, ibi, j, rowbuf, rowbuf_size, img);
+			de_convert_row_rgb_mem(rowbuf, 3, img, j, 0);
 		}
 		else if(d->is_ham6) {
 			render_pixel_row_ham6(c, d, j, rowbuf, rowbuf_size, img);
@@ -2155,7 +2168,7 @@ static void write_frame(deark *c, lctx *d, struct imgbody_info *ibi, struct fram
 			render_pixel_row_ham8(c, d, j, rowbuf, rowbuf_size, img);
 		}
 		else {
-			render_pixel_row_normal(c, d, ibi, j, rowbuf, rowbuf_size, img);
+			de_convert_row_paletted_mem(rowbuf, 8, d->pal, img, j, 0);
 		}
 
 		// Handle 1-bit transparency masks here, for all color types.
@@ -2174,6 +2187,10 @@ static void write_frame(deark *c, lctx *d, struct imgbody_info *ibi, struct fram
 		}
 	}
 
+	if(ibi->colortype!=COLORTYPE_RGB24 && !d->is_ham6 && !d->is_ham8) {
+		de_bitmap_set_palette_hint(img, d->pal, 256);
+	}
+
 after_render:
 	fi = de_finfo_create(c);
 	set_finfo_data(c, d, ibi, fi);
@@ -2187,8 +2204,11 @@ after_render:
 	de_bitmap_write_to_file_finfo(img, fi, createflags);
 
 done:
-	de_bitmap_destroy(img);
+	if(img!=d->anim_img) {
+		de_bitmap_destroy(img);
+	}
 	de_finfo_destroy(c, fi);
+	de_free(c, rowbuf_src);
 	de_free(c, rowbuf);
 	de_free(c, rowbuf_trns);
 }
@@ -2580,6 +2600,8 @@ done:
 		destroy_frame(c, d, d->frctx);
 		destroy_frame(c, d, d->oldfrctx[0]);
 		destroy_frame(c, d, d->oldfrctx[1]);
+		de_bitmap_destroy(d->anim_img);
+		de_free(c, d->anim_img_fb);
 		de_free(c, d);
 	}
 }
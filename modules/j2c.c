@@ -565,17 +565,10 @@ static void de_run_j2c(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_j2c(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xff\x4f\xff\x51", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_j2c(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "j2c";
 	mi->desc = "JPEG 2000 codestream";
 	mi->run_fn = de_run_j2c;
-	mi->identify_fn = de_identify_j2c;
+	de_module_add_sig(c, mi, 0, "\xff\x4f\xff\x51", 4, 100);
 }
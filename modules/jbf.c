@@ -414,17 +414,10 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_jbf(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "JASC BROWS FILE", 15))
-		return 100;
-	return 0;
-}
-
 void de_module_jbf(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "jbf";
 	mi->desc = "PaintShop Pro Browser Cache (pspbrwse.jbf)";
 	mi->run_fn = de_run_jbf;
-	mi->identify_fn = de_identify_jbf;
+	de_module_add_sig(c, mi, 0, "JASC BROWS FILE", 15, 100);
 }
@@ -246,4 +246,5 @@ void de_module_jovianvi(deark *c, struct deark_module_info *mi)
 	mi->desc = "Jovian Logic VI";
 	mi->run_fn = de_run_jovianvi;
 	mi->identify_fn = de_identify_jovianvi;
+	de_module_add_sig(c, mi, 0, "VI", 2, 0);
 }
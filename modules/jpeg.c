@@ -2028,100 +2028,14 @@ done:
 	}
 }
 
-typedef struct scanctx_struct {
-	i64 len;
-	u8 is_jpegls;
-} scanctx;
-
-static int detect_jpeg_len(deark *c, scanctx *d, i64 pos1, i64 len)
-{
-	u8 b0, b1;
-	i64 pos;
-	i64 seg_size;
-	int in_scan = 0;
-	int found_sof = 0;
-	int found_scan = 0;
-
-	d->len = 0;
-	d->is_jpegls = 0;
-	pos = pos1;
-
-	while(1) {
-		if(pos>=pos1+len)
-			break;
-		b0 = de_getbyte(pos);
-
-		if(b0!=0xff) {
-			pos++;
-			continue;
-		}
-
-		// Peek at the next byte (after this 0xff byte).
-		b1 = de_getbyte(pos+1);
-
-		if(b1==0xff) {
-			// A "fill byte", not a marker.
-			pos++;
-			continue;
-		}
-		else if(b1==0x00 || (d->is_jpegls && b1<0x80 && in_scan)) {
-			// An escape sequence, not a marker.
-			pos+=2;
-			continue;
-		}
-		else if(b1==0xd9) { // EOI. That's what we're looking for.
-			if(!found_sof || !found_scan) return 0;
-			pos+=2;
-			d->len = pos-pos1;
-			return 1;
-		}
-		else if(b1==0xf7) {
-			de_dbg(c, "Looks like a JPEG-LS file.");
-			found_sof = 1;
-			d->is_jpegls = 1;
-		}
-		else if(b1>=0xc0 && b1<=0xcf && b1!=0xc4 && b1!=0xc8 && b1!=0xcc) {
-			found_sof = 1;
-		}
-
-		if(b1==0xda) { // SOS - Start of scan
-			if(!found_sof) return 0;
-			found_scan = 1;
-			in_scan = 1;
-		}
-		else if(b1>=0xd0 && b1<=0xd7) {
-			// RSTn markers don't change the in_scan state.
-			;
-		}
-		else {
-			in_scan = 0;
-		}
-
-		if((b1>=0xd0 && b1<=0xda) || b1==0x01) {
-			// Markers that have no content.
-			pos+=2;
-			continue;
-		}
-
-		// Everything else should be a marker segment, with a length field.
-		seg_size = de_getu16be(pos+2);
-		if(seg_size<2) break; // bogus size
-
-		pos += seg_size+2;
-	}
-
-	return 0;
-}
-
 static void de_run_jpegscan(deark *c, de_module_params *mparams)
 {
 	i64 pos = 0;
 	i64 foundpos = 0;
-	scanctx *d = NULL;
+	i64 jpeg_len;
+	u8 is_jpegls;
 	int ret;
 
-	d = de_malloc(c, sizeof(*d));
-
 	while(1) {
 		if(pos >= c->infile->len) break;
 
@@ -2133,27 +2047,19 @@ static void de_run_jpegscan(deark *c, de_module_params *mparams)
 
 		pos = foundpos;
 
-		if(detect_jpeg_len(c, d, pos, c->infile->len-pos)) {
-			de_dbg(c, "length=%d", (int)d->len);
-			dbuf_create_file_from_slice(c->infile, pos, d->len,
-				d->is_jpegls ? "jls" : "jpg", NULL, 0);
-			pos += d->len;
+		if(fmtutil_find_jpeg_len(c, c->infile, pos, c->infile->len-pos,
+			&jpeg_len, &is_jpegls))
+		{
+			de_dbg(c, "length=%d", (int)jpeg_len);
+			dbuf_create_file_from_slice(c->infile, pos, jpeg_len,
+				is_jpegls ? "jls" : "jpg", NULL, 0);
+			pos += jpeg_len;
 		}
 		else {
 			de_dbg(c, "Doesn't seem to be a valid JPEG.");
 			pos++;
 		}
 	}
-
-	de_free(c, d);
-}
-
-static int de_identify_jpeg(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xff\xd8\xff", 3)) {
-		return 100;
-	}
-	return 0;
 }
 
 void de_module_jpeg(deark *c, struct deark_module_info *mi)
@@ -2162,7 +2068,7 @@ void de_module_jpeg(deark *c, struct deark_module_info *mi)
 	mi->desc = "JPEG image";
 	mi->desc2 = "resources only";
 	mi->run_fn = de_run_jpeg;
-	mi->identify_fn = de_identify_jpeg;
+	de_module_add_sig(c, mi, 0, "\xff\xd8\xff", 3, 100);
 }
 
 void de_module_jpegscan(deark *c, struct deark_module_info *mi)
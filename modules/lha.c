@@ -878,6 +878,7 @@ static void do_extract_file(deark *c, lctx *d, struct member_data *md)
 	dcmpro.len_known = 1;
 
 	if(md->is_dir) goto done; // For directories, we're done.
+	if(dbuf_output_is_skipped(outf)) goto done;
 
 	if(md->cmi->decompressor) {
 		md->cmi->decompressor(c, d, md, &dcmpri, &dcmpro, &dres);
@@ -1646,4 +1647,5 @@ void de_module_arx(deark *c, struct deark_module_info *mi)
 	mi->desc = "ARX LHA-like archive";
 	mi->run_fn = de_run_arx;
 	mi->identify_fn = de_identify_arx;
+	de_module_add_sig(c, mi, 2, "-lh1-", 5, 0);
 }
@@ -133,6 +133,7 @@ void de_module_megapaint_pat(deark *c, struct deark_module_info *mi)
 	mi->desc = "MegaPaint Patterns";
 	mi->run_fn = de_run_megapaint_pat;
 	mi->identify_fn = de_identify_megapaint_pat;
+	de_module_add_sig(c, mi, 0, "\x07" "PAT", 4, 0);
 }
 
 // **************************************************************************
@@ -182,4 +183,5 @@ void de_module_megapaint_lib(deark *c, struct deark_module_info *mi)
 	mi->desc = "MegaPaint Symbol Library";
 	mi->run_fn = de_run_megapaint_lib;
 	mi->identify_fn = de_identify_megapaint_lib;
+	de_module_add_sig(c, mi, 0, "\x07" "LIB", 4, 0);
 }
@@ -746,20 +746,13 @@ static void de_run_mrw(deark *c, de_module_params *mparams)
 	do_mrw_seg_list(c, 8, mrw_seg_size);
 }
 
-static int de_identify_mrw(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x00\x4d\x52\x4d", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_mrw(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "mrw";
 	mi->desc = "Minolta RAW";
 	mi->desc2 = "resources only";
 	mi->run_fn = de_run_mrw;
-	mi->identify_fn = de_identify_mrw;
+	de_module_add_sig(c, mi, 0, "\x00\x4d\x52\x4d", 4, 100);
 }
 
 // **************************************************************************
@@ -1214,19 +1207,12 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_lss16(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x3d\xf3\x13\x14", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_lss16(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "lss16";
 	mi->desc = "SYSLINUX LSS16 image";
 	mi->run_fn = de_run_lss16;
-	mi->identify_fn = de_identify_lss16;
+	de_module_add_sig(c, mi, 0, "\x3d\xf3\x13\x14", 4, 100);
 }
 
 // **************************************************************************
@@ -1363,6 +1349,7 @@ void de_module_ybm(deark *c, struct deark_module_info *mi)
 	mi->desc = "Bennet Yee's face format, a.k.a. YBM";
 	mi->run_fn = de_run_ybm;
 	mi->identify_fn = de_identify_ybm;
+	de_module_add_sig(c, mi, 0, "!!", 2, 0);
 }
 
 // **************************************************************************
@@ -1400,19 +1387,12 @@ done:
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_olpc565(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "C565", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_olpc565(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "olpc565";
 	mi->desc = "OLPC .565 firmware icon";
 	mi->run_fn = de_run_olpc565;
-	mi->identify_fn = de_identify_olpc565;
+	de_module_add_sig(c, mi, 0, "C565", 4, 100);
 }
 
 // **************************************************************************
@@ -1455,19 +1435,12 @@ done:
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_iim(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "IS_IMAGE", 8))
-		return 100;
-	return 0;
-}
-
 void de_module_iim(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "iim";
 	mi->desc = "InShape IIM";
 	mi->run_fn = de_run_iim;
-	mi->identify_fn = de_identify_iim;
+	de_module_add_sig(c, mi, 0, "IS_IMAGE", 8, 100);
 }
 
 // **************************************************************************
@@ -1550,21 +1523,13 @@ done:
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_pm_xv(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "VIEW", 4))
-		return 15;
-	if(!dbuf_memcmp(c->infile, 0, "WEIV", 4))
-		return 15;
-	return 0;
-}
-
 void de_module_pm_xv(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pm_xv";
 	mi->desc = "PM (XV)";
 	mi->run_fn = de_run_pm_xv;
-	mi->identify_fn = de_identify_pm_xv;
+	de_module_add_sig(c, mi, 0, "VIEW", 4, 15);
+	de_module_add_sig(c, mi, 0, "WEIV", 4, 15);
 }
 
 // **************************************************************************
@@ -1631,19 +1596,12 @@ done:
 	dbuf_close(unc_pixels);
 }
 
-static int de_identify_crg(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "CALAMUSCRG", 10))
-		return 100;
-	return 0;
-}
-
 void de_module_crg(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "crg";
 	mi->desc = "Calamus Raster Graphic";
 	mi->run_fn = de_run_crg;
-	mi->identify_fn = de_identify_crg;
+	de_module_add_sig(c, mi, 0, "CALAMUSCRG", 10, 100);
 }
 
 // **************************************************************************
@@ -1679,19 +1637,12 @@ static void de_run_farbfeld(deark *c, de_module_params *mparams)
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_farbfeld(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "farbfeld", 8))
-		return 100;
-	return 0;
-}
-
 void de_module_farbfeld(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "farbfeld";
 	mi->desc = "farbfeld image";
 	mi->run_fn = de_run_farbfeld;
-	mi->identify_fn = de_identify_farbfeld;
+	de_module_add_sig(c, mi, 0, "farbfeld", 8, 100);
 }
 
 // **************************************************************************
@@ -1848,19 +1799,12 @@ done:
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_hsiraw(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "mhwanh", 6))
-		return 100;
-	return 0;
-}
-
 void de_module_hsiraw(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "hsiraw";
 	mi->desc = "HSI Raw";
 	mi->run_fn = de_run_hsiraw;
-	mi->identify_fn = de_identify_hsiraw;
+	de_module_add_sig(c, mi, 0, "mhwanh", 6, 100);
 }
 
 // **************************************************************************
@@ -2001,19 +1945,12 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int de_identify_vitec(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x00\x5b\x07\x20", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_vitec(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "vitec";
 	mi->desc = "VITec image format";
 	mi->run_fn = de_run_vitec;
-	mi->identify_fn = de_identify_vitec;
+	de_module_add_sig(c, mi, 0, "\x00\x5b\x07\x20", 4, 100);
 }
 
 // **************************************************************************
@@ -2163,22 +2100,13 @@ static void de_run_zbr(deark *c, de_module_params *mparams)
 	dbuf_close(outf);
 }
 
-static int de_identify_zbr(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x9a\x02", 2)) {
-		if(de_input_file_has_ext(c, "zbr")) return 100;
-		return 25;
-	}
-	return 0;
-}
-
 void de_module_zbr(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "zbr";
 	mi->desc = "ZBR (Zebra Metafile)";
 	mi->desc2 = "extract preview image";
 	mi->run_fn = de_run_zbr;
-	mi->identify_fn = de_identify_zbr;
+	de_module_add_sig_ext(c, mi, 0, "\x9a\x02", 2, 25, "zbr", 100);
 }
 
 // **************************************************************************
@@ -2228,22 +2156,13 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int de_identify_cdr_wl(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "WL", 2)) {
-		if(de_input_file_has_ext(c, "cdr")) return 100;
-		return 6;
-	}
-	return 0;
-}
-
 void de_module_cdr_wl(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "cdr_wl";
 	mi->desc = "CorelDRAW (old WL format)";
 	mi->desc2 = "extract preview image";
 	mi->run_fn = de_run_cdr_wl;
-	mi->identify_fn = de_identify_cdr_wl;
+	de_module_add_sig_ext(c, mi, 0, "WL", 2, 6, "cdr", 100);
 }
 
 // **************************************************************************
@@ -2278,19 +2197,12 @@ static void de_run_compress(deark *c, de_module_params *mparams)
 	dbuf_close(f);
 }
 
-static int de_identify_compress(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x1f\x9d", 2))
-		return 100;
-	return 0;
-}
-
 void de_module_compress(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "compress";
 	mi->desc = "Compress (.Z)";
 	mi->run_fn = de_run_compress;
-	mi->identify_fn = de_identify_compress;
+	de_module_add_sig(c, mi, 0, "\x1f\x9d", 2, 100);
 }
 
 // **************************************************************************
@@ -716,4 +716,5 @@ void de_module_monkeys_audio(deark *c, struct deark_module_info *mi)
 	mi->desc = "Monkey's Audio (.ape)";
 	mi->run_fn = de_run_monkeys_audio;
 	mi->identify_fn = de_identify_monkeys_audio;
+	de_module_add_sig(c, mi, 0, "MAC ", 4, 0);
 }
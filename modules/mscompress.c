@@ -200,7 +200,6 @@ struct mslzh_context {
 	unsigned int bitreader_nbits_in_buf;
 	dbuf *inf;
 	struct de_dfilter_out_params *dcmpro;
-	i64 nbytes_written;
 	int error_flag; // Bad data in the LZ77 part should not set this flag. Set eof_flag instead.
 
 	// bitrd.eof_flag: Always set if error_flag is set.
@@ -386,25 +385,6 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int mslzh_have_enough_output(struct mslzh_context *lzhctx)
-{
-	if(lzhctx->dcmpro->len_known &&
-		(lzhctx->nbytes_written>=lzhctx->dcmpro->expected_len))
-	{
-		return 1;
-	}
-	return 0;
-}
-
-static void mslzh_lz77buf_writebytecb(struct de_lz77buffer *rb, u8 n)
-{
-	struct mslzh_context *lzhctx = (struct mslzh_context*)rb->userdata;
-
-	if(mslzh_have_enough_output(lzhctx)) return;
-	dbuf_writebyte(lzhctx->dcmpro->f, n);
-	lzhctx->nbytes_written++;
-}
-
 static void mslzh_decompress_main(struct mslzh_context *lzhctx)
 {
 	MSLZH_VALUE_TYPE v;
@@ -417,7 +397,7 @@ static void mslzh_decompress_main(struct mslzh_context *lzhctx)
 	curr_matchlen_table = &lzhctx->htree[MSLZH_TREE_IDX_MATCHLEN];
 
 	while(1) {
-		if(mslzh_have_enough_output(lzhctx)) goto unc_done;
+		if(de_lz77buffer_have_enough_output(lzhctx->ringbuf)) goto unc_done;
 		if(lzhctx->bitrd.eof_flag) goto unc_done;
 
 		v = mslzh_getnextcode(lzhctx, curr_matchlen_table);
@@ -518,8 +498,8 @@ static void do_decompress_LZHUFF(deark *c, struct de_dfilter_in_params *dcmpri,
 	}
 
 	lzhctx->ringbuf = de_lz77buffer_create(c, 4096);
-	lzhctx->ringbuf->writebyte_cb = mslzh_lz77buf_writebytecb;
-	lzhctx->ringbuf->userdata = (void*)lzhctx;
+	de_lz77buffer_set_output(lzhctx->ringbuf, dcmpro->f, dcmpro->len_known,
+		dcmpro->expected_len);
 	de_lz77buffer_clear(lzhctx->ringbuf, 0x20);
 
 	mslzh_decompress_main(lzhctx);
@@ -532,6 +512,7 @@ done:
 			de_dfilter_set_generic_error(c, dres, lzhctx->modname);
 		}
 
+		de_lz77buffer_flush(lzhctx->ringbuf);
 		de_lz77buffer_destroy(c, lzhctx->ringbuf);
 
 		for(tr=0; tr<MSLZH_NUM_TREES; tr++) {
@@ -323,4 +323,5 @@ void de_module_packdir(deark *c, struct deark_module_info *mi)
 	mi->desc = "PackDir compressed archive format";
 	mi->run_fn = de_run_packdir;
 	mi->identify_fn = de_identify_packdir;
+	de_module_add_sig(c, mi, 0, "PACK\0", 5, 0);
 }
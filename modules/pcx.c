@@ -479,51 +479,80 @@ static void do_bitmap_1bpp(deark *c, lctx *d)
 static void do_bitmap_paletted(deark *c, lctx *d)
 {
 	de_bitmap *img = NULL;
+	u8 *planebuf = NULL;
+	u8 *idxbuf = NULL;
 	i64 i, j;
 	i64 plane;
-	u8 b;
-	unsigned int palent;
+	UI mask;
 
 	img = de_bitmap_create(c, d->width, d->height, 3);
 
+	if(d->planes==1) {
+		for(j=0; j<d->height; j++) {
+			de_convert_row_paletted(d->unc_pixels, j*d->rowspan, d->bits, d->pal,
+				img, j, 0);
+		}
+		goto done;
+	}
+
+	// Combine the planes into one byte per pixel, then convert that.
+	planebuf = de_malloc(c, d->rowspan_raw);
+	idxbuf = de_malloc(c, d->width);
+	mask = (1U<<(UI)d->bits)-1;
 	for(j=0; j<d->height; j++) {
-		for(i=0; i<d->width; i++) {
-			palent = 0;
-			for(plane=0; plane<d->planes; plane++) {
-				b = de_get_bits_symbol(d->unc_pixels, d->bits,
-					j*d->rowspan + plane*d->rowspan_raw, i);
-				palent |= b<<(plane*d->bits);
+		de_zeromem(idxbuf, (size_t)d->width);
+		for(plane=0; plane<d->planes; plane++) {
+			dbuf_read(d->unc_pixels, planebuf, j*d->rowspan + plane*d->rowspan_raw,
+				d->rowspan_raw);
+			for(i=0; i<d->width; i++) {
+				i64 bitpos = i*d->bits;
+				UI b;
+
+				if(bitpos/8 >= d->rowspan_raw) break;
+				b = ((UI)planebuf[bitpos/8] >> (UI)(8-d->bits-bitpos%8)) & mask;
+				idxbuf[i] |= (u8)(b<<(plane*d->bits));
 			}
-			if(palent>255) palent=0; // Should be impossible.
-			de_bitmap_setpixel_rgb(img, i, j, d->pal[palent]);
 		}
+		de_convert_row_paletted_mem(idxbuf, 8, d->pal, img, j, 0);
 	}
 
+done:
+	de_bitmap_set_palette_hint(img, d->pal, 256);
 	de_bitmap_write_to_file_finfo(img, d->fi, 0);
 	de_bitmap_destroy(img);
+	de_free(c, planebuf);
+	de_free(c, idxbuf);
 }
 
 static void do_bitmap_24bpp(deark *c, lctx *d)
 {
 	de_bitmap *img = NULL;
+	u8 *planebuf = NULL;
+	u8 *rowbuf = NULL;
 	i64 i, j;
 	i64 plane;
-	u8 s[4];
 
-	de_memset(s, 0xff, sizeof(s));
 	img = de_bitmap_create(c, d->width, d->height, d->has_transparency?4:3);
 
+	// Interleave the planes into RGBA pixels. Missing samples are 255.
+	planebuf = de_malloc(c, d->width);
+	rowbuf = de_malloc(c, d->width*4);
+	de_memset(rowbuf, 0xff, (size_t)(d->width*4));
 	for(j=0; j<d->height; j++) {
-		for(i=0; i<d->width; i++) {
-			for(plane=0; plane<d->planes; plane++) {
-				s[plane] = dbuf_getbyte(d->unc_pixels, j*d->rowspan + plane*d->rowspan_raw +i);
+		for(plane=0; plane<d->planes && plane<4; plane++) {
+			dbuf_read(d->unc_pixels, planebuf, j*d->rowspan + plane*d->rowspan_raw,
+				d->width);
+			for(i=0; i<d->width; i++) {
+				rowbuf[i*4+plane] = planebuf[i];
 			}
-			de_bitmap_setpixel_rgba(img, i, j, DE_MAKE_RGBA(s[0], s[1], s[2], s[3]));
 		}
+		de_convert_row_rgb_mem(rowbuf, 4, img, j, DE_GETRGBFLAG_ALPHA);
 	}
 
 	de_bitmap_write_to_file_finfo(img, d->fi, 0);
 	de_bitmap_destroy(img);
+	de_free(c, planebuf);
+	de_free(c, rowbuf);
 }
 
 static void do_bitmap(deark *c, lctx *d)
@@ -640,6 +669,7 @@ void de_module_pcx(deark *c, struct deark_module_info *mi)
 	mi->desc = "PCX image";
 	mi->run_fn = de_run_pcx;
 	mi->identify_fn = de_identify_pcx;
+	de_module_add_sig(c, mi, 0, "\x0a", 1, 0);
 	mi->help_fn = de_help_pcx;
 }
 
@@ -720,17 +750,10 @@ static void de_run_dcx(deark *c, de_module_params *mparams)
 	}
 }
 
-static int de_identify_dcx(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xb1\x68\xde\x3a", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_dcx(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "dcx";
 	mi->desc = "DCX (multi-image PCX)";
 	mi->run_fn = de_run_dcx;
-	mi->identify_fn = de_identify_dcx;
+	de_module_add_sig(c, mi, 0, "\xb1\x68\xde\x3a", 4, 100);
 }
@@ -549,17 +549,10 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_pkfont(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xf7\x59", 2))
-		return 75;
-	return 0;
-}
-
 void de_module_pkfont(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pkfont";
 	mi->desc = "PK Font";
 	mi->run_fn = de_run_pkfont;
-	mi->identify_fn = de_identify_pkfont;
+	de_module_add_sig(c, mi, 0, "\xf7\x59", 2, 75);
 }
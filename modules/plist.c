@@ -460,17 +460,10 @@ done:
 	}
 }
 
-static int de_identify_plist(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "bplist00", 8))
-		return 100;
-	return 0;
-}
-
 void de_module_plist(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "plist";
 	mi->desc = ".plist property list, binary format";
 	mi->run_fn = de_run_plist;
-	mi->identify_fn = de_identify_plist;
+	de_module_add_sig(c, mi, 0, "bplist00", 8, 100);
 }
@@ -1108,5 +1108,8 @@ void de_module_png(deark *c, struct deark_module_info *mi)
 	mi->desc2 = "resources only";
 	mi->run_fn = de_run_png;
 	mi->identify_fn = de_identify_png;
+	de_module_add_sig(c, mi, 0, "\x89\x50\x4e\x47\x0d\x0a\x1a\x0a", 8, 0);
+	de_module_add_sig(c, mi, 0, "\x8b\x4a\x4e\x47\x0d\x0a\x1a\x0a", 8, 0);
+	de_module_add_sig(c, mi, 0, "\x8a\x4d\x4e\x47\x0d\x0a\x1a\x0a", 8, 0);
 }
 
@@ -139,19 +139,12 @@ static void de_run_pgx(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_pgx(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "PGX", 3))
-		return 90;
-	return 0;
-}
-
 void de_module_pgx(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pgx";
 	mi->desc = "Atari Portfolio animation";
 	mi->run_fn = de_run_pgx;
-	mi->identify_fn = de_identify_pgx;
+	de_module_add_sig(c, mi, 0, "PGX", 3, 90);
 }
 
 // **************************************************************************
@@ -217,18 +210,10 @@ static void de_run_pgc(deark *c, de_module_params *mparams)
 	dbuf_close(unc_pixels);
 }
 
-static int de_identify_pgc(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "PG\x01", 3)) {
-		return 100;
-	}
-	return 0;
-}
-
 void de_module_pgc(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pgc";
 	mi->desc = "Atari Portfolio Graphics - compressed";
 	mi->run_fn = de_run_pgc;
-	mi->identify_fn = de_identify_pgc;
+	de_module_add_sig(c, mi, 0, "PG\x01", 3, 100);
 }
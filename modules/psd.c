@@ -3571,102 +3571,222 @@ static u8 scale_float_to_255(double x)
 	return (u8)(0.5+x*255.0);
 }
 
-// Extract the primary image
-static void do_bitmap(deark *c, lctx *d, const struct image_info *iinfo, dbuf *f,
-	i64 pos, i64 len)
+static int is_bilevel_image(const struct image_info *iinfo)
 {
-	de_bitmap *img = NULL;
-	de_finfo *fi = NULL;
-	i64 i, j, plane;
-	i64 nplanes = 0; // Number of planes to read. May be less than d->num_channels.
-	i64 planespan, rowspan, samplespan;
-	u8 b;
-
-	if(!de_good_image_dimensions(c, iinfo->width, iinfo->height)) goto done;
-
-	if(iinfo->color_mode==PSD_CM_BITMAP && iinfo->bits_per_channel==1 &&
-		iinfo->num_channels==1)
-	{
-		de_convert_and_write_image_bilevel(f, 0, iinfo->width, iinfo->height,
-			(iinfo->width+7)/8, DE_CVTF_WHITEISZERO, NULL, 0);
-		goto done;
-	}
+	return (iinfo->color_mode==PSD_CM_BITMAP && iinfo->bits_per_channel==1 &&
+		iinfo->num_channels==1);
+}
 
+// Returns the number of planes to read (which may be less than
+// iinfo->num_channels), or 0 if the image type is not supported.
+static i64 get_num_planes_to_read(deark *c, const struct image_info *iinfo)
+{
 	if(iinfo->bits_per_channel!=8 && iinfo->bits_per_channel!=16 &&
 		iinfo->bits_per_channel!=32)
 	{
 		de_err(c, "Unsupported bits/channel: %d", (int)iinfo->bits_per_channel);
-		goto done;
+		return 0;
 	}
 
 	if(iinfo->color_mode==PSD_CM_GRAY && iinfo->num_channels>=1) {
-		nplanes = 1;
+		return 1;
 	}
-	else if(iinfo->color_mode==PSD_CM_PALETTE && iinfo->num_channels>=1 && iinfo->bits_per_channel==8) {
-		nplanes = 1;
+	if(iinfo->color_mode==PSD_CM_PALETTE && iinfo->num_channels>=1 && iinfo->bits_per_channel==8) {
+		return 1;
 	}
-	else if(iinfo->color_mode==PSD_CM_RGB && iinfo->num_channels>=3) {
-		nplanes = 3;
-	}
-	else {
-		de_err(c, "This type of image is not supported (color=%d, "
-			"num channels=%d, bits/channel=%d)",
-			(int)iinfo->color_mode, (int)iinfo->num_channels, (int)iinfo->bits_per_channel);
-		goto done;
+	if(iinfo->color_mode==PSD_CM_RGB && iinfo->num_channels>=3) {
+		return 3;
 	}
 
-	img = de_bitmap_create(c, iinfo->width, iinfo->height,
+	de_err(c, "This type of image is not supported (color=%d, "
+		"num channels=%d, bits/channel=%d)",
+		(int)iinfo->color_mode, (int)iinfo->num_channels, (int)iinfo->bits_per_channel);
+	return 0;
+}
+
+static de_bitmap *create_main_bitmap(deark *c, const struct image_info *iinfo)
+{
+	return de_bitmap_create(c, iinfo->width, iinfo->height,
 		iinfo->color_mode==PSD_CM_GRAY ? 1 : 3);
+}
 
-	fi = de_finfo_create(c);
+static void write_main_bitmap(deark *c, const struct image_info *iinfo, de_bitmap *img)
+{
+	de_finfo *fi = NULL;
 
+	fi = de_finfo_create(c);
 	if(iinfo->density.code!=DE_DENSITY_UNKNOWN) {
 		fi->density = iinfo->density;
 	}
+	de_bitmap_write_to_file_finfo(img, fi, 0);
+	de_finfo_destroy(c, fi);
+}
+
+// Convert one row of one plane, from rowbuf (width*bits_per_channel/8 bytes)
+// to img.
+// tmpbuf must have room for width bytes.
+static void convert_plane_row(deark *c, lctx *d, const struct image_info *iinfo,
+	de_bitmap *img, i64 plane, i64 rownum, const u8 *rowbuf, u8 *tmpbuf)
+{
+	const u8 *src = rowbuf;
+	i64 srcspan;
+
+	if(iinfo->bits_per_channel==32) {
+		i64 i;
+
+		// TODO: The format of 32-bit samples does not seem to be documented.
+		// This is little more than a guess.
+		for(i=0; i<iinfo->width; i++) {
+			tmpbuf[i] = scale_float_to_255(de_getfloat32x_direct(c, &rowbuf[i*4], d->is_le));
+		}
+		src = tmpbuf;
+		srcspan = 1;
+	}
+	else {
+		// For 16-bit samples, we only use the first byte.
+		srcspan = iinfo->bits_per_channel/8;
+	}
+
+	if(iinfo->color_mode==PSD_CM_RGB) {
+		de_convert_row_sample_mem(src, srcspan, img, rownum, plane);
+	}
+	else if(iinfo->color_mode==PSD_CM_GRAY) {
+		de_convert_row_sample_mem(src, srcspan, img, rownum, 0);
+	}
+	else if(iinfo->color_mode==PSD_CM_PALETTE) {
+		de_convert_row_paletted_mem(src, 8, iinfo->pal, img, rownum, 0);
+	}
+}
+
+// Extract the primary image
+static void do_bitmap(deark *c, lctx *d, const struct image_info *iinfo, dbuf *f,
+	i64 pos, i64 len)
+{
+	de_bitmap *img = NULL;
+	u8 *rowbuf = NULL;
+	u8 *tmpbuf = NULL;
+	i64 j, plane;
+	i64 nplanes;
+	i64 planespan, rowspan;
+
+	if(!de_good_image_dimensions(c, iinfo->width, iinfo->height)) goto done;
+
+	if(is_bilevel_image(iinfo)) {
+		de_convert_and_write_image_bilevel(f, pos, iinfo->width, iinfo->height,
+			(iinfo->width+7)/8, DE_CVTF_WHITEISZERO, NULL, 0);
+		goto done;
+	}
+
+	nplanes = get_num_planes_to_read(c, iinfo);
+	if(nplanes<1) goto done;
+
+	img = create_main_bitmap(c, iinfo);
 
-	samplespan = iinfo->bits_per_channel/8;
-	rowspan = iinfo->width * samplespan;
+	rowspan = iinfo->width * (iinfo->bits_per_channel/8);
 	planespan = iinfo->height * rowspan;
+	rowbuf = de_malloc(c, rowspan);
+	tmpbuf = de_malloc(c, iinfo->width);
 
 	for(plane=0; plane<nplanes; plane++) {
 		for(j=0; j<iinfo->height; j++) {
-			for(i=0; i<iinfo->width; i++) {
-				if(iinfo->bits_per_channel==32) {
-					// TODO: The format of 32-bit samples does not seem to be documented.
-					// This is little more than a guess.
-					double tmpd;
-					tmpd = dbuf_getfloat32x(f, pos + plane*planespan + j*rowspan + i*samplespan, d->is_le);
-					b = scale_float_to_255(tmpd);
-				}
-				else {
-					b = dbuf_getbyte(f, pos + plane*planespan + j*rowspan + i*samplespan);
-				}
-				if(iinfo->color_mode==PSD_CM_RGB) {
-					de_bitmap_setsample(img, i, j, plane, b);
-				}
-				else if(iinfo->color_mode==PSD_CM_GRAY) {
-					de_bitmap_setpixel_gray(img, i, j, b);
-				}
-				else if(iinfo->color_mode==PSD_CM_PALETTE) {
-					de_bitmap_setpixel_rgb(img, i, j, iinfo->pal[(unsigned int)b]);
-				}
+			const u8 *src;
+
+			src = dbuf_borrow(f, pos + plane*planespan + j*rowspan, rowspan, rowbuf);
+			convert_plane_row(c, d, iinfo, img, plane, j, src, tmpbuf);
+		}
+	}
+
+	write_main_bitmap(c, iinfo, img);
+done:
+	de_bitmap_destroy(img);
+	de_free(c, rowbuf);
+	de_free(c, tmpbuf);
+}
+
+// Returns the compressed size of row #idx (counting all planes), from the
+// PackBits row sizes table.
+static i64 get_cmpr_row_size(deark *c, lctx *d, i64 tablepos, i64 idx)
+{
+	if(d->intsize_2or4==4) {
+		return dbuf_getu32x(c->infile, tablepos + 4*idx, d->is_le);
+	}
+	return dbuf_getu16x(c->infile, tablepos + 2*idx, d->is_le);
+}
+
+// Decompress and convert the image one row at a time, using the row sizes
+// table to find each plane's data. The planes are decoded in an interleaved
+// fashion, so that we never need more than one row of decompressed data.
+static void do_bitmap_packbits_rowwise(deark *c, lctx *d, const struct image_info *iinfo,
+	i64 tablepos, i64 datapos)
+{
+	de_bitmap *img = NULL;
+	u8 *rowbuf = NULL;
+	u8 *tmpbuf = NULL;
+	i64 planepos[3];
+	i64 nplanes;
+	i64 rowspan;
+	i64 j, plane;
+	i64 pos;
+	i64 total_cmpr = 0;
+	i64 total_unc = 0;
+
+	if(!de_good_image_dimensions(c, iinfo->width, iinfo->height)) goto done;
+	nplanes = get_num_planes_to_read(c, iinfo);
+	if(nplanes<1 || nplanes>3) goto done;
+
+	// Find where each plane's data starts.
+	pos = datapos;
+	for(plane=0; plane<nplanes; plane++) {
+		planepos[plane] = pos;
+		for(j=0; j<iinfo->height; j++) {
+			pos += get_cmpr_row_size(c, d, tablepos, plane*iinfo->height + j);
+		}
+	}
+
+	img = create_main_bitmap(c, iinfo);
+	rowspan = iinfo->width * (iinfo->bits_per_channel/8);
+	rowbuf = de_malloc(c, rowspan);
+	tmpbuf = de_malloc(c, iinfo->width);
+
+	for(j=0; j<iinfo->height; j++) {
+		for(plane=0; plane<nplanes; plane++) {
+			i64 cmpr_len;
+			i64 nbytes_dcmpr;
+
+			cmpr_len = get_cmpr_row_size(c, d, tablepos, plane*iinfo->height + j);
+			nbytes_dcmpr = fmtutil_decompress_packbits_to_mem(c->infile, planepos[plane],
+				cmpr_len, rowbuf, rowspan, 1);
+			if(nbytes_dcmpr<rowspan) {
+				de_zeromem(&rowbuf[nbytes_dcmpr], (size_t)(rowspan-nbytes_dcmpr));
 			}
+			total_cmpr += cmpr_len;
+			total_unc += nbytes_dcmpr;
+			planepos[plane] += cmpr_len;
+
+			convert_plane_row(c, d, iinfo, img, plane, j, rowbuf, tmpbuf);
 		}
 	}
 
-	de_bitmap_write_to_file_finfo(img, fi, 0);
+	de_dbg_indent(c, 1);
+	de_dbg(c, "decompressed %"I64_FMT" bytes to %"I64_FMT"", total_cmpr, total_unc);
+	de_dbg_indent(c, -1);
+	write_main_bitmap(c, iinfo, img);
+
 done:
 	de_bitmap_destroy(img);
-	de_finfo_destroy(c, fi);
+	de_free(c, rowbuf);
+	de_free(c, tmpbuf);
 }
 
 static void do_bitmap_packbits(deark *c, lctx *d, zztype *zz, const struct image_info *iinfo)
 {
 	dbuf *unc_pixels = NULL;
 	i64 cmpr_data_size = 0;
+	i64 tablepos;
 	i64 k;
 
 	// Data begins with a table of row byte counts.
+	tablepos = zz->pos;
 	de_dbg(c, "row sizes table at %"I64_FMT", len=%d", zz->pos,
 		(int)(iinfo->num_channels * iinfo->height * d->intsize_2or4));
 
@@ -3685,6 +3805,12 @@ static void do_bitmap_packbits(deark *c, lctx *d, zztype *zz, const struct image
 		goto done;
 	}
 
+	if(!is_bilevel_image(iinfo)) {
+		do_bitmap_packbits_rowwise(c, d, iinfo, tablepos, zz->pos);
+		zz->pos += cmpr_data_size;
+		goto done;
+	}
+
 	unc_pixels = dbuf_create_membuf(c, 1024, 0);
 	fmtutil_decompress_packbits(c->infile, zz->pos, cmpr_data_size, unc_pixels, NULL);
 	zz->pos += cmpr_data_size;
@@ -4189,27 +4315,15 @@ static void de_run_ps_pattern(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_psd(deark *c)
-{
-	u8 buf[4];
-
-	de_read(buf, 0, 4);
-	if(!de_memcmp(buf, "8BPS", 4)) return 100;
-	if(!de_memcmp(buf, "8BIM", 4)) {
-		// We sometimes write .8bim files, so we want to identify them.
-		// This is not necessarily a standard file format.
-		if(de_input_file_has_ext(c, "8bim")) return 100;
-		return 75;
-	}
-	return 0;
-}
-
 void de_module_psd(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "psd";
 	mi->desc = "Photoshop PSD";
 	mi->run_fn = de_run_psd;
-	mi->identify_fn = de_identify_psd;
+	de_module_add_sig(c, mi, 0, "8BPS", 4, 100);
+	// We sometimes write .8bim files, so we want to identify them.
+	// This is not necessarily a standard file format.
+	de_module_add_sig_ext(c, mi, 0, "8BIM", 4, 75, "8bim", 100);
 }
 
 static int de_identify_ps_action(deark *c)
@@ -4236,30 +4350,12 @@ void de_module_ps_action(deark *c, struct deark_module_info *mi)
 	mi->identify_fn = de_identify_ps_action;
 }
 
-static int de_identify_ps_gradient(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "8BGR", 4)) {
-		if(de_input_file_has_ext(c, "grd")) return 100;
-		return 90;
-	}
-	return 0;
-}
-
 void de_module_ps_gradient(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "ps_gradient";
 	mi->desc = "Photoshop Gradient";
 	mi->run_fn = de_run_ps_gradient;
-	mi->identify_fn = de_identify_ps_gradient;
-}
-
-static int de_identify_ps_styles(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 2, "8BSL", 4)) {
-		if(de_input_file_has_ext(c, "asl")) return 100;
-		return 90;
-	}
-	return 0;
+	de_module_add_sig_ext(c, mi, 0, "8BGR", 4, 90, "grd", 100);
 }
 
 void de_module_ps_styles(deark *c, struct deark_module_info *mi)
@@ -4267,7 +4363,7 @@ void de_module_ps_styles(deark *c, struct deark_module_info *mi)
 	mi->id = "ps_styles";
 	mi->desc = "Photoshop Styles";
 	mi->run_fn = de_run_ps_styles;
-	mi->identify_fn = de_identify_ps_styles;
+	de_module_add_sig_ext(c, mi, 2, "8BSL", 4, 90, "asl", 100);
 }
 
 static int de_identify_ps_brush(deark *c)
@@ -4289,30 +4385,12 @@ void de_module_ps_brush(deark *c, struct deark_module_info *mi)
 	mi->identify_fn = de_identify_ps_brush;
 }
 
-static int de_identify_ps_csh(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "cush", 4)) {
-		if(de_input_file_has_ext(c, "csh")) return 100;
-		return 80;
-	}
-	return 0;
-}
-
 void de_module_ps_csh(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "ps_csh";
 	mi->desc = "Photoshop Custom Shape";
 	mi->run_fn = de_run_ps_csh;
-	mi->identify_fn = de_identify_ps_csh;
-}
-
-static int de_identify_ps_pattern(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "8BPT", 4)) {
-		if(de_input_file_has_ext(c, "pat")) return 100;
-		return 90;
-	}
-	return 0;
+	de_module_add_sig_ext(c, mi, 0, "cush", 4, 80, "csh", 100);
 }
 
 void de_module_ps_pattern(deark *c, struct deark_module_info *mi)
@@ -4320,5 +4398,5 @@ void de_module_ps_pattern(deark *c, struct deark_module_info *mi)
 	mi->id = "ps_pattern";
 	mi->desc = "Photoshop Pattern";
 	mi->run_fn = de_run_ps_pattern;
-	mi->identify_fn = de_identify_ps_pattern;
+	de_module_add_sig_ext(c, mi, 0, "8BPT", 4, 90, "pat", 100);
 }
@@ -171,13 +171,6 @@ static void de_run_psionpic(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_psionpic(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "PIC\xdc\x30\x30", 6))
-		return 100;
-	return 0;
-}
-
 static void de_help_psionpic(deark *c)
 {
 	de_msg(c, "-opt psionpic:bw : Do not try to detect grayscale images");
@@ -188,6 +181,6 @@ void de_module_psionpic(deark *c, struct deark_module_info *mi)
 	mi->id = "psionpic";
 	mi->desc = "Psion PIC, a.k.a. EPOC PIC";
 	mi->run_fn = de_run_psionpic;
-	mi->identify_fn = de_identify_psionpic;
+	de_module_add_sig(c, mi, 0, "PIC\xdc\x30\x30", 6, 100);
 	mi->help_fn = de_help_psionpic;
 }
@@ -206,17 +206,10 @@ static void de_run_rm(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_rm(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, ".RMF\0", 5))
-		return 100;
-	return 0;
-}
-
 void de_module_rm(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "rm";
 	mi->desc = "RealMedia";
 	mi->run_fn = de_run_rm;
-	mi->identify_fn = de_identify_rm;
+	de_module_add_sig(c, mi, 0, ".RMF\0", 5, 100);
 }
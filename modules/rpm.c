@@ -254,17 +254,10 @@ done:
 	}
 }
 
-static int de_identify_rpm(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xed\xab\xee\xdb", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_rpm(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "rpm";
 	mi->desc = "RPM Package Manager";
 	mi->run_fn = de_run_rpm;
-	mi->identify_fn = de_identify_rpm;
+	de_module_add_sig(c, mi, 0, "\xed\xab\xee\xdb", 4, 100);
 }
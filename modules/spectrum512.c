@@ -384,6 +384,7 @@ void de_module_spectrum512c(deark *c, struct deark_module_info *mi)
 	mi->desc = "Spectrum 512 Compressed";
 	mi->run_fn = de_run_spectrum512c;
 	mi->identify_fn = de_identify_spectrum512c;
+	de_module_add_sig(c, mi, 0, "\x53\x50\x00\x00", 4, 0);
 	mi->help_fn = de_help_spectrum512cs;
 }
 
@@ -411,5 +412,6 @@ void de_module_spectrum512s(deark *c, struct deark_module_info *mi)
 	mi->desc = "Spectrum 512 Smooshed";
 	mi->run_fn = de_run_spectrum512s;
 	mi->identify_fn = de_identify_spectrum512s;
+	de_module_add_sig(c, mi, 0, "\x53\x50\x00\x00", 4, 0);
 	mi->help_fn = de_help_spectrum512cs;
 }
@@ -370,13 +370,6 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int de_identify_sunras(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x59\xa6\x6a\x95", 4))
-		return 100;
-	return 0;
-}
-
 static void de_help_sunras(deark *c)
 {
 	de_msg(c, "-opt sunras:fmt32=<"
@@ -389,6 +382,6 @@ void de_module_sunras(deark *c, struct deark_module_info *mi)
 	mi->id = "sunras";
 	mi->desc = "Sun Raster";
 	mi->run_fn = de_run_sunras;
-	mi->identify_fn = de_identify_sunras;
+	de_module_add_sig(c, mi, 0, "\x59\xa6\x6a\x95", 4, 100);
 	mi->help_fn = de_help_sunras;
 }
@@ -116,6 +116,25 @@ static void do_decode_image_default(deark *c, lctx *d, struct tgaimginfo *imginf
 			cur_rownum = interleave_pass;
 		}
 
+		// Handle the common cases a row at a time.
+		if(d->pixel_depth==1) {
+			de_convert_row_bilevel(unc_pixels, j*rowspan, img, j_adj, 0);
+			continue;
+		}
+		if(!d->right_to_left) {
+			if(d->color_type==TGA_CLRTYPE_TRUECOLOR && d->pixel_depth>=24 &&
+				(d->bytes_per_pixel>=4 || !d->has_alpha_channel))
+			{
+				de_convert_row_rgb(unc_pixels, j*rowspan, d->bytes_per_pixel, img, j_adj,
+					getrgbflags | (d->has_alpha_channel ? DE_GETRGBFLAG_ALPHA : 0));
+				continue;
+			}
+			if(d->color_type==TGA_CLRTYPE_PALETTE && d->bytes_per_pixel==1) {
+				de_convert_row_paletted(unc_pixels, j*rowspan, 8, d->pal, img, j_adj, 0);
+				continue;
+			}
+		}
+
 		for(i=0; i<imginfo->width; i++) {
 			i64 i_adj;
 
@@ -124,10 +143,7 @@ static void do_decode_image_default(deark *c, lctx *d, struct tgaimginfo *imginf
 			else
 				i_adj = i;
 
-			if(d->pixel_depth==1) {
-				de_convert_row_bilevel(unc_pixels, j*rowspan, img, j_adj, 0);
-			}
-			else if(d->color_type==TGA_CLRTYPE_TRUECOLOR && (d->pixel_depth==15 || d->pixel_depth==16)) {
+			if(d->color_type==TGA_CLRTYPE_TRUECOLOR && (d->pixel_depth==15 || d->pixel_depth==16)) {
 				clr = (u32)dbuf_getu16le(unc_pixels, j*rowspan + i*d->bytes_per_pixel);
 				clr = de_rgb555_to_888(clr);
 				de_bitmap_setpixel_rgb(img, i_adj, j_adj, clr);
@@ -153,6 +169,15 @@ static void do_decode_image_default(deark *c, lctx *d, struct tgaimginfo *imginf
 		}
 	}
 
+	if(d->color_type==TGA_CLRTYPE_PALETTE) {
+		de_bitmap_set_palette_hint(img, d->pal, 256);
+	}
+	else if(d->pixel_depth==1) {
+		static const de_color pal_bw[2] = { DE_STOCKCOLOR_BLACK, DE_STOCKCOLOR_WHITE };
+
+		de_bitmap_set_palette_hint(img, pal_bw, 2);
+	}
+
 	de_bitmap_write_to_file_finfo(img, fi, createflags);
 
 	de_bitmap_destroy(img);
@@ -1278,7 +1278,7 @@ static void handler_makernote(deark *c, lctx *d, const struct taginfo *tg, const
 
 static void handler_usercomment(deark *c, lctx *d, const struct taginfo *tg, const struct tagnuminfo *tni)
 {
-	static u8 charcode[8];
+	u8 charcode[8];
 	de_ucstring *s = NULL;
 	de_encoding enc = DE_ENCODING_UNKNOWN;
 	i64 bytes_per_char = 1;
@@ -2881,4 +2881,7 @@ void de_module_tiff(deark *c, struct deark_module_info *mi)
 	mi->desc2 = "resources only";
 	mi->run_fn = de_run_tiff;
 	mi->identify_fn = de_identify_tiff;
+	de_module_add_sig(c, mi, 0, "II", 2, 0);
+	de_module_add_sig(c, mi, 0, "MM", 2, 0);
+	de_module_add_sig(c, mi, 0, "EP", 2, 0);
 }
@@ -173,4 +173,5 @@ void de_module_tim(deark *c, struct deark_module_info *mi)
 	mi->desc = "PlayStation graphics";
 	mi->run_fn = de_run_tim;
 	mi->identify_fn = de_identify_tim;
+	de_module_add_sig(c, mi, 0, "\x10\x00\x00\x00", 4, 0);
 }
@@ -470,17 +470,10 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_vort(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "VORT01", 6))
-		return 100;
-	return 0;
-}
-
 void de_module_vort(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "vort";
 	mi->desc = "VORT ray tracer PIX image";
 	mi->run_fn = de_run_vort;
-	mi->identify_fn = de_identify_vort;
+	de_module_add_sig(c, mi, 0, "VORT01", 6, 100);
 }
@@ -964,6 +964,11 @@ static void do_extract_file(deark *c, lctx *d, struct member_data *md)
 	if(md->is_dir) {
 		goto done;
 	}
+	if(dbuf_output_is_skipped(outf)) {
+		// We know where every member is, so there's no need to decompress
+		// the ones that aren't being extracted.
+		goto done;
+	}
 
 	dbuf_set_writelistener(outf, our_writelistener_cb, (void*)md);
 	md->crco = d->crco;
@@ -512,6 +512,7 @@ static void do_member(deark *c, lctx *d, i64 pos1, i64 *next_member_hdr_pos)
 		ext = "bin";
 	}
 	outf = dbuf_create_output_file(c, ext, md->fi, 0);
+	if(dbuf_output_is_skipped(outf)) goto done;
 	dbuf_set_writelistener(outf, our_writelistener_cb, (void*)d->crco);
 	de_crcobj_reset(d->crco);
 
@@ -619,17 +620,10 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int de_identify_zoo(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 20, "\xdc\xa7\xc4\xfd", 4))
-		return 100;
-	return 0;
-}
-
 void de_module_zoo(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "zoo";
 	mi->desc = "ZOO compressed archive format";
 	mi->run_fn = de_run_zoo;
-	mi->identify_fn = de_identify_zoo;
+	de_module_add_sig(c, mi, 20, "\xdc\xa7\xc4\xfd", 4, 100);
 }
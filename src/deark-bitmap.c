@@ -87,50 +87,133 @@ struct image_scan_results {
 	int has_color;
 	int has_trns;
 	int has_visible_pixels;
+	int has_uniform_alpha; // All pixels have the same alpha value...
+	u8 alpha_value; // ...which is this
 };
 
 // Scan the image's pixels, and report whether any are transparent, etc.
+// This works directly on the pixel memory. The inner loops don't branch, so
+// the compiler can vectorize them, and we stop after any row once there's
+// nothing more to learn.
 static void scan_image(de_bitmap *img, struct image_scan_results *isres)
 {
 	i64 i, j;
-	de_color clr;
-	de_colorsample a, r, g, b;
+	i64 rowspan;
+	int bypp = img->bytes_per_pixel;
+	UI alpha_varies = 0;
+	UI has_color = 0;
+	u8 first_alpha;
 
 	de_zeromem(isres, sizeof(struct image_scan_results));
-	if(img->bytes_per_pixel==1) {
-		// No reason to scan opaque grayscale images.
+	if(bypp==1 || bypp==3 || !img->bitmap) {
+		// Opaque, so the alpha-related fields are already known.
 		isres->has_visible_pixels = 1;
+		isres->has_uniform_alpha = 1;
+		isres->alpha_value = 0xff;
+	}
+	if(bypp==1 || !img->bitmap) {
+		// No reason to scan opaque grayscale images.
 		return;
 	}
+
+	rowspan = img->width * bypp;
+	first_alpha = (bypp==3) ? 0xff : img->bitmap[bypp-1];
+
 	for(j=0; j<img->height; j++) {
-		for(i=0; i<img->width; i++) {
-			clr = de_bitmap_getpixel(img, i, j);
-			// TODO: Optimize these tests. We check for too many things we
-			// already know the answer to.
-			a = DE_COLOR_A(clr);
-			r = DE_COLOR_R(clr);
-			g = DE_COLOR_G(clr);
-			b = DE_COLOR_B(clr);
-			if(!isres->has_visible_pixels && a!=0) {
-				isres->has_visible_pixels = 1;
+		const u8 *p = &img->bitmap[j*rowspan];
+
+		switch(bypp) {
+		case 2:
+			for(i=0; i<img->width; i++) {
+				alpha_varies |= (p[i*2+1]!=first_alpha);
 			}
-			if(!isres->has_trns && a<255) {
-				isres->has_trns = 1;
+			break;
+		case 3:
+			for(i=0; i<img->width; i++) {
+				has_color |= (p[i*3]!=p[i*3+1]) | (p[i*3+2]!=p[i*3+1]);
 			}
-			if(!isres->has_color && img->bytes_per_pixel>=3 &&
-				((g!=r || b!=r) && a!=0) )
-			{
-				isres->has_color = 1;
+			break;
+		case 4:
+			for(i=0; i<img->width; i++) {
+				u8 a = p[i*4+3];
+
+				alpha_varies |= (a!=first_alpha);
+				// The color of invisible pixels doesn't matter.
+				has_color |= ((p[i*4]!=p[i*4+1]) | (p[i*4+2]!=p[i*4+1])) & (a!=0);
 			}
+			break;
 		}
 
 		// After each row, test whether we've learned everything we can learn
 		// about this image.
-		if((isres->has_trns || img->bytes_per_pixel==1 || img->bytes_per_pixel==3) &&
-			(isres->has_visible_pixels) &&
-			(isres->has_color || img->bytes_per_pixel<=2))
-		{
-			return;
+		if((alpha_varies || bypp==3) && (has_color || bypp==2)) {
+			break;
+		}
+	}
+
+	isres->has_color = has_color ? 1 : 0;
+	if(bypp==3) return;
+
+	if(alpha_varies) {
+		// Varying alpha implies that some pixels are transparent, and some
+		// are visible.
+		isres->has_trns = 1;
+		isres->has_visible_pixels = 1;
+	}
+	else {
+		isres->has_uniform_alpha = 1;
+		isres->alpha_value = first_alpha;
+		isres->has_trns = (first_alpha<0xff);
+		isres->has_visible_pixels = (first_alpha!=0);
+	}
+}
+
+// For each sample of a pixel with dst_bypp bytes, the offset of the
+// corresponding sample in a pixel with src_bypp bytes, or -1 for an opaque
+// alpha sample. Uses the same rules as de_bitmap_setpixel_rgba().
+static void get_sample_map(int src_bypp, int dst_bypp, int *map)
+{
+	// RGBA offsets, for each src_bypp
+	static const int src_offs[5][4] = { {0,0,0,-1}, {0,0,0,-1}, {0,0,0,1},
+		{0,1,2,-1}, {0,1,2,3} };
+	// Which RGBA channel each sample is, for each dst_bypp
+	static const int dst_chans[5][4] = { {1,0,0,0}, {1,0,0,0}, {1,3,0,0},
+		{0,1,2,0}, {0,1,2,3} };
+	int k;
+
+	for(k=0; k<dst_bypp; k++) {
+		map[k] = src_offs[src_bypp][dst_chans[dst_bypp][k]];
+	}
+}
+
+// Copy pixels between images that may have different bytes_per_pixel.
+// The rectangles must be in bounds, and the images distinct.
+static void copy_rect_fast(de_bitmap *srcimg, de_bitmap *dstimg,
+	i64 srcxpos, i64 srcypos, i64 width, i64 height,
+	i64 dstxpos, i64 dstypos)
+{
+	int sb = srcimg->bytes_per_pixel;
+	int db = dstimg->bytes_per_pixel;
+	int map[4];
+	i64 i, j;
+	int k;
+
+	get_sample_map(sb, db, map);
+
+	for(j=0; j<height; j++) {
+		const u8 *sp = &srcimg->bitmap[((srcypos+j)*srcimg->width + srcxpos)*sb];
+		u8 *dp = &dstimg->bitmap[((dstypos+j)*dstimg->width + dstxpos)*db];
+
+		if(sb==db) {
+			de_memcpy(dp, sp, (size_t)(width*sb));
+			continue;
+		}
+		for(i=0; i<width; i++) {
+			for(k=0; k<db; k++) {
+				dp[k] = (map[k]<0) ? 0xff : sp[map[k]];
+			}
+			sp += sb;
+			dp += db;
 		}
 	}
 }
@@ -145,6 +228,11 @@ static de_bitmap *de_bitmap_clone_noalloc(de_bitmap *img1)
 	de_memcpy(img2, img1, sizeof(de_bitmap));
 	img2->bitmap = 0;
 	img2->bitmap_size = 0;
+	img2->pal_hint = NULL;
+	img2->pal_hint_num_entries = 0;
+	if(img1->pal_hint) {
+		de_bitmap_set_palette_hint(img2, img1->pal_hint, img1->pal_hint_num_entries);
+	}
 	return img2;
 }
 
@@ -194,7 +282,7 @@ void de_bitmap_write_to_file_finfo(de_bitmap *img, de_finfo *fi,
 		}
 	}
 
-	f = dbuf_create_output_file(c, "png", fi, createflags);
+	f = dbuf_create_output_file(c, "png", fi, createflags|DE_CREATEFLAG_NO_RECURSE);
 	if(optimg) {
 		de_write_png(c, optimg, f);
 	}
@@ -383,10 +471,27 @@ void de_bitmap_destroy(de_bitmap *b)
 	if(b) {
 		deark *c = b->c;
 		if(b->bitmap) de_free(c, b->bitmap);
+		if(b->pal_hint) de_free(c, b->pal_hint);
 		de_free(c, b);
 	}
 }
 
+// Record the palette that the image's pixels were taken from. This lets us
+// write a paletted image file. It doesn't matter if the image is later
+// modified; every pixel is checked against the palette when the image is
+// written.
+void de_bitmap_set_palette_hint(de_bitmap *img, const de_color *pal, i64 num_entries)
+{
+	if(num_entries>256) num_entries = 256;
+	if(num_entries<1) return;
+
+	if(!img->pal_hint) {
+		img->pal_hint = de_mallocarray(img->c, 256, sizeof(de_color));
+	}
+	de_memcpy(img->pal_hint, pal, (size_t)num_entries*sizeof(de_color));
+	img->pal_hint_num_entries = (int)num_entries;
+}
+
 u8 de_get_bits_symbol(dbuf *f, i64 bps, i64 rowstart, i64 index)
 {
 	i64 byte_offset;
@@ -477,39 +582,303 @@ u8 de_get_bits_symbol2(dbuf *f, int nbits, i64 bytepos, i64 bitpos)
 	return (b0<<bits_in_second_byte) | (b1>>(8-bits_in_second_byte));
 }
 
-void de_convert_row_bilevel(dbuf *f, i64 fpos, de_bitmap *img,
+// Row conversion.
+// Rows are processed in chunks of up to CVT_CHUNK_NPIXELS pixels, so that
+// we never need more than a small fixed-size buffer.
+
+#define CVT_CHUNK_NPIXELS 256
+#define CVT_CHUNK_MAXBYTES 1024
+
+// Expand n packed palette indices (of 1, 2, 4, or 8 bits) into one byte per
+// pixel. n must be a multiple of 8, except for the last chunk of a row.
+static void unpack_indices(const u8 *src, i64 n, UI bpp, int lsbfirst, u8 *dst)
+{
+	UI ppb = 8/bpp; // pixels per byte
+	UI mask = (1U<<bpp)-1;
+	i64 nbytes = (n*bpp+7)/8;
+	i64 k;
+	UI s;
+
+	if(bpp==8) {
+		de_memcpy(dst, src, (size_t)n);
+		return;
+	}
+
+	for(k=0; k<nbytes-1; k++) {
+		UI b = (UI)src[k];
+
+		if(lsbfirst) {
+			for(s=0; s<ppb; s++) {
+				dst[s] = (u8)((b >> (s*bpp)) & mask);
+			}
+		}
+		else {
+			for(s=0; s<ppb; s++) {
+				dst[s] = (u8)((b >> (8-bpp-s*bpp)) & mask);
+			}
+		}
+		dst += ppb;
+	}
+
+	// The last byte may be partially used
+	n -= (nbytes-1)*ppb;
+	for(s=0; s<(UI)n; s++) {
+		UI b = (UI)src[nbytes-1];
+
+		if(lsbfirst)
+			dst[s] = (u8)((b >> (s*bpp)) & mask);
+		else
+			dst[s] = (u8)((b >> (8-bpp-s*bpp)) & mask);
+	}
+}
+
+// Write n pixels, starting at (xpos,rownum), given their palette indices.
+// Caller must validate everything.
+static void put_paletted_pixels(de_bitmap *img, i64 xpos, i64 rownum,
+	const u8 *idx, i64 n, const de_color *pal)
+{
+	u8 *dst;
+	i64 k;
+
+	dst = &img->bitmap[(rownum*img->width + xpos) * img->bytes_per_pixel];
+
+	// Same conversion rules as de_bitmap_setpixel_rgba().
+	switch(img->bytes_per_pixel) {
+	case 4:
+		for(k=0; k<n; k++) {
+			de_color clr = pal[idx[k]];
+			dst[k*4]   = DE_COLOR_R(clr);
+			dst[k*4+1] = DE_COLOR_G(clr);
+			dst[k*4+2] = DE_COLOR_B(clr);
+			dst[k*4+3] = DE_COLOR_A(clr);
+		}
+		break;
+	case 3:
+		for(k=0; k<n; k++) {
+			de_color clr = pal[idx[k]];
+			dst[k*3]   = DE_COLOR_R(clr);
+			dst[k*3+1] = DE_COLOR_G(clr);
+			dst[k*3+2] = DE_COLOR_B(clr);
+		}
+		break;
+	case 2:
+		for(k=0; k<n; k++) {
+			de_color clr = pal[idx[k]];
+			dst[k*2]   = DE_COLOR_G(clr);
+			dst[k*2+1] = DE_COLOR_A(clr);
+		}
+		break;
+	case 1:
+		for(k=0; k<n; k++) {
+			dst[k] = DE_COLOR_G(pal[idx[k]]);
+		}
+		break;
+	}
+}
+
+// Returns 0 if the row should not be processed.
+static int row_cvt_prepare(de_bitmap *img, i64 rownum)
+{
+	if(!img->bitmap) de_bitmap_alloc_pixels(img);
+	if(!img->bitmap) return 0;
+	if(rownum<0 || rownum>=img->height) return 0;
+	return 1;
+}
+
+// Convert a row of packed palette indices, from memory.
+// src must contain at least (img->width*bpp+7)/8 bytes.
+// flags: DE_CVTF_LSBFIRST
+void de_convert_row_paletted_mem(const u8 *src, i64 bpp, const de_color *pal,
+	de_bitmap *img, i64 rownum, unsigned int flags)
+{
+	u8 idxbuf[CVT_CHUNK_NPIXELS];
+	i64 i;
+
+	if(bpp!=1 && bpp!=2 && bpp!=4 && bpp!=8) return;
+	if(!row_cvt_prepare(img, rownum)) return;
+
+	for(i=0; i<img->width; i+=CVT_CHUNK_NPIXELS) {
+		i64 n = de_min_int(img->width-i, CVT_CHUNK_NPIXELS);
+
+		if(bpp==8) {
+			put_paletted_pixels(img, i, rownum, &src[i], n, pal);
+			continue;
+		}
+		unpack_indices(&src[i*bpp/8], n, (UI)bpp, (flags & DE_CVTF_LSBFIRST)?1:0,
+			idxbuf);
+		put_paletted_pixels(img, i, rownum, idxbuf, n, pal);
+	}
+}
+
+// Like de_convert_row_paletted_mem(), but reads from a dbuf.
+void de_convert_row_paletted(dbuf *f, i64 fpos, i64 bpp, const de_color *pal,
+	de_bitmap *img, i64 rownum, unsigned int flags)
+{
+	u8 srcbuf[CVT_CHUNK_NPIXELS];
+	u8 idxbuf[CVT_CHUNK_NPIXELS];
+	i64 i;
+
+	if(bpp!=1 && bpp!=2 && bpp!=4 && bpp!=8) return;
+	if(!row_cvt_prepare(img, rownum)) return;
+
+	for(i=0; i<img->width; i+=CVT_CHUNK_NPIXELS) {
+		i64 n = de_min_int(img->width-i, CVT_CHUNK_NPIXELS);
+
+		dbuf_read(f, srcbuf, fpos + i*bpp/8, (n*bpp+7)/8);
+		if(bpp==8) {
+			put_paletted_pixels(img, i, rownum, srcbuf, n, pal);
+			continue;
+		}
+		unpack_indices(srcbuf, n, (UI)bpp, (flags & DE_CVTF_LSBFIRST)?1:0,
+			idxbuf);
+		put_paletted_pixels(img, i, rownum, idxbuf, n, pal);
+	}
+}
+
+// Convert a row of RGB pixels, from memory. Each pixel is pixelspan bytes,
+// and pixelspan must be at least 3 (or 4 if DE_GETRGBFLAG_ALPHA is used).
+// flags: DE_GETRGBFLAG_BGR, DE_GETRGBFLAG_ALPHA
+void de_convert_row_rgb_mem(const u8 *src, i64 pixelspan, de_bitmap *img,
 	i64 rownum, unsigned int flags)
 {
+	u8 *dst;
 	i64 i;
-	u8 x;
-	u8 b;
-	u8 black, white;
+	UI ri, bi;
+	int bypp;
+
+	if(pixelspan<3) return;
+	if((flags & DE_GETRGBFLAG_ALPHA) && pixelspan<4) return;
+	if(!row_cvt_prepare(img, rownum)) return;
+
+	dst = &img->bitmap[rownum*img->width*img->bytes_per_pixel];
+	bypp = img->bytes_per_pixel;
+	if(flags & DE_GETRGBFLAG_BGR) {
+		ri = 2; bi = 0;
+	}
+	else {
+		ri = 0; bi = 2;
+	}
+
+	if(bypp==3) {
+		for(i=0; i<img->width; i++) {
+			dst[0] = src[ri];
+			dst[1] = src[1];
+			dst[2] = src[bi];
+			src += pixelspan;
+			dst += 3;
+		}
+	}
+	else if(bypp==4) {
+		for(i=0; i<img->width; i++) {
+			dst[0] = src[ri];
+			dst[1] = src[1];
+			dst[2] = src[bi];
+			dst[3] = (flags & DE_GETRGBFLAG_ALPHA) ? src[3] : 0xff;
+			src += pixelspan;
+			dst += 4;
+		}
+	}
+	else {
+		for(i=0; i<img->width; i++) {
+			de_color clr;
+
+			clr = DE_MAKE_RGBA((de_color)src[ri], (de_color)src[1], (de_color)src[bi],
+				((flags & DE_GETRGBFLAG_ALPHA) ? src[3] : 0xff));
+			de_bitmap_setpixel_rgba(img, i, rownum, clr);
+			src += pixelspan;
+		}
+	}
+}
+
+// Like de_convert_row_rgb_mem(), but reads from a dbuf.
+void de_convert_row_rgb(dbuf *f, i64 fpos, i64 pixelspan, de_bitmap *img,
+	i64 rownum, unsigned int flags)
+{
+	u8 srcbuf[CVT_CHUNK_MAXBYTES];
+	de_bitmap tmpimg;
+	i64 npixels_per_chunk;
+	i64 i;
+
+	if(pixelspan<3 || pixelspan>CVT_CHUNK_MAXBYTES) return;
+	if(!row_cvt_prepare(img, rownum)) return;
+
+	npixels_per_chunk = CVT_CHUNK_MAXBYTES / pixelspan;
+
+	// Convert each chunk as if it were a row of a narrow image, that happens
+	// to use our pixel memory.
+	for(i=0; i<img->width; i+=npixels_per_chunk) {
+		i64 n = de_min_int(img->width-i, npixels_per_chunk);
+
+		dbuf_read(f, srcbuf, fpos + i*pixelspan, n*pixelspan);
+		tmpimg = *img;
+		tmpimg.width = n;
+		tmpimg.height = 1;
+		tmpimg.bitmap = &img->bitmap[(rownum*img->width + i)*img->bytes_per_pixel];
+		de_convert_row_rgb_mem(srcbuf, pixelspan, &tmpimg, 0, flags);
+	}
+}
+
+// Set one sample (channel) of each pixel in a row, from memory. The source
+// samples are srcspan bytes apart.
+// Same conversion rules as de_bitmap_setsample().
+void de_convert_row_sample_mem(const u8 *src, i64 srcspan, de_bitmap *img,
+	i64 rownum, i64 samplenum)
+{
+	u8 *dst;
+	i64 i;
+	int bypp;
+
+	if(samplenum<0 || samplenum>3) return;
+	if(!row_cvt_prepare(img, rownum)) return;
 
-	if(flags & DE_CVTF_WHITEISZERO) {
-		white = 0; black = 255;
+	bypp = img->bytes_per_pixel;
+	dst = &img->bitmap[rownum*img->width*bypp];
+	if(bypp==1 && samplenum<3) {
+		if(srcspan==1) {
+			de_memcpy(dst, src, (size_t)img->width);
+			return;
+		}
+	}
+	else if((bypp==3 || bypp==4) && samplenum<bypp) {
+		dst += samplenum;
 	}
 	else {
-		black = 0; white = 255;
+		for(i=0; i<img->width; i++) {
+			de_bitmap_setsample(img, i, rownum, samplenum, src[i*srcspan]);
+		}
+		return;
 	}
 
 	for(i=0; i<img->width; i++) {
-		b = dbuf_getbyte(f, fpos + i/8);
-		if(flags & DE_CVTF_LSBFIRST)
-			x = (b >> (i%8)) & 0x01;
-		else
-			x = (b >> (7 - i%8)) & 0x01;
-		de_bitmap_setpixel_gray(img, i, rownum, x ? white : black);
+		*dst = *src;
+		src += srcspan;
+		dst += bypp;
 	}
 }
 
+void de_convert_row_bilevel(dbuf *f, i64 fpos, de_bitmap *img,
+	i64 rownum, unsigned int flags)
+{
+	static const de_color pal_normal[2] = { DE_STOCKCOLOR_BLACK, DE_STOCKCOLOR_WHITE };
+	static const de_color pal_inverse[2] = { DE_STOCKCOLOR_WHITE, DE_STOCKCOLOR_BLACK };
+
+	de_convert_row_paletted(f, fpos, 1,
+		(flags & DE_CVTF_WHITEISZERO) ? pal_inverse : pal_normal,
+		img, rownum, flags & DE_CVTF_LSBFIRST);
+}
+
 void de_convert_image_bilevel(dbuf *f, i64 fpos, i64 rowspan,
 	de_bitmap *img, unsigned int flags)
 {
 	i64 j;
 
+	static const de_color pal_bw[2] = { DE_STOCKCOLOR_BLACK, DE_STOCKCOLOR_WHITE };
+
 	for(j=0; j<img->height; j++) {
 		de_convert_row_bilevel(f, fpos+j*rowspan, img, j, flags);
 	}
+
+	de_bitmap_set_palette_hint(img, pal_bw, 2);
 }
 
 void de_convert_and_write_image_bilevel(dbuf *f, i64 fpos,
@@ -547,31 +916,25 @@ void de_convert_image_paletted(dbuf *f, i64 fpos,
 	i64 bpp, i64 rowspan, const de_color *pal,
 	de_bitmap *img, unsigned int flags)
 {
-	i64 i, j;
-	unsigned int palent;
+	i64 j;
 
 	if(bpp!=1 && bpp!=2 && bpp!=4 && bpp!=8) return;
 	if(!de_good_image_dimensions_noerr(f->c, img->width, img->height)) return;
 
 	for(j=0; j<img->height; j++) {
-		for(i=0; i<img->width; i++) {
-			palent = (unsigned int)de_get_bits_symbol(f, bpp, fpos+j*rowspan, i);
-			de_bitmap_setpixel_rgba(img, i, j, pal[palent]);
-		}
+		de_convert_row_paletted(f, fpos+j*rowspan, bpp, pal, img, j, flags);
 	}
+
+	de_bitmap_set_palette_hint(img, pal, (i64)1<<bpp);
 }
 
 void de_convert_image_rgb(dbuf *f, i64 fpos,
 	i64 rowspan, i64 pixelspan, de_bitmap *img, unsigned int flags)
 {
-	i64 i, j;
-	de_color clr;
+	i64 j;
 
 	for(j=0; j<img->height; j++) {
-		for(i=0; i<img->width; i++) {
-			clr = dbuf_getRGB(f, fpos + j*rowspan + i*pixelspan, flags);
-			de_bitmap_setpixel_rgb(img, i, j, clr);
-		}
+		de_convert_row_rgb(f, fpos + j*rowspan, pixelspan, img, j, flags);
 	}
 }
 
@@ -603,6 +966,20 @@ void de_bitmap_copy_rect(de_bitmap *srcimg, de_bitmap *dstimg,
 	de_color dst_clr, src_clr, clr;
 	de_colorsample src_a;
 
+	if(!(flags&DE_BITMAPFLAG_MERGE) && srcimg!=dstimg && srcimg->bitmap &&
+		srcxpos>=0 && srcypos>=0 && dstxpos>=0 && dstypos>=0 &&
+		width>=0 && height>=0 &&
+		srcxpos+width<=srcimg->width && srcypos+height<=srcimg->height &&
+		dstxpos+width<=dstimg->width && dstypos+height<=dstimg->height)
+	{
+		if(!dstimg->bitmap) de_bitmap_alloc_pixels(dstimg);
+		if(dstimg->bitmap) {
+			copy_rect_fast(srcimg, dstimg, srcxpos, srcypos, width, height,
+				dstxpos, dstypos);
+			return;
+		}
+	}
+
 	for(j=0; j<height; j++) {
 		for(i=0; i<width; i++) {
 			src_clr = de_bitmap_getpixel(srcimg, srcxpos+i, srcypos+j);
@@ -633,6 +1010,29 @@ void de_bitmap_apply_mask(de_bitmap *fg, de_bitmap *mask,
 	de_color clr;
 	de_colorsample a;
 
+	// Only the alpha sample is changed, so there's nothing to do if there isn't
+	// one.
+	if(fg->bytes_per_pixel!=2 && fg->bytes_per_pixel!=4) return;
+
+	if(!fg->bitmap) de_bitmap_alloc_pixels(fg);
+	if(fg->bitmap && mask->bitmap) {
+		i64 w = de_min_int(fg->width, mask->width);
+		u8 xorval = (flags&DE_BITMAPFLAG_WHITEISTRNS) ? 0xff : 0x00;
+		int fb = fg->bytes_per_pixel;
+		int mb = mask->bytes_per_pixel;
+
+		// The first sample of a mask pixel is always its gray value (or red).
+		for(j=0; j<fg->height && j<mask->height; j++) {
+			const u8 *mp = &mask->bitmap[j*mask->width*mb];
+			u8 *fp = &fg->bitmap[j*fg->width*fb + (fb-1)];
+
+			for(i=0; i<w; i++) {
+				fp[i*fb] = mp[i*mb] ^ xorval;
+			}
+		}
+		return;
+	}
+
 	for(j=0; j<fg->height && j<mask->height; j++) {
 		for(i=0; i<fg->width && i<mask->width; i++) {
 			clr = de_bitmap_getpixel(mask, i, j);
@@ -653,11 +1053,12 @@ void de_bitmap_apply_mask(de_bitmap *fg, de_bitmap *mask,
 //  0x2: Warn if an invisible image was made opaque
 void de_optimize_image_alpha(de_bitmap *img, unsigned int flags)
 {
-	i64 i, j;
-	i64 k;
+	i64 i;
+	i64 npixels;
 	struct image_scan_results isres;
 
 	if(img->bytes_per_pixel!=2 && img->bytes_per_pixel!=4) return;
+	if(!img->bitmap) return;
 
 	scan_image(img, &isres);
 
@@ -675,12 +1076,17 @@ void de_optimize_image_alpha(de_bitmap *img, unsigned int flags)
 
 	// Note that the format conversion is done in-place. The extra memory used
 	// by the alpha channel is not de-allocated.
-	for(j=0; j<img->height; j++) {
-		for(i=0; i<img->width; i++) {
-			for(k=0; k<(i64)img->bytes_per_pixel-1; k++) {
-				img->bitmap[(j*img->width+i)*((i64)img->bytes_per_pixel-1) + k] =
-					img->bitmap[(j*img->width+i)*(img->bytes_per_pixel) + k];
-			}
+	npixels = img->width * img->height;
+	if(img->bytes_per_pixel==4) {
+		for(i=0; i<npixels; i++) {
+			img->bitmap[i*3]   = img->bitmap[i*4];
+			img->bitmap[i*3+1] = img->bitmap[i*4+1];
+			img->bitmap[i*3+2] = img->bitmap[i*4+2];
+		}
+	}
+	else {
+		for(i=0; i<npixels; i++) {
+			img->bitmap[i] = img->bitmap[i*2];
 		}
 	}
 
@@ -585,7 +585,7 @@ static void de_char_output_to_html_file(deark *c, struct de_char_context *charct
 			"not optimized. The HTML file may be very large.");
 	}
 
-	ofile = dbuf_create_output_file(c, "html", NULL, 0);
+	ofile = dbuf_create_output_file(c, "html", NULL, DE_CREATEFLAG_NO_RECURSE);
 
 	do_output_html_header(c, charctx, ectx, ofile);
 	for(i=0; i<charctx->nscreens; i++) {
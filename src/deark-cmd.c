@@ -57,6 +57,10 @@ struct cmdctx {
 	int to_zip;
 	int to_tar;
 	int from_stdin;
+	int batch_mode;
+	int batch_from_stdin;
+	const char *batch_list_filename;
+	int infomessages;
 	int to_ascii;
 	int to_oem;
 	int no_chcp;
@@ -127,6 +131,7 @@ static void print_help(deark *c)
 		" -main: Extract less data than usual.\n"
 		" -get <n>: Extract only file number <n>.\n"
 		" -d, -d2, -d3: Print additional information about the file.\n"
+		" -batch <listfile>: Process each of the files named in <listfile>.\n"
 		" -q, -noinfo, -nowarn: Print fewer messages than usual.\n"
 		" -modules: Print the names of all available modules.\n"
 		" -help, -h: Print this message.\n"
@@ -346,6 +351,15 @@ static void our_msgfn(deark *c, unsigned int flags, const char *s1)
 
 static void our_fatalerrorfn(deark *c)
 {
+	struct cmdctx *cc;
+
+	cc = de_get_userdata(c);
+	// A fatal error can leave things in an unknown state, so we can't just
+	// go on to the next file. At least say which file it happened on.
+	if(cc->batch_mode && cc->input_filename) {
+		de_printf(c, DE_MSGTYPE_MESSAGE, "Batch stopped due to fatal error "
+			"while processing %s\n", cc->input_filename);
+	}
 	de_puts(c, DE_MSGTYPE_MESSAGE, "Exiting\n");
 	de_exitprocess(1);
 }
@@ -404,7 +418,8 @@ enum opt_id_enum {
  DE_OPT_MAXFILESIZE, DE_OPT_MAXTOTALSIZE, DE_OPT_MAXIMGDIM,
  DE_OPT_PRINTMODULES, DE_OPT_DPREFIX, DE_OPT_EXTRLIST,
  DE_OPT_ONLYMODS, DE_OPT_DISABLEMODS, DE_OPT_ONLYDETECT, DE_OPT_NODETECT,
- DE_OPT_COLORMODE
+ DE_OPT_COLORMODE, DE_OPT_BATCH, DE_OPT_BATCHFROMSTDIN, DE_OPT_RECURSIVE,
+ DE_OPT_STATS
 };
 
 struct opt_struct {
@@ -437,11 +452,13 @@ struct opt_struct option_array[] = {
 	{ "aux",          DE_OPT_AUXONLY,      0 },
 	{ "a",            DE_OPT_EXTRACTALL,   0 },
 	{ "extractall",   DE_OPT_EXTRACTALL,   0 },
+	{ "recursive",    DE_OPT_RECURSIVE,    0 },
 	{ "zip",          DE_OPT_ZIP,          0 },
 	{ "tar",          DE_OPT_TAR,          0 },
 	{ "tostdout",     DE_OPT_TOSTDOUT,     0 },
 	{ "msgstostderr", DE_OPT_MSGSTOSTDERR, 0 },
 	{ "fromstdin",    DE_OPT_FROMSTDIN,    0 },
+	{ "batchfromstdin", DE_OPT_BATCHFROMSTDIN, 0 },
 	{ "color",        DE_OPT_COLOR,        0 },
 	{ "k",            DE_OPT_K,            0 },
 	{ "k2",           DE_OPT_K2,           0 },
@@ -452,6 +469,7 @@ struct opt_struct option_array[] = {
 	{ "license",      DE_OPT_LICENSE,      0 },
 	{ "id",           DE_OPT_ID,           0 },
 	{ "nochcp",       DE_OPT_NOCHCP,       0 },
+	{ "stats",        DE_OPT_STATS,        0 },
 	{ "enc",          DE_OPT_ENCODING,     1 },
 	{ "opt",          DE_OPT_EXTOPT,       1 },
 	{ "file",         DE_OPT_FILE,         1 },
@@ -479,6 +497,7 @@ struct opt_struct option_array[] = {
 	{ "onlydetect",   DE_OPT_ONLYDETECT,   1 },
 	{ "nodetect",     DE_OPT_NODETECT,     1 },
 	{ "colormode",    DE_OPT_COLORMODE,    1 },
+	{ "batch",        DE_OPT_BATCH,        1 },
 	{ NULL,           DE_OPT_NULL,         0 }
 };
 
@@ -651,6 +670,7 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 				break;
 			case DE_OPT_NOINFO:
 				de_set_infomessages(c, 0);
+				cc->infomessages = 0;
 				break;
 			case DE_OPT_NOWARN:
 				de_set_warnings(c, 0);
@@ -681,6 +701,7 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 			case DE_OPT_Q:
 				de_set_infomessages(c, 0);
 				de_set_warnings(c, 0);
+				cc->infomessages = 0;
 				break;
 			case DE_OPT_VERSION:
 				cc->special_command_flag = 1;
@@ -714,6 +735,12 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 			case DE_OPT_EXTRACTALL:
 				de_set_extract_level(c, 2);
 				break;
+			case DE_OPT_RECURSIVE:
+				de_set_recursive_mode(c, 1);
+				break;
+			case DE_OPT_STATS:
+				de_set_stats(c, 1);
+				break;
 			case DE_OPT_ZIP:
 				de_set_output_style(c, DE_OUTPUTSTYLE_ARCHIVE, DE_ARCHIVEFMT_ZIP);
 				cc->to_zip = 1;
@@ -733,6 +760,10 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 				de_set_input_style(c, DE_INPUTSTYLE_STDIN);
 				cc->from_stdin = 1;
 				break;
+			case DE_OPT_BATCHFROMSTDIN:
+				cc->batch_mode = 1;
+				cc->batch_from_stdin = 1;
+				break;
 			case DE_OPT_COLOR:
 				colormode_opt(cc, "auto");
 				break;
@@ -844,6 +875,10 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 				colormode_opt(cc, argv[i+1]);
 				if(cc->error_flag) return;
 				break;
+			case DE_OPT_BATCH:
+				cc->batch_mode = 1;
+				cc->batch_list_filename = argv[i+1];
+				break;
 			default:
 				de_printf(c, DE_MSGTYPE_MESSAGE, "Unrecognized option: %s\n", argv[i]);
 				cc->error_flag = 1;
@@ -875,7 +910,23 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 		return;
 	}
 
-	if(!cc->input_filename && !cc->special_command_flag && !cc->from_stdin) {
+	if(cc->batch_mode) {
+		if(cc->input_filename || cc->from_stdin || cc->to_stdout) {
+			de_puts(c, DE_MSGTYPE_MESSAGE, "Error: -batch can't be used with "
+				"an input filename, -fromstdin, or -tostdout\n");
+			cc->error_flag = 1;
+			return;
+		}
+
+		// Each input file needs its own output filenames.
+		if(!cc->option_k_level) {
+			cc->option_k_level = 2;
+		}
+		if(!cc->option_ka_level) {
+			cc->option_ka_level = 2;
+		}
+	}
+	else if(!cc->input_filename && !cc->special_command_flag && !cc->from_stdin) {
 		de_puts(c, DE_MSGTYPE_MESSAGE, "Error: Need an input filename\n");
 		cc->error_flag = 1;
 		cc->show_usage_message = 1;
@@ -898,6 +949,75 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 	set_output_archive_name(cc);
 }
 
+static deark *create_deark_object(struct cmdctx *cc)
+{
+	deark *c;
+
+	c = de_create();
+	de_set_userdata(c, (void*)cc);
+	de_set_fatalerror_callback(c, our_fatalerrorfn);
+	de_set_messages_callback(c, our_msgfn);
+	de_set_special_messages_callback(c, our_specialmsgfn);
+	return c;
+}
+
+// Process each file in the batch list, one at a time, each with its own
+// deark object. The options are re-parsed for each one, so that no state
+// carries over from one file to the next. (Only the membuf pool is shared,
+// so that memory can be recycled.)
+// A fatal error still stops the whole batch (see our_fatalerrorfn()).
+// Returns the exit status.
+static int run_batch(struct cmdctx *cc, int argc, char **argv)
+{
+	deark *main_c = cc->c;
+	struct de_filelist *fl = NULL;
+	struct de_membuf_pool *pool = NULL;
+	const char *fn;
+	int exit_status = 0;
+
+	fl = de_filelist_create(main_c, cc->batch_from_stdin ? NULL :
+		cc->batch_list_filename);
+	if(!fl) {
+		exit_status = 1;
+		goto done;
+	}
+	pool = de_membuf_pool_create();
+
+	while((fn = de_filelist_next(fl)) != NULL) {
+		deark *c;
+
+		c = create_deark_object(cc);
+		de_set_membuf_pool(c, pool);
+		cc->c = c;
+		cc->input_filename = NULL;
+		parse_cmdline(c, cc, argc, argv);
+		if(cc->error_flag) {
+			de_destroy(c);
+			exit_status = 1;
+			break;
+		}
+
+		cc->input_filename = fn;
+		de_set_input_filename(c, fn);
+		set_output_basename(cc);
+		set_output_archive_name(cc);
+
+		if(cc->infomessages) {
+			de_printf(c, DE_MSGTYPE_MESSAGE, "Input file: %s\n", fn);
+		}
+		if(!de_run(c)) {
+			exit_status = 1;
+		}
+		de_destroy(c);
+	}
+
+done:
+	cc->c = main_c;
+	de_filelist_destroy(main_c, fl);
+	de_membuf_pool_destroy(pool);
+	return exit_status;
+}
+
 static int main2(int argc, char **argv)
 {
 	deark *c = NULL;
@@ -906,13 +1026,9 @@ static int main2(int argc, char **argv)
 	int exit_status = 0;
 
 	cc = de_malloc(NULL, sizeof(struct cmdctx));
-	c = de_create();
+	cc->infomessages = 1;
+	c = create_deark_object(cc);
 	cc->c = c;
-
-	de_set_userdata(c, (void*)cc);
-	de_set_fatalerror_callback(c, our_fatalerrorfn);
-	de_set_messages_callback(c, our_msgfn);
-	de_set_special_messages_callback(c, our_specialmsgfn);
 	cc->plctx = de_platformdata_create();
 
 	if(argc<2) { // Empty command line
@@ -958,6 +1074,11 @@ static int main2(int argc, char **argv)
 	}
 #endif
 
+	if(cc->batch_mode) {
+		exit_status = run_batch(cc, argc, argv);
+		goto done;
+	}
+
 	ret = de_run(c);
 	if(!ret) {
 		exit_status = 1;
@@ -13,10 +13,35 @@
 #define DE_DUMMY_MAX_FILE_SIZE (1LL<<56)
 #define DE_MAX_MEMBUF_SIZE 2000000000
 #define DE_CACHE_SIZE 262144
+// On hosts with a small address space, don't try to memory-map files larger
+// than this.
+#define DE_MAX_MMAP_SIZE_32BIT 0x20000000LL // 512MiB
+
+// Try to memory-map the whole file, and use the mapping as the "cache".
+// Returns 1 on success. On failure, the caller should fall back to
+// populate_cache().
+static int populate_cache_using_mmap(dbuf *f)
+{
+	void *m;
+
+	if(f->btype!=DBUF_TYPE_IFILE) return 0;
+	if(f->len<1) return 0;
+	if(sizeof(void*)<8 && f->len>DE_MAX_MMAP_SIZE_32BIT) return 0;
+	if(!de_get_ext_option_bool(f->c, "mmap", 1)) return 0;
+
+	m = de_mmap_for_read(f->c, f->fp, f->len);
+	if(!m) return 0;
+
+	de_dbg3(f->c, "memory-mapped input file (%"I64_FMT" bytes)", f->len);
+	if(f->c->stats) f->c->stats->bytes_mapped += f->len;
+	f->cache = (u8*)m;
+	f->cache_bytes_used = f->len;
+	f->cache_is_mmapped = 1;
+	return 1;
+}
 
 // Fill the cache that remembers the first part of the file.
-// TODO: We should probably use memory-mapped files instead when possible,
-// but this is simple and portable, and does most of what we need.
+// This is used if the file can't be memory-mapped.
 static void populate_cache(dbuf *f)
 {
 	i64 bytes_to_read;
@@ -33,6 +58,7 @@ static void populate_cache(dbuf *f)
 	de_fseek(f->fp, 0, SEEK_SET);
 	bytes_read = fread(f->cache, 1, (size_t)bytes_to_read, f->fp);
 	f->cache_bytes_used = bytes_read;
+	if(f->c->stats) f->c->stats->bytes_read += bytes_read;
 	f->file_pos_known = 0;
 }
 
@@ -75,12 +101,218 @@ static void populate_cache_from_pipe(dbuf *f)
 		bytes_read = fread(&f->cache[f->cache_bytes_used], 1, (size_t)bytes_to_read, fp);
 		if(bytes_read<1 || bytes_read>bytes_to_read) break;
 		f->cache_bytes_used += bytes_read;
+		if(f->c->stats) f->c->stats->bytes_read += bytes_read;
 		if(feof(fp) || ferror(fp)) break;
 	}
 
 	f->len = f->cache_bytes_used;
 }
 
+// The page cache is used for the parts of an IFILE that are not in ->cache
+// (so, only if the file could not be memory-mapped). It holds a number of
+// fixed-size, aligned, blocks of the file, and discards the least recently
+// used block when it needs room for a new one.
+
+#define DE_PAGECACHE_PAGESIZE 16384
+#define DE_PAGECACHE_DEFAULT_SIZE 1048576
+
+struct de_pagecache_page {
+	i64 pagenum; // -1 if this page is not in use
+	u8 *data;
+	struct de_pagecache_page *hash_next;
+	struct de_pagecache_page *newer; // Links for the LRU list
+	struct de_pagecache_page *older;
+};
+
+struct de_pagecache {
+	UI npages;
+	UI hash_mask;
+	struct de_pagecache_page *pages; // array[npages]
+	struct de_pagecache_page **hashtable; // array[hash_mask+1]
+	struct de_pagecache_page *newest;
+	struct de_pagecache_page *oldest;
+	u8 *mem;
+	i64 num_hits;
+	i64 num_misses;
+};
+
+static void pagecache_create(dbuf *f)
+{
+	deark *c = f->c;
+	struct de_pagecache *pc;
+	const char *s;
+	i64 cache_size = DE_PAGECACHE_DEFAULT_SIZE;
+	UI npages;
+	UI nbuckets;
+	UI k;
+
+	s = de_get_ext_option(c, "pagecache");
+	if(s) {
+		cache_size = de_atoi64(s);
+	}
+	// A size of 0 (or less) disables the cache.
+	if(cache_size<=0) return;
+	npages = (UI)de_min_int(cache_size/DE_PAGECACHE_PAGESIZE, 65536);
+	if(npages<2) return;
+
+	nbuckets = 1;
+	while(nbuckets<npages) nbuckets <<= 1;
+
+	pc = de_malloc(c, sizeof(struct de_pagecache));
+	pc->npages = npages;
+	pc->hash_mask = nbuckets-1;
+	pc->pages = de_mallocarray(c, (i64)npages, sizeof(struct de_pagecache_page));
+	pc->hashtable = de_mallocarray(c, (i64)nbuckets, sizeof(struct de_pagecache_page*));
+	pc->mem = de_malloc(c, (i64)npages*DE_PAGECACHE_PAGESIZE);
+
+	// Start with all pages unused, and linked into the LRU list.
+	for(k=0; k<npages; k++) {
+		struct de_pagecache_page *pg = &pc->pages[k];
+
+		pg->pagenum = -1;
+		pg->data = &pc->mem[(i64)k*DE_PAGECACHE_PAGESIZE];
+		pg->newer = (k>0) ? &pc->pages[k-1] : NULL;
+		pg->older = (k+1<npages) ? &pc->pages[k+1] : NULL;
+	}
+	pc->newest = &pc->pages[0];
+	pc->oldest = &pc->pages[npages-1];
+
+	de_dbg3(c, "page cache: %u pages of %d bytes", npages, DE_PAGECACHE_PAGESIZE);
+	f->pagecache = pc;
+}
+
+static void pagecache_destroy(dbuf *f)
+{
+	deark *c = f->c;
+	struct de_pagecache *pc = f->pagecache;
+
+	if(!pc) return;
+	de_dbg2(c, "page cache: %"I64_FMT" hits, %"I64_FMT" misses",
+		pc->num_hits, pc->num_misses);
+	de_free(c, pc->mem);
+	de_free(c, pc->hashtable);
+	de_free(c, pc->pages);
+	de_free(c, pc);
+	f->pagecache = NULL;
+}
+
+static void pagecache_hash_remove(struct de_pagecache *pc, struct de_pagecache_page *pg)
+{
+	struct de_pagecache_page **pp;
+
+	pp = &pc->hashtable[(UI)pg->pagenum & pc->hash_mask];
+	while(*pp) {
+		if(*pp == pg) {
+			*pp = pg->hash_next;
+			break;
+		}
+		pp = &(*pp)->hash_next;
+	}
+	pg->hash_next = NULL;
+}
+
+// Move pg to the "newest" end of the LRU list.
+static void pagecache_touch(struct de_pagecache *pc, struct de_pagecache_page *pg)
+{
+	if(pc->newest == pg) return;
+
+	// Unlink
+	if(pg->newer) pg->newer->older = pg->older;
+	if(pg->older) pg->older->newer = pg->newer;
+	if(pc->oldest == pg) pc->oldest = pg->newer;
+
+	// Relink at the front
+	pg->newer = NULL;
+	pg->older = pc->newest;
+	pc->newest->newer = pg;
+	pc->newest = pg;
+}
+
+// Read directly from the file, bypassing all caches.
+// Returns the number of bytes read.
+static i64 read_from_ifile(dbuf *f, u8 *buf, i64 pos, i64 len)
+{
+	i64 bytes_read;
+
+	if(!f->fp) {
+		de_err(f->c, "Internal: File not open");
+		de_fatalerror(f->c);
+		return 0;
+	}
+
+	// For performance reasons, don't call fseek if we're already at the
+	// right position.
+	if(!f->file_pos_known || f->file_pos!=pos) {
+		de_fseek(f->fp, pos, SEEK_SET);
+	}
+
+	bytes_read = (i64)fread(buf, 1, (size_t)len, f->fp);
+	if(f->c->stats) f->c->stats->bytes_read += bytes_read;
+
+	f->file_pos = pos + bytes_read;
+	f->file_pos_known = 1;
+	return bytes_read;
+}
+
+static struct de_pagecache_page *pagecache_get_page(dbuf *f, i64 pagenum)
+{
+	struct de_pagecache *pc = f->pagecache;
+	struct de_pagecache_page *pg;
+	UI bucket;
+	i64 pagepos;
+	i64 nbytes;
+	i64 bytes_read;
+
+	bucket = (UI)pagenum & pc->hash_mask;
+	for(pg=pc->hashtable[bucket]; pg; pg=pg->hash_next) {
+		if(pg->pagenum == pagenum) {
+			pc->num_hits++;
+			if(f->c->stats) f->c->stats->cache_hits++;
+			pagecache_touch(pc, pg);
+			return pg;
+		}
+	}
+
+	// Not found. Recycle the least recently used page.
+	pc->num_misses++;
+	if(f->c->stats) f->c->stats->cache_misses++;
+	pg = pc->oldest;
+	if(pg->pagenum >= 0) {
+		pagecache_hash_remove(pc, pg);
+	}
+
+	pagepos = pagenum*DE_PAGECACHE_PAGESIZE;
+	nbytes = de_min_int(DE_PAGECACHE_PAGESIZE, f->len - pagepos);
+	bytes_read = read_from_ifile(f, pg->data, pagepos, nbytes);
+	if(bytes_read < DE_PAGECACHE_PAGESIZE) {
+		de_zeromem(&pg->data[bytes_read], (size_t)(DE_PAGECACHE_PAGESIZE-bytes_read));
+	}
+
+	pg->pagenum = pagenum;
+	pg->hash_next = pc->hashtable[bucket];
+	pc->hashtable[bucket] = pg;
+	pagecache_touch(pc, pg);
+	return pg;
+}
+
+// Caller must ensure that all the bytes requested are in the file.
+static void pagecache_read(dbuf *f, u8 *buf, i64 pos, i64 len)
+{
+	while(len>0) {
+		struct de_pagecache_page *pg;
+		i64 offs_in_page;
+		i64 n;
+
+		pg = pagecache_get_page(f, pos/DE_PAGECACHE_PAGESIZE);
+		offs_in_page = pos%DE_PAGECACHE_PAGESIZE;
+		n = de_min_int(len, DE_PAGECACHE_PAGESIZE - offs_in_page);
+		de_memcpy(buf, &pg->data[offs_in_page], (size_t)n);
+		buf += n;
+		pos += n;
+		len -= n;
+	}
+}
+
 // Read len bytes, starting at file position pos, into buf.
 // Unread bytes will be set to 0.
 void dbuf_read(dbuf *f, u8 *buf, i64 pos, i64 len)
@@ -91,31 +323,45 @@ void dbuf_read(dbuf *f, u8 *buf, i64 pos, i64 len)
 
 	c = f->c;
 
-	if(pos < 0) {
-		if((-pos) >= len) {
-			// All requested bytes are before the beginning of the file
-			de_zeromem(buf, (size_t)len);
-			return;
+	// If f is a nested dbuf, walk up to the dbuf that actually holds the
+	// data, translating the position as we go. At each level, the requested
+	// range is clipped to the bounds of that dbuf.
+	while(1) {
+		if(pos < 0) {
+			if((-pos) >= len) {
+				// All requested bytes are before the beginning of the file
+				de_zeromem(buf, (size_t)len);
+				return;
+			}
+			// Some requested bytes are before the beginning of the file.
+			// Zero out the ones that are:
+			de_zeromem(buf, (size_t)(-pos));
+			// And adjust the parameters:
+			buf += (-pos);
+			len -= (-pos);
+			pos = 0;
 		}
-		// Some requested bytes are before the beginning of the file.
-		// Zero out the ones that are:
-		de_zeromem(buf, (size_t)(-pos));
-		// And adjust the parameters:
-		buf += (-pos);
-		len -= (-pos);
-		pos = 0;
-	}
 
-	bytes_to_read = len;
-	if(pos >= f->len) {
-		bytes_to_read = 0;
-	}
-	else if(pos + bytes_to_read > f->len) {
-		bytes_to_read = f->len - pos;
-	}
+		bytes_to_read = len;
+		if(pos >= f->len) {
+			bytes_to_read = 0;
+		}
+		else if(pos + bytes_to_read > f->len) {
+			bytes_to_read = f->len - pos;
+		}
 
-	if(bytes_to_read<1) {
-		goto done_read;
+		if(bytes_to_read<1) {
+			goto done_read;
+		}
+
+		if(f->btype!=DBUF_TYPE_IDBUF) break;
+
+		if(bytes_to_read < len) {
+			de_zeromem(buf+bytes_to_read, (size_t)(len - bytes_to_read));
+			len = bytes_to_read;
+		}
+		pos += f->offset_into_parent_dbuf;
+		f = f->parent_dbuf;
 	}
 
 	// If the data we need is all cached, get it from cache.
@@ -125,35 +371,20 @@ void dbuf_read(dbuf *f, u8 *buf, i64 pos, i64 len)
 	{
 		de_memcpy(buf, &f->cache[pos], (size_t)bytes_to_read);
 		bytes_read = bytes_to_read;
+		if(c->stats) c->stats->cache_hits++;
 		goto done_read;
 	}
 
 	switch(f->btype) {
 	case DBUF_TYPE_IFILE:
-		if(!f->fp) {
-			de_err(c, "Internal: File not open");
-			de_fatalerror(c);
-			goto done_read;
-		}
-
-		// For performance reasons, don't call fseek if we're already at the
-		// right position.
-		if(!f->file_pos_known || f->file_pos!=pos) {
-			de_fseek(f->fp, pos, SEEK_SET);
+		if(f->pagecache && bytes_to_read<=DE_PAGECACHE_PAGESIZE) {
+			pagecache_read(f, buf, pos, bytes_to_read);
+			bytes_read = bytes_to_read;
+			break;
 		}
 
-		bytes_read = fread(buf, 1, (size_t)bytes_to_read, f->fp);
-
-		f->file_pos = pos + bytes_read;
-		f->file_pos_known = 1;
-		break;
-
-	case DBUF_TYPE_IDBUF:
-		// Recursive call to the parent dbuf.
-		dbuf_read(f->parent_dbuf, buf, f->offset_into_parent_dbuf+pos, bytes_to_read);
-
-		// The parent dbuf always writes 'bytes_to_read' bytes.
-		bytes_read = bytes_to_read;
+		bytes_read = read_from_ifile(f, buf, pos, bytes_to_read);
+		if(c->stats) c->stats->cache_misses++;
 		break;
 
 	case DBUF_TYPE_MEMBUF:
@@ -174,6 +405,64 @@ done_read:
 	}
 }
 
+// If f is a nested dbuf, find the dbuf that ultimately holds its data, and
+// translate *ppos accordingly.
+// Returns NULL if the range is not entirely within the bounds of every dbuf
+// in the chain.
+static dbuf *resolve_input_range(dbuf *f, i64 *ppos, i64 len)
+{
+	i64 pos = *ppos;
+
+	while(1) {
+		if(pos<0 || len<0 || pos+len > f->len) return NULL;
+		if(f->btype!=DBUF_TYPE_IDBUF) break;
+		pos += f->offset_into_parent_dbuf;
+		f = f->parent_dbuf;
+	}
+	*ppos = pos;
+	return f;
+}
+
+static const u8 *get_ptr_internal(dbuf *f, i64 pos, i64 len, dbuf **proot)
+{
+	f = resolve_input_range(f, &pos, len);
+	if(proot) *proot = f;
+	if(!f) return NULL;
+
+	if(f->cache && pos+len <= f->cache_bytes_used) {
+		if(f->c->stats) f->c->stats->cache_hits++;
+		return &f->cache[pos];
+	}
+	if(f->btype==DBUF_TYPE_MEMBUF && f->membuf_buf) {
+		return &f->membuf_buf[pos];
+	}
+	return NULL;
+}
+
+// Returns a pointer to the 'len' bytes of f starting at 'pos', if they are
+// all contiguous in memory. This is the case for membufs, memory-mapped or
+// cached files, and subfiles of those. Otherwise returns NULL.
+// The pointer is read-only, and only valid until f, or any dbuf it is a
+// subfile of, is written to or closed.
+const u8 *dbuf_get_ptr(dbuf *f, i64 pos, i64 len)
+{
+	return get_ptr_internal(f, pos, len, NULL);
+}
+
+// Like dbuf_get_ptr(), but if the bytes are not directly available, read
+// them into 'scratch' (which must have room for 'len' bytes), and return
+// 'scratch'. Never returns NULL.
+// As with dbuf_read(), out-of-range bytes are treated as 0.
+const u8 *dbuf_borrow(dbuf *f, i64 pos, i64 len, u8 *scratch)
+{
+	const u8 *p;
+
+	p = get_ptr_internal(f, pos, len, NULL);
+	if(p) return p;
+	dbuf_read(f, scratch, pos, len);
+	return scratch;
+}
+
 // A function that works a little more like a standard read/fread function than
 // does dbuf_read. It returns the number of bytes read, won't read past end of
 // file, and helps track the file position.
@@ -202,6 +491,12 @@ u8 dbuf_getbyte(dbuf *f, i64 pos)
 		// so that the "cache2" feature isn't used.
 		return f->membuf_buf[pos];
 	}
+	if(f->btype==DBUF_TYPE_IDBUF) {
+		const u8 *p;
+
+		p = get_ptr_internal(f, pos, 1, NULL);
+		if(p) return *p;
+	}
 
 	// TODO: I don't like that cache2 exists, but without it some large images
 	// are decoded too slowly (especially on Windows), and I haven't figured out
@@ -699,23 +994,46 @@ static int copy_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
 	return 1;
 }
 
+// Copy from a dbuf to itself (or from a subfile of it). The data is never
+// written directly from the source's memory, because writing to outf can
+// move that memory.
+static void dbuf_copy_to_self(dbuf *inf, i64 input_offset, i64 input_len, dbuf *outf)
+{
+	u8 *buf;
+	i64 buf_size;
+	i64 pos = 0;
+
+	buf_size = de_min_int(input_len, 65536);
+	buf = de_malloc(outf->c, buf_size);
+	while(pos < input_len) {
+		i64 n;
+
+		n = de_min_int(input_len - pos, buf_size);
+		dbuf_read(inf, buf, input_offset+pos, n);
+		dbuf_write(outf, buf, n);
+		pos += n;
+	}
+	de_free(outf->c, buf);
+}
+
 void dbuf_copy(dbuf *inf, i64 input_offset, i64 input_len, dbuf *outf)
 {
 	u8 tmpbuf[256];
+	const u8 *p;
+	dbuf *root = NULL;
 
-	// Fast paths, if the data to copy is all in memory
+	if(input_len<=0) return;
 
-	if(inf->cache &&
-		(input_offset>=0) && (input_offset+input_len<=inf->cache_bytes_used))
-	{
-		dbuf_write(outf, &inf->cache[input_offset], input_len);
+	// Fast path, if the data to copy is all in memory.
+	p = get_ptr_internal(inf, input_offset, input_len, &root);
+	if(root==outf) {
+		// It is allowed to copy from a membuf to itself, but then no pointer
+		// into its memory can be used (here, or by dbuf_buffered_read()).
+		dbuf_copy_to_self(inf, input_offset, input_len, outf);
 		return;
 	}
-
-	if(inf->btype==DBUF_TYPE_MEMBUF &&
-		(input_offset>=0) && (input_offset+input_len<=inf->len))
-	{
-		dbuf_write(outf, &inf->membuf_buf[input_offset], input_len);
+	if(p) {
+		dbuf_write(outf, p, input_len);
 		return;
 	}
 
@@ -967,13 +1285,12 @@ static int dbufmemcmp_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
 int dbuf_memcmp(dbuf *f, i64 pos, const void *s, size_t n)
 {
 	u8 buf1[128];
+	const u8 *p;
 
-	if(f->cache &&
-		pos >= 0 &&
-		pos + (i64)n <= f->cache_bytes_used)
-	{
-		// Fastest path: Compare directly to cache.
-		return de_memcmp(s, &f->cache[pos], n);
+	// Fastest path: Compare directly to the data in memory.
+	p = dbuf_get_ptr(f, pos, (i64)n);
+	if(p) {
+		return de_memcmp(s, p, n);
 	}
 
 	if(n<=sizeof(buf1)) {
@@ -992,11 +1309,28 @@ int dbuf_create_file_from_slice(dbuf *inf, i64 pos, i64 data_size,
 	dbuf *f;
 	f = dbuf_create_output_file(inf->c, ext, fi, createflags);
 	if(!f) return 0;
-	dbuf_copy(inf, pos, data_size, f);
+	if(!dbuf_output_is_skipped(f)) {
+		dbuf_copy(inf, pos, data_size, f);
+	}
 	dbuf_close(f);
 	return 1;
 }
 
+// Returns nonzero if f is an output file that is not being extracted (due to
+// -firstfile, -maxfiles, -get, -a, etc.), so that nothing written to it will
+// ever be used.
+// A module that knows where a member file's data is can check this after
+// creating the output file, and skip decompressing the data.
+// Does not return nonzero in -l mode, so that decompression errors are still
+// reported.
+int dbuf_output_is_skipped(dbuf *f)
+{
+	if(!f) return 1;
+	if(!f->is_managed) return 0;
+	return (f->btype==DBUF_TYPE_NULL && !f->recurse_on_close &&
+		!f->c->list_mode);
+}
+
 static void finfo_shallow_copy(deark *c, de_finfo *src, de_finfo *dst)
 {
 	UI k;
@@ -1013,16 +1347,149 @@ static void finfo_shallow_copy(deark *c, de_finfo *src, de_finfo *dst)
 	dst->hotspot_y = src->hotspot_y;
 }
 
+// Membuf storage is allocated in power-of-2 size classes, and when a membuf
+// is closed (or grows), its storage is kept for reuse, up to some limits.
+// Recycled storage is not zeroed; nothing reads a membuf past its length.
+#define MEMBUF_POOL_MIN_SHIFT     10 // 1KiB
+#define MEMBUF_POOL_MAX_SHIFT     20 // 1MiB
+#define MEMBUF_POOL_NUM_CLASSES   (MEMBUF_POOL_MAX_SHIFT-MEMBUF_POOL_MIN_SHIFT+1)
+#define MEMBUF_POOL_MAX_PER_CLASS 8
+#define MEMBUF_POOL_MAX_BYTES     (16*1024*1024)
+#define MEMBUF_POOL_MAX_DBUFS     16
+
+struct de_membuf_pool {
+	i64 total_bytes;
+	UI num_bufs[MEMBUF_POOL_NUM_CLASSES];
+	u8 *bufs[MEMBUF_POOL_NUM_CLASSES][MEMBUF_POOL_MAX_PER_CLASS];
+	UI num_dbufs;
+	dbuf *dbufs[MEMBUF_POOL_MAX_DBUFS];
+};
+
+struct de_membuf_pool *de_membuf_pool_create_internal(void)
+{
+	return de_malloc(NULL, sizeof(struct de_membuf_pool));
+}
+
+void de_membuf_pool_destroy_internal(struct de_membuf_pool *pool)
+{
+	UI i, k;
+
+	if(!pool) return;
+	for(i=0; i<MEMBUF_POOL_NUM_CLASSES; i++) {
+		for(k=0; k<pool->num_bufs[i]; k++) {
+			de_free(NULL, pool->bufs[i][k]);
+		}
+	}
+	for(k=0; k<pool->num_dbufs; k++) {
+		de_free(NULL, pool->dbufs[k]);
+	}
+	de_free(NULL, pool);
+}
+
+static struct de_membuf_pool *get_membuf_pool(deark *c)
+{
+	if(!c->membuf_pool) {
+		c->membuf_pool = de_membuf_pool_create_internal();
+		c->membuf_pool_is_owned = 1;
+	}
+	return c->membuf_pool;
+}
+
+// Returns the size class for a buffer of n bytes, or -1 if it's too large
+// to be pooled.
+static int membuf_size_class(i64 n)
+{
+	int cls = 0;
+
+	if(n > ((i64)1<<MEMBUF_POOL_MAX_SHIFT)) return -1;
+	while(((i64)1<<(MEMBUF_POOL_MIN_SHIFT+cls)) < n) cls++;
+	return cls;
+}
+
+// Allocate storage for a membuf. *pnbytes may be increased, up to
+// max_nbytes, to make it a size class that can be recycled.
+static u8 *membuf_storage_alloc(deark *c, i64 *pnbytes, i64 max_nbytes)
+{
+	struct de_membuf_pool *pool;
+	int cls;
+	i64 cls_size;
+
+	if(c->stats) c->stats->membuf_allocs++;
+	cls = membuf_size_class(*pnbytes);
+	if(cls<0) goto plain_alloc;
+	cls_size = (i64)1<<(MEMBUF_POOL_MIN_SHIFT+cls);
+	if(cls_size > max_nbytes) goto plain_alloc;
+	*pnbytes = cls_size;
+
+	pool = get_membuf_pool(c);
+	if(pool->num_bufs[cls]>0) {
+		pool->num_bufs[cls]--;
+		pool->total_bytes -= cls_size;
+		if(c->stats) {
+			c->stats->membuf_pool_hits++;
+			c->stats->membuf_pool_bytes_reused += cls_size;
+		}
+		return pool->bufs[cls][pool->num_bufs[cls]];
+	}
+
+plain_alloc:
+	return de_malloc(c, *pnbytes);
+}
+
+static void membuf_storage_free(deark *c, u8 *buf, i64 nbytes)
+{
+	struct de_membuf_pool *pool;
+	int cls;
+
+	if(!buf) return;
+	cls = membuf_size_class(nbytes);
+	if(cls<0 || nbytes != ((i64)1<<(MEMBUF_POOL_MIN_SHIFT+cls))) goto plain_free;
+	pool = get_membuf_pool(c);
+	if(pool->num_bufs[cls] >= MEMBUF_POOL_MAX_PER_CLASS) goto plain_free;
+	if(pool->total_bytes + nbytes > MEMBUF_POOL_MAX_BYTES) goto plain_free;
+
+	pool->bufs[cls][pool->num_bufs[cls]] = buf;
+	pool->num_bufs[cls]++;
+	pool->total_bytes += nbytes;
+	return;
+
+plain_free:
+	de_free(c, buf);
+}
+
 static dbuf *create_dbuf_lowlevel(deark *c)
 {
 	dbuf *f;
+	struct de_membuf_pool *pool;
 
-	f = de_malloc(c, sizeof(dbuf));
+	pool = get_membuf_pool(c);
+	if(pool->num_dbufs>0) {
+		pool->num_dbufs--;
+		f = pool->dbufs[pool->num_dbufs];
+		de_zeromem(f, sizeof(dbuf));
+		if(c->stats) c->stats->dbuf_structs_reused++;
+	}
+	else {
+		f = de_malloc(c, sizeof(dbuf));
+	}
 	f->c = c;
 	f->cache2_pos = -1; // Any offset outside the bounds of the file will do.
 	return f;
 }
 
+static void destroy_dbuf_lowlevel(deark *c, dbuf *f)
+{
+	struct de_membuf_pool *pool;
+
+	pool = get_membuf_pool(c);
+	if(pool->num_dbufs < MEMBUF_POOL_MAX_DBUFS) {
+		pool->dbufs[pool->num_dbufs] = f;
+		pool->num_dbufs++;
+		return;
+	}
+	de_free(c, f);
+}
+
 // Create or open a file for writing, that is *not* one of the usual
 // "output.000.ext" files we extract from the input file.
 //
@@ -1221,12 +1688,14 @@ dbuf *dbuf_create_output_file(deark *c, const char *ext1, de_finfo *fi,
 		}
 	}
 
-	if(file_index < c->first_output_file) {
+	// (-firstfile and -maxfiles only apply to files extracted from the primary
+	// input file, not to files found by -recursive.)
+	if(c->recursion_depth==0 && file_index < c->first_output_file) {
 		f->btype = DBUF_TYPE_NULL;
 		goto done;
 	}
 
-	if(c->max_output_files>=0 &&
+	if(c->recursion_depth==0 && c->max_output_files>=0 &&
 		file_index >= c->first_output_file + c->max_output_files)
 	{
 		f->btype = DBUF_TYPE_NULL;
@@ -1235,6 +1704,13 @@ dbuf *dbuf_create_output_file(deark *c, const char *ext1, de_finfo *fi,
 
 	c->num_files_extracted++;
 
+	if(c->recursive_mode && !is_directory &&
+		!(createflags & DE_CREATEFLAG_NO_RECURSE) &&
+		c->recursion_depth < c->recursion_max_depth)
+	{
+		f->recurse_on_close = 1;
+	}
+
 	if(c->extrlist_dbuf) {
 		dbuf_printf(c->extrlist_dbuf, "%s\n", f->name);
 		dbuf_flush(c->extrlist_dbuf);
@@ -1260,21 +1736,13 @@ dbuf *dbuf_create_output_file(deark *c, const char *ext1, de_finfo *fi,
 		de_tar_start_member_file(c, f);
 	}
 	else if(c->output_style==DE_OUTPUTSTYLE_ARCHIVE) { // ZIP
-		i64 initial_alloc;
 		de_info(c, "Adding %s to ZIP file", f->name);
-		f->btype = DBUF_TYPE_MEMBUF;
-		f->max_len_hard = DE_MAX_MEMBUF_SIZE;
-		if(is_directory) {
-			// A directory entry is not expected to have any data associated
-			// with it (besides the files it contains).
-			initial_alloc = 16;
-		}
-		else {
-			initial_alloc = 65536;
-		}
-		f->membuf_buf = de_malloc(c, initial_alloc);
-		f->membuf_alloc = initial_alloc;
-		f->write_memfile_to_zip_archive = 1;
+		f->btype = DBUF_TYPE_CUSTOM;
+		// We don't write Zip64 extended information for member files, so
+		// they are limited to 4GB.
+		f->max_len_hard = de_min_int(c->max_output_file_size, 0xffffffffLL);
+		f->writing_to_zip_archive = 1;
+		de_zip_start_member_file(c, f);
 	}
 	else if(c->output_style==DE_OUTPUTSTYLE_STDOUT) {
 		de_info(c, "Writing %s to [stdout]", f->name);
@@ -1291,15 +1759,68 @@ dbuf *dbuf_create_output_file(deark *c, const char *ext1, de_finfo *fi,
 		if(!f->fp) {
 			de_err(c, "Failed to write %s: %s", f->name, msgbuf);
 			f->btype = DBUF_TYPE_NULL;
+			f->recurse_on_close = 0;
 			c->serious_error_flag = 1;
 		}
 	}
 
 done:
+	if(f->recurse_on_close && f->btype!=DBUF_TYPE_MEMBUF) {
+		// We'll need our own copy of the file's contents.
+		f->recursion_copy = dbuf_create_membuf(c, 0, 0);
+	}
 	de_free(c, name_from_finfo);
 	return f;
 }
 
+static void recursion_give_up(dbuf *f)
+{
+	de_dbg(f->c, "not recursing into %s: too large", f->name);
+	f->recurse_on_close = 0;
+	if(f->recursion_copy) {
+		dbuf_close(f->recursion_copy);
+		f->recursion_copy = NULL;
+	}
+}
+
+static int recursion_size_ok(dbuf *f, i64 newlen, i64 bytes_to_add)
+{
+	deark *c = f->c;
+
+	if(newlen > c->recursion_max_file_size) return 0;
+	if(c->recursion_total_size + bytes_to_add > c->recursion_max_total_size) return 0;
+	return 1;
+}
+
+static void write_recursion_copy(dbuf *f, const u8 *m, i64 len)
+{
+	if(!recursion_size_ok(f, f->recursion_copy->len + len, len)) {
+		recursion_give_up(f);
+		return;
+	}
+	f->c->recursion_total_size += len;
+	dbuf_write(f->recursion_copy, m, len);
+}
+
+static void do_recursion_on_close(dbuf *f)
+{
+	dbuf *data;
+
+	f->recurse_on_close = 0;
+	if(f->recursion_copy) {
+		data = f->recursion_copy;
+	}
+	else {
+		if(!recursion_size_ok(f, f->len, f->len)) {
+			recursion_give_up(f);
+			return;
+		}
+		f->c->recursion_total_size += f->len;
+		data = f;
+	}
+	de_recurse_into_file(f->c, data, f->name);
+}
+
 static void do_on_dbuf_size_exceeded(dbuf *f)
 {
 	de_err(f->c, "Maximum %s size of %"I64_FMT" bytes exceeded",
@@ -1308,6 +1829,18 @@ static void do_on_dbuf_size_exceeded(dbuf *f)
 	de_fatalerror(f->c);
 }
 
+// For -stats: Record a change in the amount of memory allocated for membufs.
+static void stats_track_membuf(deark *c, i64 delta)
+{
+	struct de_stats *st = c->stats;
+
+	if(!st) return;
+	st->membuf_cur_bytes += delta;
+	if(st->membuf_cur_bytes > st->membuf_peak_bytes) {
+		st->membuf_peak_bytes = st->membuf_cur_bytes;
+	}
+}
+
 dbuf *dbuf_create_membuf(deark *c, i64 initialsize, unsigned int flags)
 {
 	dbuf *f;
@@ -1320,8 +1853,9 @@ dbuf *dbuf_create_membuf(deark *c, i64 initialsize, unsigned int flags)
 		if(initialsize > f->max_len_hard) {
 			do_on_dbuf_size_exceeded(f);
 		}
-		f->membuf_buf = de_malloc(c, initialsize);
 		f->membuf_alloc = initialsize;
+		f->membuf_buf = membuf_storage_alloc(c, &f->membuf_alloc, f->max_len_hard);
+		stats_track_membuf(c, f->membuf_alloc);
 	}
 
 	if(flags&0x01) {
@@ -1344,6 +1878,14 @@ static void membuf_append(dbuf *f, const u8 *m, i64 mlen)
 	if(mlen<=0) return;
 
 	if(mlen > f->membuf_alloc - f->len) {
+		i64 m_offset = -1;
+
+		// If m points into our own buffer, it won't be valid after the
+		// buffer is moved, so remember where it was.
+		if(f->membuf_buf && m>=f->membuf_buf && m<&f->membuf_buf[f->len]) {
+			m_offset = (i64)(m - f->membuf_buf);
+		}
+
 		// Need to allocate more space
 		new_alloc_size = (f->membuf_alloc + mlen)*2;
 		if(new_alloc_size<1024) new_alloc_size=1024;
@@ -1353,8 +1895,25 @@ static void membuf_append(dbuf *f, const u8 *m, i64 mlen)
 		if(f->len + mlen > f->max_len_hard) {
 			do_on_dbuf_size_exceeded(f);
 		}
-		f->membuf_buf = de_realloc(f->c, f->membuf_buf, f->membuf_alloc, new_alloc_size);
+		if(membuf_size_class(new_alloc_size)>=0 || !f->membuf_buf) {
+			u8 *new_buf;
+
+			new_buf = membuf_storage_alloc(f->c, &new_alloc_size, f->max_len_hard);
+			if(f->len>0) {
+				de_memcpy(new_buf, f->membuf_buf, (size_t)f->len);
+			}
+			membuf_storage_free(f->c, f->membuf_buf, f->membuf_alloc);
+			f->membuf_buf = new_buf;
+		}
+		else {
+			// Too large to be pooled. realloc() may be able to avoid copying.
+			f->membuf_buf = de_realloc(f->c, f->membuf_buf, f->membuf_alloc, new_alloc_size);
+		}
+		stats_track_membuf(f->c, new_alloc_size - f->membuf_alloc);
 		f->membuf_alloc = new_alloc_size;
+		if(m_offset>=0) {
+			m = &f->membuf_buf[m_offset];
+		}
 	}
 
 	de_memcpy(&f->membuf_buf[f->len], m, (size_t)mlen);
@@ -1374,6 +1933,10 @@ void dbuf_write(dbuf *f, const u8 *m, i64 len)
 		f->writelistener_cb(f, f->userdata_for_writelistener, m, len);
 	}
 
+	if(f->recursion_copy) {
+		write_recursion_copy(f, m, len);
+	}
+
 	switch(f->btype) {
 	case DBUF_TYPE_OFILE:
 	case DBUF_TYPE_STDOUT:
@@ -1381,7 +1944,15 @@ void dbuf_write(dbuf *f, const u8 *m, i64 len)
 		if(f->c->debug_level>=3) {
 			de_dbg3(f->c, "writing %"I64_FMT" bytes to %s", len, f->name);
 		}
-		fwrite(m, 1, (size_t)len, f->fp);
+		if(f->c->stats) {
+			de_stats_begin(f->c, DE_STATS_PHASE_OUTPUT);
+			fwrite(m, 1, (size_t)len, f->fp);
+			de_stats_end(f->c, DE_STATS_PHASE_OUTPUT);
+			f->c->stats->bytes_written += len;
+		}
+		else {
+			fwrite(m, 1, (size_t)len, f->fp);
+		}
 		f->len += len;
 		return;
 	case DBUF_TYPE_MEMBUF:
@@ -1688,7 +2259,12 @@ dbuf *dbuf_open_input_file(deark *c, const char *fn)
 	}
 
 	if(!f->cache && f->cache_policy==DE_CACHE_POLICY_ENABLED) {
-		populate_cache(f);
+		if(!populate_cache_using_mmap(f)) {
+			populate_cache(f);
+			if(f->len > f->cache_bytes_used) {
+				pagecache_create(f);
+			}
+		}
 	}
 
 	return f;
@@ -1743,18 +2319,23 @@ void dbuf_set_writelistener(dbuf *f, de_writelistener_cb_type fn, void *userdata
 void dbuf_close(dbuf *f)
 {
 	deark *c;
+	int is_output_file;
+
 	if(!f) return;
 	c = f->c;
 
+	is_output_file = (f->btype==DBUF_TYPE_OFILE || f->btype==DBUF_TYPE_STDOUT ||
+		f->writing_to_zip_archive || f->writing_to_tar_archive);
+	if(is_output_file) {
+		de_stats_begin(c, DE_STATS_PHASE_OUTPUT);
+	}
+
 	if(f->btype==DBUF_TYPE_OFILE || f->btype==DBUF_TYPE_STDOUT) {
 		c->total_output_size += f->len;
 	}
 
-	if(f->btype==DBUF_TYPE_MEMBUF && f->write_memfile_to_zip_archive) {
-		de_zip_add_file_to_archive(c, f);
-		if(f->name) {
-			de_dbg3(c, "closing memfile %s", f->name);
-		}
+	if(f->writing_to_zip_archive) {
+		de_zip_end_member_file(c, f);
 	}
 	else if(f->writing_to_tar_archive) {
 		de_tar_end_member_file(c, f);
@@ -1797,11 +2378,31 @@ void dbuf_close(dbuf *f)
 		de_err(c, "Internal: Don't know how to close this type of file (%d)", f->btype);
 	}
 
-	de_free(c, f->membuf_buf);
+	if(is_output_file) {
+		de_stats_end(c, DE_STATS_PHASE_OUTPUT);
+	}
+
+	if(f->recurse_on_close) {
+		do_recursion_on_close(f);
+	}
+	if(f->recursion_copy) {
+		dbuf_close(f->recursion_copy);
+	}
+
+	if(f->membuf_buf) {
+		stats_track_membuf(c, -f->membuf_alloc);
+	}
+	membuf_storage_free(c, f->membuf_buf, f->membuf_alloc);
 	de_free(c, f->name);
-	de_free(c, f->cache);
+	pagecache_destroy(f);
+	if(f->cache_is_mmapped) {
+		de_munmap(c, f->cache, f->cache_bytes_used);
+	}
+	else {
+		de_free(c, f->cache);
+	}
 	if(f->fi_copy) de_finfo_destroy(c, f->fi_copy);
-	de_free(c, f);
+	destroy_dbuf_lowlevel(c, f);
 
 	if(c->total_output_size > c->max_total_output_size) {
 		// FIXME: Since we only do this check when a file is closed, it can
@@ -1820,50 +2421,204 @@ void dbuf_empty(dbuf *f)
 	}
 }
 
+struct search_ctx {
+	const u8 *needle;
+	i64 needle_len;
+	int foundflag;
+	i64 foundpos_rel;
+
+	// The index of the needle byte that we look for with memchr().
+	i64 anchor;
+	u8 anchor_is_final;
+	// For deciding whether memchr() is working well
+	i64 num_false_starts;
+	i64 num_bytes_scanned;
+
+	u8 use_horspool;
+	UI horspool_skip[256];
+};
+
+// Horspool is only worth it for long needles. For short ones, a fast memchr()
+// beats it even when it has to skip a few bytes at a time.
+#define SEARCH_HORSPOOL_MIN_NEEDLE_LEN 16
+
+static void search_init_horspool(struct search_ctx *sctx)
+{
+	UI i;
+	UI last = (UI)sctx->needle_len-1;
+
+	for(i=0; i<256; i++) {
+		sctx->horspool_skip[i] = (UI)sctx->needle_len;
+	}
+	for(i=0; i<last; i++) {
+		sctx->horspool_skip[sctx->needle[i]] = last-i;
+	}
+	sctx->use_horspool = 1;
+}
+
+// Boyer-Moore-Horspool search, at starting positions 0 through npositions-1
+// of buf. Returns the index where the needle was found, or -1.
+static i64 search_mem_horspool(struct search_ctx *sctx, const u8 *buf,
+	i64 npositions)
+{
+	i64 i = 0;
+	i64 last = sctx->needle_len-1;
+	u8 lastbyte = sctx->needle[last];
+
+	while(i < npositions) {
+		u8 b = buf[i+last];
+
+		if(b==lastbyte && !de_memcmp(sctx->needle, &buf[i], (size_t)last)) {
+			return i;
+		}
+		i += (i64)sctx->horspool_skip[b];
+	}
+	return -1;
+}
+
+// The memchr() anchor byte is producing too many false starts. Switch to
+// Horspool, or to a needle byte value we haven't tried yet.
+static void search_change_strategy(struct search_ctx *sctx)
+{
+	i64 k, j;
+
+	if(sctx->needle_len >= SEARCH_HORSPOOL_MIN_NEEDLE_LEN) {
+		search_init_horspool(sctx);
+		return;
+	}
+
+	for(k=sctx->anchor+1; k<sctx->needle_len; k++) {
+		for(j=0; j<k; j++) {
+			if(sctx->needle[j]==sctx->needle[k]) break;
+		}
+		if(j==k) { // needle[k] is a new value
+			sctx->anchor = k;
+			return;
+		}
+	}
+	sctx->anchor_is_final = 1;
+}
+
+// Search at starting positions 0 through npositions-1 of buf.
+// Returns the index where the needle was found, or -1.
+//
+// Usually uses memchr() to find an "anchor" byte of the needle, which is
+// fast, unless that byte is common in the data. If we get too many false
+// starts, we try a different anchor byte (or Horspool, for long needles).
+static i64 search_mem(struct search_ctx *sctx, const u8 *buf, i64 npositions)
+{
+	i64 i = 0;
+
+	if(sctx->use_horspool) {
+		return search_mem_horspool(sctx, buf, npositions);
+	}
+
+	while(i < npositions) {
+		const u8 *p;
+		i64 anchor = sctx->anchor;
+
+		p = de_memchr(&buf[i+anchor], (int)sctx->needle[anchor],
+			(size_t)(npositions-i));
+		if(!p) break;
+		i = (i64)(p-buf) - anchor;
+		if(!de_memcmp(sctx->needle, &buf[i], (size_t)sctx->needle_len)) {
+			return i;
+		}
+		i++;
+
+		if(sctx->anchor_is_final) continue;
+		sctx->num_false_starts++;
+		if(sctx->num_false_starts>=64 &&
+			sctx->num_false_starts > (sctx->num_bytes_scanned+i)/256)
+		{
+			search_change_strategy(sctx);
+			sctx->num_false_starts = 0;
+			sctx->num_bytes_scanned = -i;
+			if(sctx->use_horspool) {
+				i64 ret;
+
+				ret = search_mem_horspool(sctx, &buf[i], npositions-i);
+				return (ret<0) ? -1 : i+ret;
+			}
+		}
+	}
+
+	sctx->num_bytes_scanned += npositions;
+	return -1;
+}
+
+static int search_byte_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
+	i64 buf_len)
+{
+	struct search_ctx *sctx = (struct search_ctx*)brctx->userdata;
+	const u8 *p;
+
+	if(buf_len<1) return 0;
+	p = de_memchr(buf, (int)sctx->needle[0], (size_t)buf_len);
+	if(p) {
+		sctx->foundpos_rel = brctx->offset + (i64)(p-buf);
+		sctx->foundflag = 1;
+		return 0;
+	}
+	return 1;
+}
+
 // Search a section of a dbuf for a given byte.
 // 'haystack_len' is the number of bytes to search.
+// As with dbuf_getbyte(), bytes outside the file are treated as 0x00.
 // Returns 0 if not found.
 // If found, sets *foundpos to the position in the file where it was found
 // (not relative to startpos).
 int dbuf_search_byte(dbuf *f, const u8 b, i64 startpos,
 	i64 haystack_len, i64 *foundpos)
 {
-	i64 i;
+	struct search_ctx sctx;
+	i64 pos1, pos2;
+
+	if(haystack_len<1) return 0;
 
-	for(i=0; i<haystack_len; i++) {
-		if(b == dbuf_getbyte(f, startpos+i)) {
-			*foundpos = startpos+i;
+	if(b==0x00 && startpos<0) {
+		*foundpos = startpos;
+		return 1;
+	}
+
+	// Search the part of the haystack that is in the file.
+	pos1 = (startpos<0) ? 0 : startpos;
+	pos2 = startpos + haystack_len;
+	if(pos2 > f->len) pos2 = f->len;
+	if(pos2 > pos1) {
+		de_zeromem(&sctx, sizeof(struct search_ctx));
+		sctx.needle = &b;
+		sctx.needle_len = 1;
+		(void)dbuf_buffered_read(f, pos1, pos2-pos1, search_byte_cbfn, (void*)&sctx);
+		if(sctx.foundflag) {
+			*foundpos = pos1 + sctx.foundpos_rel;
 			return 1;
 		}
 	}
+
+	if(b==0x00 && startpos+haystack_len > f->len) {
+		*foundpos = (startpos > f->len) ? startpos : f->len;
+		return 1;
+	}
 	return 0;
 }
 
-struct search_ctx {
-	const u8 *needle;
-	i64 needle_len;
-	int foundflag;
-	i64 foundpos_rel;
-};
-
 static int search_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
 	i64 buf_len)
 {
 	struct search_ctx *sctx = (struct search_ctx*)brctx->userdata;
-	i64 i;
 	i64 num_starting_positions_to_check;
+	i64 ret;
 
 	if(buf_len < sctx->needle_len) return 0;
 	num_starting_positions_to_check = buf_len + 1 - sctx->needle_len;
 
-	for(i=0; i<num_starting_positions_to_check; i++) {
-		if(sctx->needle[0]==buf[i] &&
-			!de_memcmp(sctx->needle, &buf[i], (size_t)sctx->needle_len))
-		{
-			sctx->foundpos_rel = brctx->offset+i;
-			sctx->foundflag = 1;
-			return 0;
-		}
+	ret = search_mem(sctx, buf, num_starting_positions_to_check);
+	if(ret>=0) {
+		sctx->foundpos_rel = brctx->offset+ret;
+		sctx->foundflag = 1;
+		return 0;
 	}
 
 	if(brctx->eof_flag) return 0;
@@ -1871,12 +2626,31 @@ static int search_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
 	return 1;
 }
 
+// Clip a search range to the bounds of the file.
+// Returns 0 if nothing is left.
+static int search_clip_range(dbuf *f, i64 *pstartpos, i64 *phaystack_len)
+{
+	if(*pstartpos < 0) {
+		*phaystack_len += *pstartpos;
+		if(*phaystack_len < 0) {
+			return 0;
+		}
+		*pstartpos = 0;
+	}
+	if(*pstartpos > f->len) {
+		return 0;
+	}
+	if(*phaystack_len > f->len - *pstartpos) {
+		*phaystack_len = f->len - *pstartpos;
+	}
+	return 1;
+}
+
 // Search a section of a dbuf for a given byte sequence.
 //
-// This function is inefficient, but it's good enough for Deark's needs.
-// Maximum 'needle_len' is DE_BUFFERED_READ_MIN_BLKSIZE bytes, but it's expected to
-// be quite short. If it gets close to the maximum, the search could get very
-// inefficient.
+// Candidate positions are found with memchr(), or with the Boyer-Moore-
+// Horspool algorithm for long needles (see search_mem()).
+// Maximum 'needle_len' is DE_BUFFERED_READ_MIN_BLKSIZE bytes.
 //
 // 'haystack_len' is the number of bytes to search in (the sequence must be completely
 // within that range, not just start there).
@@ -1887,23 +2661,13 @@ int dbuf_search(dbuf *f, const u8 *needle, i64 needle_len,
 	i64 startpos, i64 haystack_len, i64 *foundpos)
 {
 	int retval = 0;
-	struct search_ctx sctx;
+	struct search_ctx *sctx = NULL;
 
 	*foundpos = 0;
 
-	if(startpos < 0) {
-		haystack_len += startpos;
-		if(haystack_len < 0) {
-			goto done;
-		}
-		startpos = 0;
-	}
-	if(startpos > f->len) {
+	if(!search_clip_range(f, &startpos, &haystack_len)) {
 		goto done;
 	}
-	if(haystack_len > f->len - startpos) {
-		haystack_len = f->len - startpos;
-	}
 	if(needle_len > haystack_len) {
 		goto done;
 	}
@@ -1916,16 +2680,165 @@ int dbuf_search(dbuf *f, const u8 *needle, i64 needle_len,
 		goto done;
 	}
 
-	de_zeromem(&sctx, sizeof(struct search_ctx));
-	sctx.needle = needle;
-	sctx.needle_len = needle_len;
-	(void)dbuf_buffered_read(f, startpos, haystack_len, search_cbfn, (void*)&sctx);
-	if(sctx.foundflag) {
-		*foundpos = startpos + sctx.foundpos_rel;
+	sctx = de_malloc(f->c, sizeof(struct search_ctx));
+	sctx->needle = needle;
+	sctx->needle_len = needle_len;
+	(void)dbuf_buffered_read(f, startpos, haystack_len, search_cbfn, (void*)sctx);
+	if(sctx->foundflag) {
+		*foundpos = startpos + sctx->foundpos_rel;
 		retval = 1;
 	}
 
 done:
+	de_free(f->c, sctx);
+	return retval;
+}
+
+struct search_multi_ctx {
+	const struct de_search_needle *needles;
+	i64 num_needles;
+	i64 min_needle_len;
+	i64 max_needle_len;
+	int foundflag;
+	i64 foundpos_rel;
+	i64 found_idx;
+	u8 is_firstbyte[256]; // Does any needle start with this byte value?
+	u8 only_firstbyte;
+	i64 num_firstbytes;
+	// If every needle is at least 2 bytes long: A bitmap, indexed by the first
+	// two bytes (big-endian), of whether any needle starts with them.
+	u8 use_pairs;
+	u8 is_firstpair[65536/8];
+};
+
+static int search_multi_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
+	i64 buf_len)
+{
+	struct search_multi_ctx *sctx = (struct search_multi_ctx*)brctx->userdata;
+	i64 npositions;
+	i64 i = 0;
+
+	if(buf_len < sctx->min_needle_len) return 0;
+	if(brctx->eof_flag) {
+		npositions = buf_len + 1 - sctx->min_needle_len;
+	}
+	else {
+		// Leave enough bytes that the longest needle can be tested at every
+		// position we check.
+		npositions = buf_len + 1 - sctx->max_needle_len;
+	}
+
+	while(i < npositions) {
+		i64 k;
+
+		if(sctx->num_firstbytes==1) {
+			const u8 *p;
+
+			p = de_memchr(&buf[i], (int)sctx->only_firstbyte, (size_t)(npositions-i));
+			if(!p) break;
+			i = (i64)(p-buf);
+		}
+		else if(sctx->use_pairs) {
+			// This is safe, because npositions <= buf_len-1.
+			while(i<npositions) {
+				UI pair = ((UI)buf[i]<<8) | (UI)buf[i+1];
+
+				if(sctx->is_firstpair[pair>>3] & (1U<<(pair&7))) break;
+				i++;
+			}
+			if(i>=npositions) break;
+		}
+		else {
+			while(i<npositions && !sctx->is_firstbyte[buf[i]]) {
+				i++;
+			}
+			if(i>=npositions) break;
+		}
+
+		for(k=0; k<sctx->num_needles; k++) {
+			const struct de_search_needle *nd = &sctx->needles[k];
+
+			if(nd->data[0]!=buf[i]) continue;
+			if(i+nd->len > buf_len) continue;
+			if(!de_memcmp(nd->data, &buf[i], (size_t)nd->len)) {
+				sctx->foundpos_rel = brctx->offset+i;
+				sctx->found_idx = k;
+				sctx->foundflag = 1;
+				return 0;
+			}
+		}
+		i++;
+	}
+
+	if(brctx->eof_flag) return 0;
+	brctx->bytes_consumed = npositions;
+	return 1;
+}
+
+// Search a section of a dbuf for the first occurrence of any of several byte
+// sequences, in a single pass.
+// Each needle must have a length from 1 to DE_BUFFERED_READ_MIN_BLKSIZE.
+// If needles are found at the same position, the one earliest in the list wins.
+// Returns 0 if not found.
+// If found, sets *foundpos to the position in the file where it was found,
+// and *found_idx (if not NULL) to the index of the needle that was found.
+int dbuf_search_multi(dbuf *f, const struct de_search_needle *needles,
+	i64 num_needles, i64 startpos, i64 haystack_len, i64 *foundpos,
+	i64 *found_idx)
+{
+	int retval = 0;
+	struct search_multi_ctx *sctx = NULL;
+	i64 k;
+
+	*foundpos = 0;
+	if(found_idx) *found_idx = 0;
+	if(num_needles<1) goto done;
+
+	if(!search_clip_range(f, &startpos, &haystack_len)) {
+		goto done;
+	}
+
+	sctx = de_malloc(f->c, sizeof(struct search_multi_ctx));
+	sctx->needles = needles;
+	sctx->num_needles = num_needles;
+	sctx->min_needle_len = DE_BUFFERED_READ_MIN_BLKSIZE;
+	for(k=0; k<num_needles; k++) {
+		u8 b;
+
+		if(needles[k].len<1 || needles[k].len>DE_BUFFERED_READ_MIN_BLKSIZE) {
+			goto done;
+		}
+		if(needles[k].len < sctx->min_needle_len) sctx->min_needle_len = needles[k].len;
+		if(needles[k].len > sctx->max_needle_len) sctx->max_needle_len = needles[k].len;
+
+		b = needles[k].data[0];
+		if(!sctx->is_firstbyte[b]) {
+			sctx->is_firstbyte[b] = 1;
+			sctx->num_firstbytes++;
+			sctx->only_firstbyte = b;
+		}
+	}
+
+	if(sctx->min_needle_len > haystack_len) goto done;
+
+	if(sctx->num_firstbytes>1 && sctx->min_needle_len>=2) {
+		sctx->use_pairs = 1;
+		for(k=0; k<num_needles; k++) {
+			UI pair = ((UI)needles[k].data[0]<<8) | (UI)needles[k].data[1];
+
+			sctx->is_firstpair[pair>>3] |= (u8)(1U<<(pair&7));
+		}
+	}
+
+	(void)dbuf_buffered_read(f, startpos, haystack_len, search_multi_cbfn, (void*)sctx);
+	if(sctx->foundflag) {
+		*foundpos = startpos + sctx->foundpos_rel;
+		if(found_idx) *found_idx = sctx->found_idx;
+		retval = 1;
+	}
+
+done:
+	de_free(f->c, sctx);
 	return retval;
 }
 
@@ -2082,7 +2995,23 @@ static int buffered_read_internal(struct de_bufferedreadctx *brctx,
 	i64 offs_of_first_byte_in_buf; // Relative to pos1, where in f is buf[0]?
 	i64 num_unconsumed_bytes_in_buf;
 #define BRBUFLEN 4096 // Must be >= DE_BUFFERED_READ_MIN_BLKSIZE
-	u8 buf[BRBUFLEN];
+#define BRBIGBUFLEN 65536
+	u8 smallbuf[BRBUFLEN];
+	u8 *bigbuf = NULL;
+	u8 *buf;
+	i64 buflen;
+
+	// For long reads, use a bigger buffer, so that the callback function is
+	// called less often, and less data has to be moved around.
+	if(len > BRBUFLEN) {
+		buflen = (len < BRBIGBUFLEN) ? len : BRBIGBUFLEN;
+		bigbuf = de_malloc(f->c, buflen);
+		buf = bigbuf;
+	}
+	else {
+		buflen = BRBUFLEN;
+		buf = smallbuf;
+	}
 
 	num_unconsumed_bytes_in_buf = 0;
 	offs_of_first_byte_in_buf = 0;
@@ -2098,7 +3027,7 @@ static int buffered_read_internal(struct de_bufferedreadctx *brctx,
 		}
 
 		// max bytes that will fit in buf:
-		bytestoread = BRBUFLEN-num_unconsumed_bytes_in_buf;
+		bytestoread = buflen-num_unconsumed_bytes_in_buf;
 
 		// max bytes available to read:
 		if(bytestoread >= nbytes_avail_to_read) {
@@ -2137,12 +3066,13 @@ static int buffered_read_internal(struct de_bufferedreadctx *brctx,
 	}
 	retval = 1;
 done:
+	de_free(f->c, bigbuf);
 	return retval;
 }
 
 // Special case where all bytes are already in memory
 static int buffered_read_from_mem(struct de_bufferedreadctx *brctx,
-	dbuf *f, const u8 *mem, i64 pos1, i64 len, de_buffered_read_cbfn cbfn)
+	const u8 *mem, i64 pos1, i64 len, de_buffered_read_cbfn cbfn)
 {
 	int retval = 0;
 	i64 total_nbytes_consumed = 0;
@@ -2200,14 +3130,15 @@ static int buffered_read_zero_len(struct de_bufferedreadctx *brctx,
 //   - If the caller supplies 0 bytes of input data, the callback function will be
 //     called exactly once. This is the only case where the callback will be
 //     called with buf_len==0.
-//   - If the source dbuf is a MEMBUF, and the requested bytes are all in range,
-//     then all requested bytes will be provided in the first call to the callback
-//     function.
+//   - If the source dbuf is a MEMBUF (or a subfile of one), and the requested
+//     bytes are all in range, then all requested bytes will be provided in the
+//     first call to the callback function.
 // Return value: 1 normally, 0 if the callback function ever returned 0.
 int dbuf_buffered_read(dbuf *f, i64 pos1, i64 len,
 	de_buffered_read_cbfn cbfn, void *userdata)
 {
 	struct de_bufferedreadctx brctx;
+	const u8 *p;
 
 	brctx.c = f->c;
 	brctx.userdata = userdata;
@@ -2216,14 +3147,12 @@ int dbuf_buffered_read(dbuf *f, i64 pos1, i64 len,
 		return buffered_read_zero_len(&brctx, cbfn);
 	}
 
-	// Use an optimized routine if all the data we need to read is already in memory.
-	if(f->cache && (pos1>=0) && (pos1+len<=f->cache_bytes_used)) {
-		return buffered_read_from_mem(&brctx, f, f->cache, pos1, len, cbfn);
-	}
-
-	// Not an "optimization", since we promise this behavior for MEMBUFs.
-	if(f->btype==DBUF_TYPE_MEMBUF && (pos1>=0) && (pos1+len<=f->len)) {
-		return buffered_read_from_mem(&brctx, f, f->membuf_buf, pos1, len, cbfn);
+	// Use an optimized routine if all the data we need to read is already in
+	// memory.
+	// (Not just an "optimization", since we promise this behavior for MEMBUFs.)
+	p = dbuf_get_ptr(f, pos1, len);
+	if(p) {
+		return buffered_read_from_mem(&brctx, p, 0, len, cbfn);
 	}
 
 	// The general case:
@@ -2282,6 +3211,19 @@ u64 de_bitbuf_lowelevel_get_bits(struct de_bitbuf_lowlevel *bbll, UI nbits)
 	return n;
 }
 
+// Like de_bitbuf_lowelevel_get_bits(), but does not consume the bits.
+u64 de_bitbuf_lowelevel_peek_bits(struct de_bitbuf_lowlevel *bbll, UI nbits)
+{
+	u64 mask;
+
+	if(nbits > bbll->nbits_in_bitbuf) return 0;
+	mask = ((u64)1 << nbits)-1;
+	if(bbll->is_lsb==0) {
+		return (bbll->bit_buf >> (bbll->nbits_in_bitbuf - nbits)) & mask;
+	}
+	return bbll->bit_buf & mask;
+}
+
 void de_bitbuf_lowelevel_empty(struct de_bitbuf_lowlevel *bbll)
 {
 	bbll->bit_buf = 0;
@@ -2315,6 +3257,40 @@ u64 de_bitreader_getbits(struct de_bitreader *bitrd, UI nbits)
 	return de_bitbuf_lowelevel_get_bits(&bitrd->bbll, nbits);
 }
 
+// Look at the next nbits bits (up to 57), without consuming them.
+// Returns 0 if there aren't that many bits left. Unlike
+// de_bitreader_getbits(), this does not set eof_flag.
+// Intended to be followed by a call to de_bitreader_skipbits(), with nbits no
+// larger than the number peeked.
+int de_bitreader_peekbits(struct de_bitreader *bitrd, UI nbits, u64 *pval)
+{
+	*pval = 0;
+	if(bitrd->eof_flag) return 0;
+	if(nbits > 57) return 0;
+
+	while(bitrd->bbll.nbits_in_bitbuf < nbits) {
+		u8 b;
+
+		if(bitrd->curpos >= bitrd->endpos) {
+			return 0;
+		}
+		b = dbuf_getbyte_p(bitrd->f, &bitrd->curpos);
+		de_bitbuf_lowelevel_add_byte(&bitrd->bbll, b);
+	}
+
+	*pval = de_bitbuf_lowelevel_peek_bits(&bitrd->bbll, nbits);
+	return 1;
+}
+
+void de_bitreader_skipbits(struct de_bitreader *bitrd, UI nbits)
+{
+	if(nbits <= bitrd->bbll.nbits_in_bitbuf) {
+		(void)de_bitbuf_lowelevel_get_bits(&bitrd->bbll, nbits);
+		return;
+	}
+	(void)de_bitreader_getbits(bitrd, nbits);
+}
+
 char *de_bitreader_describe_curpos(struct de_bitreader *bitrd, char *buf, size_t buf_len)
 {
 	i64 curpos;
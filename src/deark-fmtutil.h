@@ -110,6 +110,8 @@ void fmtutil_decompress_packbits16_ex(deark *c, struct de_dfilter_in_params *dcm
 	struct de_dfilter_out_params *dcmpro, struct de_dfilter_results *dres);
 int fmtutil_decompress_packbits16(dbuf *f, i64 pos1, i64 len,
 	dbuf *unc_pixels, i64 *cmpr_bytes_consumed);
+i64 fmtutil_decompress_packbits_to_mem(dbuf *f, i64 pos1, i64 len,
+	u8 *dst, i64 dst_len, UI nbytes_per_unit);
 void fmtutil_decompress_rle90_ex(deark *c, struct de_dfilter_in_params *dcmpri,
 	struct de_dfilter_out_params *dcmpro, struct de_dfilter_results *dres,
 	unsigned int flags);
@@ -165,6 +167,19 @@ void fmtutil_decompress_lzw(deark *c, struct de_dfilter_in_params *dcmpri,
 void dfilter_lzw_codec(struct de_dfilter_ctx *dfctx, void *codec_private_params);
 void dfilter_rle90_codec(struct de_dfilter_ctx *dfctx, void *codec_private_params);
 
+typedef void (*de_packbits_row_cb_type)(struct de_dfilter_ctx *dfctx, void *userdata,
+	i64 rownum, const u8 *row);
+struct de_packbits_params {
+	UI nbytes_per_unit; // 1 = standard PackBits (default), 2 = PackBits16
+	// Optional. If row_cb is set, the output is delivered to it in rows of
+	// row_size bytes (the last one padded with zeroes if necessary), instead
+	// of being written to dcmpro->f.
+	i64 row_size;
+	de_packbits_row_cb_type row_cb;
+	void *userdata;
+};
+void dfilter_packbits_codec(struct de_dfilter_ctx *dfctx, void *codec_private_params);
+
 struct de_lzh_params {
 #define DE_LZH_FMT_LH5LIKE       1 // subfmt=='5' (etc.)
 	int fmt;
@@ -244,6 +259,7 @@ enum fmtutil_tdefl_status fmtutil_tdefl_compress_buffer(struct fmtutil_tdefl_ctx
 void fmtutil_tdefl_destroy(struct fmtutil_tdefl_ctx *tdctx);
 unsigned int fmtutil_tdefl_create_comp_flags_from_zip_params(int level, int window_bits,
 	int strategy);
+int fmtutil_tdefl_looks_incompressible(deark *c, const u8 *buf, i64 len);
 
 struct de_SAUCE_info {
 	int is_valid;
@@ -314,6 +330,9 @@ void fmtutil_read_boxes_format(deark *c, struct de_boxesctx *bctx);
 void fmtutil_render_uuid(deark *c, const u8 *uuid, char *s, size_t s_len);
 void fmtutil_guid_to_uuid(u8 *id);
 
+void fmtutil_planar_to_chunky(const u8 *src, i64 npixels, UI nplanes,
+	i64 plane_stride, i64 unit_size, i64 unit_stride, u8 *dst, i64 dst_stride);
+
 struct atari_img_decode_data {
 	i64 bpp;
 	i64 ncolors;
@@ -419,6 +438,16 @@ const char *fmtutil_tiff_orientation_name(i64 n);
 const char *fmtutil_get_windows_charset_name(u8 cs);
 const char *fmtutil_get_windows_cb_data_type_name(unsigned int ty);
 
+int fmtutil_find_jpeg_len(deark *c, dbuf *f, i64 pos1, i64 len,
+	i64 *pjpeg_len, u8 *pis_jpegls);
+int fmtutil_find_png_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 *ppng_len);
+int fmtutil_find_gif_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 *pgif_len);
+int fmtutil_find_bmp_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 *pbmp_len);
+int fmtutil_find_iff_len(deark *c, dbuf *f, i64 pos1, i64 len, int is_le,
+	i64 *pfile_len, struct de_fourcc *pformtype);
+int fmtutil_find_zip_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 eocd_pos,
+	i64 *pzip_len);
+int fmtutil_find_cfb_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 *pcfb_len);
 int fmtutil_find_zip_eocd(deark *c, dbuf *f, i64 *foundpos);
 
 struct de_id3info {
@@ -551,15 +580,33 @@ typedef void (*fmtutil_lz77buffer_cb_type)(struct de_lz77buffer *rb, u8 n);
 
 struct de_lz77buffer {
 	void *userdata;
-	fmtutil_lz77buffer_cb_type writebyte_cb;
+	fmtutil_lz77buffer_cb_type writebyte_cb; // Not used if outf is set
 	UI curpos; // Must be kept valid at all times (0...bufsize-1)
 	UI mask;
 	UI bufsize; // Required to be a power of 2
 	u8 *buf;
+
+	// Fields used if de_lz77buffer_set_output() was called. Output bytes are
+	// left in buf, and written to outf in blocks.
+	dbuf *outf;
+	u8 max_len_known;
+	i64 max_len;
+	i64 nbytes_produced; // Total bytes added, including any past max_len
+	i64 nbytes_flushed;
+	UI npending; // Number of bytes just before curpos not yet written to outf
 };
  struct de_lz77buffer *de_lz77buffer_create(deark *c, UI bufsize);
  void de_lz77buffer_destroy(deark *c, struct de_lz77buffer *rb);
+ void de_lz77buffer_set_output(struct de_lz77buffer *rb, dbuf *outf,
+	u8 max_len_known, i64 max_len);
+ void de_lz77buffer_flush(struct de_lz77buffer *rb);
  void de_lz77buffer_clear(struct de_lz77buffer *rb, UI val);
  void de_lz77buffer_set_curpos(struct de_lz77buffer *rb, UI newpos);
  void de_lz77buffer_add_literal_byte(struct de_lz77buffer *rb, u8 b);
  void de_lz77buffer_copy_from_hist(struct de_lz77buffer *rb, UI startpos, UI count);
+// True if (in output mode) we've produced at least max_len bytes.
+#define de_lz77buffer_have_enough_output(rb) ((rb)->max_len_known && \
+	((rb)->nbytes_produced >= (rb)->max_len))
+// True if (in output mode) we've tried to produce more than max_len bytes.
+#define de_lz77buffer_output_overflowed(rb) ((rb)->max_len_known && \
+	((rb)->nbytes_produced > (rb)->max_len))
@@ -22,6 +22,7 @@ static void disable_module(deark *c, struct deark_module_info *mi)
 {
 	mi->identify_fn = NULL;
 	mi->run_fn = NULL;
+	mi->num_sigs = 0;
 }
 
 // Caller supplies mod_set[c->num_modules].
@@ -144,6 +145,7 @@ static void de_register_modules_internal(deark *c)
 	}
 
 	disable_modules_as_requested(c);
+	de_build_sig_index(c);
 }
 
 // A wrapper for the real de_create function (de_create_internal), which also
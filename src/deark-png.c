@@ -16,18 +16,40 @@
 #define CODE_IDAT 0x49444154U
 #define CODE_IEND 0x49454e44U
 #define CODE_IHDR 0x49484452U
+#define CODE_PLTE 0x504c5445U
 #define CODE_htSP 0x68745350U
 #define CODE_pHYs 0x70485973U
 #define CODE_tEXt 0x74455874U
 #define CODE_tIME 0x74494d45U
+#define CODE_tRNS 0x74524e53U
+
+#define PNGFILTER_NONE     0
+#define PNGFILTER_SUB      1
+#define PNGFILTER_UP       2
+#define PNGFILTER_AVERAGE  3
+#define PNGFILTER_PAETH    4
+#define PNGFILTER_ADAPTIVE 5 // Choose the best filter for each row
+
+// How much filtered image data to test for compressibility, before deciding
+// how hard to try to compress it.
+#define PNG_IDAT_SAMPLE_SIZE 16384
+
+typedef void (*png_filter_fn_type)(const u8 *row, const u8 *prev, int bpl, int bpp,
+	u8 *out);
 
 struct deark_png_encode_info {
 	deark *c;
 	dbuf *outf;
 	int width, height;
 	int num_chans;
+	u8 color_type;
+	u8 bit_depth;
+	int bpl; // bytes per row, not including the filter byte
+	int num_pal_entries; // Used if color_type==3
+	de_color pal[256];
 	int flip;
 	unsigned int level;
+	int filter; // PNGFILTER_*
 	int has_phys;
 	u32 xdens;
 	u32 ydens;
@@ -67,16 +89,47 @@ static void write_png_chunk_from_cdbuf(struct deark_png_encode_info *pei,
 static void write_png_chunk_IHDR(struct deark_png_encode_info *pei,
 	dbuf *cdbuf)
 {
-	static const u8 color_type_code[] = {0x00, 0x00, 0x04, 0x02, 0x06};
-
 	dbuf_writeu32be(cdbuf, (i64)pei->width);
 	dbuf_writeu32be(cdbuf, (i64)pei->height);
-	dbuf_writebyte(cdbuf, 8); // bit depth
-	dbuf_writebyte(cdbuf, color_type_code[pei->num_chans]);
+	dbuf_writebyte(cdbuf, pei->bit_depth);
+	dbuf_writebyte(cdbuf, pei->color_type);
 	dbuf_truncate(cdbuf, 13); // rest of chunk is zeroes
 	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_IHDR);
 }
 
+static void write_png_chunk_PLTE(struct deark_png_encode_info *pei,
+	dbuf *cdbuf)
+{
+	int k;
+
+	for(k=0; k<pei->num_pal_entries; k++) {
+		dbuf_writebyte(cdbuf, DE_COLOR_R(pei->pal[k]));
+		dbuf_writebyte(cdbuf, DE_COLOR_G(pei->pal[k]));
+		dbuf_writebyte(cdbuf, DE_COLOR_B(pei->pal[k]));
+	}
+	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_PLTE);
+}
+
+// Writes nothing if all palette entries are opaque.
+static void write_png_chunk_tRNS(struct deark_png_encode_info *pei,
+	dbuf *cdbuf)
+{
+	int k;
+	int num_trns_entries = 0;
+
+	for(k=0; k<pei->num_pal_entries; k++) {
+		if(DE_COLOR_A(pei->pal[k])!=0xff) {
+			num_trns_entries = k+1;
+		}
+	}
+	if(num_trns_entries<1) return;
+
+	for(k=0; k<num_trns_entries; k++) {
+		dbuf_writebyte(cdbuf, DE_COLOR_A(pei->pal[k]));
+	}
+	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_tRNS);
+}
+
 static void write_png_chunk_pHYs(struct deark_png_encode_info *pei,
 	dbuf *cdbuf)
 {
@@ -128,27 +181,234 @@ static void write_png_chunk_tEXt(struct deark_png_encode_info *pei,
 	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_tEXt);
 }
 
+// The filter kernels. 'out' has room for the filter type byte, followed by
+// bpl bytes of filtered data. 'prev' is the previous (unfiltered) row, which
+// for the first row is all zeroes.
+// These are written as simple loops that compilers can vectorize.
+
+static void png_filter_row_sub(const u8 *row, const u8 *prev, int bpl, int bpp, u8 *out)
+{
+	int i;
+
+	out[0] = PNGFILTER_SUB;
+	out++;
+	for(i=0; i<bpp; i++) {
+		out[i] = row[i];
+	}
+	for(i=bpp; i<bpl; i++) {
+		out[i] = (u8)(row[i] - row[i-bpp]);
+	}
+}
+
+static void png_filter_row_up(const u8 *row, const u8 *prev, int bpl, int bpp, u8 *out)
+{
+	int i;
+
+	out[0] = PNGFILTER_UP;
+	out++;
+	for(i=0; i<bpl; i++) {
+		out[i] = (u8)(row[i] - prev[i]);
+	}
+}
+
+static void png_filter_row_average(const u8 *row, const u8 *prev, int bpl, int bpp, u8 *out)
+{
+	int i;
+
+	out[0] = PNGFILTER_AVERAGE;
+	out++;
+	for(i=0; i<bpp; i++) {
+		out[i] = (u8)(row[i] - (prev[i]>>1));
+	}
+	for(i=bpp; i<bpl; i++) {
+		out[i] = (u8)(row[i] - (u8)(((UI)row[i-bpp] + (UI)prev[i])>>1));
+	}
+}
+
+static void png_filter_row_paeth(const u8 *row, const u8 *prev, int bpl, int bpp, u8 *out)
+{
+	int i;
+
+	out[0] = PNGFILTER_PAETH;
+	out++;
+	// With no left neighbor, the Paeth predictor is always the 'up' value.
+	for(i=0; i<bpp; i++) {
+		out[i] = (u8)(row[i] - prev[i]);
+	}
+	for(i=bpp; i<bpl; i++) {
+		int a, b, cc;
+		int p, pa, pb, pc;
+		int pred;
+
+		a = (int)row[i-bpp];
+		b = (int)prev[i];
+		cc = (int)prev[i-bpp];
+		p = b - cc; // = (a+b-cc)-a
+		pc = a - cc; // = (a+b-cc)-b
+		pa = p<0 ? -p : p;
+		pb = pc<0 ? -pc : pc;
+		pc = (p+pc)<0 ? -(p+pc) : (p+pc);
+		if(pa<=pb && pa<=pc) pred = a;
+		else if(pb<=pc) pred = b;
+		else pred = cc;
+		out[i] = (u8)(row[i] - (u8)pred);
+	}
+}
+
+// The heuristic recommended by the PNG spec: the filtered bytes, interpreted
+// as signed, with the smallest sum of absolute values. Gives up early once
+// the sum exceeds 'limit'.
+static i64 png_filter_cost(const u8 *out, int bpl, i64 limit)
+{
+	i64 sum = 0;
+	int i;
+	int k;
+
+	for(i=1; i<=bpl; i+=k) {
+		int n = de_min_int(bpl+1-i, 256);
+		UI chunk_sum = 0;
+
+		for(k=0; k<n; k++) {
+			chunk_sum += (out[i+k]<128) ? (UI)out[i+k] : (UI)(256-out[i+k]);
+		}
+		sum += (i64)chunk_sum;
+		if(sum > limit) break;
+	}
+	return sum;
+}
+
+struct png_idat_ctx {
+	struct fmtutil_tdefl_ctx *tdctx;
+	dbuf *cdbuf;
+	u8 *sample;
+	i64 sample_len;
+};
+
+// Start the compressor, once we know how much of the image data is going
+// to be in the sample.
+// If the sample won't compress, the rest of the image probably won't either
+// (photographic noise, etc.), and the higher compression levels can be very
+// slow on such data. So store it instead.
+static void idat_start_compressor(struct deark_png_encode_info *pei,
+	struct png_idat_ctx *ictx)
+{
+	deark *c = pei->c;
+	static const unsigned int my_s_tdefl_num_probes[11] = { 0, 1, 6, 32,  16, 32, 128, 256,  512, 768, 1500 };
+	int flags;
+
+	if(pei->level>0 && ictx->sample_len >= PNG_IDAT_SAMPLE_SIZE/4 &&
+		fmtutil_tdefl_looks_incompressible(c, ictx->sample, ictx->sample_len))
+	{
+		de_dbg3(c, "image data seems incompressible; not compressing it");
+		flags = (int)fmtutil_tdefl_create_comp_flags_from_zip_params(0, 15, 0);
+	}
+	else {
+		flags = my_s_tdefl_num_probes[MY_MZ_MIN(10, pei->level)] | MY_TDEFL_WRITE_ZLIB_HEADER;
+	}
+
+	ictx->tdctx = fmtutil_tdefl_create(c, ictx->cdbuf, flags);
+	fmtutil_tdefl_compress_buffer(ictx->tdctx, ictx->sample, (size_t)ictx->sample_len,
+		FMTUTIL_TDEFL_NO_FLUSH);
+}
+
+static void idat_write(struct deark_png_encode_info *pei, struct png_idat_ctx *ictx,
+	const u8 *buf, i64 len)
+{
+	if(!ictx->tdctx) {
+		i64 n;
+
+		n = de_min_int(len, PNG_IDAT_SAMPLE_SIZE - ictx->sample_len);
+		de_memcpy(&ictx->sample[ictx->sample_len], buf, (size_t)n);
+		ictx->sample_len += n;
+		buf += n;
+		len -= n;
+		if(ictx->sample_len < PNG_IDAT_SAMPLE_SIZE) return;
+		idat_start_compressor(pei, ictx);
+	}
+
+	if(len>0) {
+		fmtutil_tdefl_compress_buffer(ictx->tdctx, buf, (size_t)len, FMTUTIL_TDEFL_NO_FLUSH);
+	}
+}
+
 static int write_png_chunk_IDAT(struct deark_png_encode_info *pei, dbuf *cdbuf,
 	const u8 *src_pixels)
 {
-	int bpl = pei->width * pei->num_chans; // bytes per row in src_pixels
+	int bpl = pei->bpl; // bytes per row in src_pixels
+	// Bytes per complete pixel, for filtering purposes
+	int bpp = (pei->bit_depth<8) ? 1 : pei->num_chans;
 	int y;
-	static const char nulbyte = '\0';
 	int retval = 0;
 	deark *c = pei->c;
-	struct fmtutil_tdefl_ctx *tdctx = NULL;
-	static const unsigned int my_s_tdefl_num_probes[11] = { 0, 1, 6, 32,  16, 32, 128, 256,  512, 768, 1500 };
+	struct png_idat_ctx ictx;
+	u8 *zero_row = NULL;
+	u8 *rowbuf1 = NULL;
+	u8 *rowbuf2 = NULL;
+	const u8 *prev;
+	static png_filter_fn_type const filter_fns[5] = { NULL, png_filter_row_sub,
+		png_filter_row_up, png_filter_row_average, png_filter_row_paeth };
 
 	// compress image data
-	tdctx = fmtutil_tdefl_create(c, cdbuf,
-		my_s_tdefl_num_probes[MY_MZ_MIN(10, pei->level)] | MY_TDEFL_WRITE_ZLIB_HEADER);
+	de_zeromem(&ictx, sizeof(struct png_idat_ctx));
+	ictx.cdbuf = cdbuf;
+	ictx.sample = de_malloc(c, PNG_IDAT_SAMPLE_SIZE);
+
+	if(pei->filter != PNGFILTER_NONE) {
+		zero_row = de_malloc(c, bpl);
+		rowbuf1 = de_malloc(c, (i64)bpl+1);
+		rowbuf2 = de_malloc(c, (i64)bpl+1);
+	}
+	prev = zero_row;
 
 	for (y = 0; y < pei->height; ++y) {
-		fmtutil_tdefl_compress_buffer(tdctx, &nulbyte, 1, FMTUTIL_TDEFL_NO_FLUSH);
-		fmtutil_tdefl_compress_buffer(tdctx, &src_pixels[(pei->flip ? (pei->height - 1 - y) : y) * bpl],
-			bpl, FMTUTIL_TDEFL_NO_FLUSH);
+		const u8 *row;
+
+		row = &src_pixels[(pei->flip ? (pei->height - 1 - y) : y) * bpl];
+
+		if(pei->filter == PNGFILTER_NONE) {
+			static const u8 nulbyte = 0;
+
+			idat_write(pei, &ictx, &nulbyte, 1);
+			idat_write(pei, &ictx, row, bpl);
+		}
+		else if(pei->filter == PNGFILTER_ADAPTIVE) {
+			u8 *best = rowbuf1;
+			u8 *tmp = rowbuf2;
+			i64 best_cost;
+			int ft;
+
+			// Filter type "None"
+			best[0] = PNGFILTER_NONE;
+			de_memcpy(&best[1], row, (size_t)bpl);
+			// (The cost can never exceed 128 per byte.)
+			best_cost = png_filter_cost(best, bpl, (i64)bpl*128);
+
+			for(ft=PNGFILTER_SUB; ft<=PNGFILTER_PAETH && best_cost>0; ft++) {
+				i64 cost;
+
+				filter_fns[ft](row, prev, bpl, bpp, tmp);
+				cost = png_filter_cost(tmp, bpl, best_cost);
+				if(cost < best_cost) {
+					u8 *x = best;
+
+					best_cost = cost;
+					best = tmp;
+					tmp = x;
+				}
+			}
+			idat_write(pei, &ictx, best, (i64)bpl+1);
+		}
+		else {
+			filter_fns[pei->filter](row, prev, bpl, bpp, rowbuf1);
+			idat_write(pei, &ictx, rowbuf1, (i64)bpl+1);
+		}
+
+		prev = row;
+	}
+	if(!ictx.tdctx) {
+		idat_start_compressor(pei, &ictx);
 	}
-	if (fmtutil_tdefl_compress_buffer(tdctx, NULL, 0, FMTUTIL_TDEFL_FINISH) !=
+	if (fmtutil_tdefl_compress_buffer(ictx.tdctx, NULL, 0, FMTUTIL_TDEFL_FINISH) !=
 		FMTUTIL_TDEFL_STATUS_DONE)
 	{
 		goto done;
@@ -159,7 +419,11 @@ static int write_png_chunk_IDAT(struct deark_png_encode_info *pei, dbuf *cdbuf,
 	retval = 1;
 
 done:
-	fmtutil_tdefl_destroy(tdctx);
+	fmtutil_tdefl_destroy(ictx.tdctx);
+	de_free(c, ictx.sample);
+	de_free(c, zero_row);
+	de_free(c, rowbuf1);
+	de_free(c, rowbuf2);
 	return retval;
 }
 
@@ -176,6 +440,13 @@ static int do_generate_png(struct deark_png_encode_info *pei, const u8 *src_pixe
 
 	write_png_chunk_IHDR(pei, cdbuf);
 
+	if(pei->color_type==3) {
+		dbuf_truncate(cdbuf, 0);
+		write_png_chunk_PLTE(pei, cdbuf);
+		dbuf_truncate(cdbuf, 0);
+		write_png_chunk_tRNS(pei, cdbuf);
+	}
+
 	if(pei->has_phys) {
 		dbuf_truncate(cdbuf, 0);
 		write_png_chunk_pHYs(pei, cdbuf);
@@ -208,12 +479,300 @@ done:
 	return retval;
 }
 
+// Support for writing paletted images.
+// An image's palette hint is only a starting point. Colors that aren't in it
+// (e.g. from a transparency mask) are added to the palette, and we only give
+// up if there are more than 256 distinct colors.
+
+#define PNG_PALHASH_SIZE 1024 // Must be a power of 2
+#define PNG_MAX_EXTRA_COLORS 256
+// Paletted images with up to this many pixels are also encoded as truecolor,
+// in case that's smaller.
+#define PNG_PAL_TRIAL_MAX_PIXELS 4096
+
+struct png_palhash {
+	int num_extra_colors;
+	de_color extra_colors[PNG_MAX_EXTRA_COLORS];
+	de_color key[PNG_PALHASH_SIZE];
+	// 0 = unused slot. Palette hint entry n is n+1. Extra color n is 257+n.
+	u16 val[PNG_PALHASH_SIZE];
+};
+
+static UI palhash_slot(de_color clr)
+{
+	return (UI)(((u32)clr * 0x9e3779b1U) >> 22) & (PNG_PALHASH_SIZE-1);
+}
+
+// Returns the color's ID (0-255 = palette hint entry, 256+ = extra color),
+// or -1 if not found.
+static int palhash_lookup(struct png_palhash *ph, de_color clr)
+{
+	UI h = palhash_slot(clr);
+
+	while(ph->val[h]) {
+		if(ph->key[h]==clr) return (int)ph->val[h] - 1;
+		h = (h+1) & (PNG_PALHASH_SIZE-1);
+	}
+	return -1;
+}
+
+// Does nothing if the color is already present.
+static void palhash_insert(struct png_palhash *ph, de_color clr, int id)
+{
+	UI h = palhash_slot(clr);
+
+	while(ph->val[h]) {
+		if(ph->key[h]==clr) return;
+		h = (h+1) & (PNG_PALHASH_SIZE-1);
+	}
+	ph->key[h] = clr;
+	ph->val[h] = (u16)(id+1);
+}
+
+static de_color get_pixel_from_row(const u8 *p, int bypp)
+{
+	switch(bypp) {
+	case 1: return DE_MAKE_GRAY((de_color)p[0]);
+	case 2: return DE_MAKE_RGBA((de_color)p[0], (de_color)p[0], (de_color)p[0], p[1]);
+	case 3: return DE_MAKE_RGB((de_color)p[0], (de_color)p[1], (de_color)p[2]);
+	}
+	return DE_MAKE_RGBA((de_color)p[0], (de_color)p[1], (de_color)p[2], p[3]);
+}
+
+// Returns a newly-allocated buffer of packed palette indices, and sets
+// the palette and format fields in pei.
+// Returns NULL if the image can't, or shouldn't, be written as paletted.
+static u8 *make_paletted_image(struct deark_png_encode_info *pei, de_bitmap *img)
+{
+	deark *c = pei->c;
+	struct png_palhash *ph = NULL;
+	i64 i, j;
+	int k;
+	int bypp = img->bytes_per_pixel;
+	i64 src_bpl = img->width * bypp;
+	u8 used[256+PNG_MAX_EXTRA_COLORS];
+	u8 idmap[256+PNG_MAX_EXTRA_COLORS];
+	int num_hint_colors_used = 0;
+	int num_colors;
+	int bit_depth;
+	int dst_bpl;
+	int is_bw;
+	de_color last_clr;
+	int last_id;
+	u8 *dst = NULL;
+	int retval = 0;
+
+	if(!img->pal_hint || img->pal_hint_num_entries<1) goto done;
+
+	ph = de_malloc(c, sizeof(struct png_palhash));
+	for(k=img->pal_hint_num_entries-1; k>=0; k--) {
+		// Insert in reverse order, so that duplicate colors map to the lowest
+		// palette index.
+		UI h = palhash_slot(img->pal_hint[k]);
+
+		while(ph->val[h] && ph->key[h]!=img->pal_hint[k]) {
+			h = (h+1) & (PNG_PALHASH_SIZE-1);
+		}
+		ph->key[h] = img->pal_hint[k];
+		ph->val[h] = (u16)(k+1);
+	}
+
+	// Pass 1: Make sure every pixel can be represented, and find out which
+	// colors are used.
+	de_zeromem(used, sizeof(used));
+	last_clr = 0;
+	last_id = -1;
+	for(j=0; j<img->height; j++) {
+		const u8 *rowptr = &img->bitmap[j*src_bpl];
+
+		for(i=0; i<img->width; i++) {
+			de_color clr = get_pixel_from_row(&rowptr[i*bypp], bypp);
+
+			if(clr!=last_clr || last_id<0) {
+				last_clr = clr;
+				last_id = palhash_lookup(ph, clr);
+				if(last_id<0) {
+					if(ph->num_extra_colors>=PNG_MAX_EXTRA_COLORS) goto done;
+					last_id = 256 + ph->num_extra_colors;
+					ph->extra_colors[ph->num_extra_colors++] = clr;
+					palhash_insert(ph, clr, last_id);
+				}
+				used[last_id] = 1;
+			}
+		}
+	}
+
+	for(k=0; k<256; k++) {
+		if(used[k]) num_hint_colors_used++;
+	}
+
+	// Unused palette entries are left out. The PLTE chunk isn't compressed,
+	// and a smaller palette may allow a smaller bit depth.
+	num_colors = num_hint_colors_used+ph->num_extra_colors;
+	if(num_colors>256) goto done;
+
+	if(num_colors<=2) bit_depth = 1;
+	else if(num_colors<=4) bit_depth = 2;
+	else if(num_colors<=16) bit_depth = 4;
+	else bit_depth = 8;
+
+	// An 8-bit paletted image is no smaller than an 8-bit grayscale image.
+	if(bypp==1 && bit_depth==8) goto done;
+
+	pei->num_pal_entries = 0;
+	for(k=0; k<256; k++) {
+		if(!used[k]) continue;
+		idmap[k] = (u8)pei->num_pal_entries;
+		pei->pal[pei->num_pal_entries++] = img->pal_hint[k];
+	}
+	for(k=0; k<ph->num_extra_colors; k++) {
+		idmap[256+k] = (u8)pei->num_pal_entries;
+		pei->pal[pei->num_pal_entries++] = ph->extra_colors[k];
+	}
+
+	// A black-and-white image can be written as 1-bit grayscale, with no
+	// palette.
+	is_bw = (bit_depth==1);
+	for(k=0; k<pei->num_pal_entries; k++) {
+		if(pei->pal[k]!=DE_STOCKCOLOR_BLACK && pei->pal[k]!=DE_STOCKCOLOR_WHITE) {
+			is_bw = 0;
+		}
+	}
+	if(is_bw) {
+		for(k=0; k<256+PNG_MAX_EXTRA_COLORS; k++) {
+			if(used[k]) {
+				idmap[k] = (pei->pal[idmap[k]]==DE_STOCKCOLOR_WHITE) ? 1 : 0;
+			}
+		}
+		pei->num_pal_entries = 0;
+	}
+
+	// Pass 2: Write the packed palette indices.
+	dst_bpl = (int)((img->width*bit_depth+7)/8);
+	dst = de_malloc(c, (i64)dst_bpl*img->height);
+	last_id = -1;
+	for(j=0; j<img->height; j++) {
+		const u8 *rowptr = &img->bitmap[j*src_bpl];
+		u8 *dstrow = &dst[j*dst_bpl];
+
+		for(i=0; i<img->width; i++) {
+			de_color clr = get_pixel_from_row(&rowptr[i*bypp], bypp);
+			UI v;
+
+			if(clr!=last_clr || last_id<0) {
+				last_clr = clr;
+				last_id = palhash_lookup(ph, clr);
+			}
+			v = (UI)idmap[last_id];
+			if(bit_depth==8) {
+				dstrow[i] = (u8)v;
+			}
+			else {
+				i64 bitpos = i*bit_depth;
+				dstrow[bitpos/8] |= (u8)(v << (8-bit_depth-(UI)(bitpos%8)));
+			}
+		}
+	}
+
+	pei->color_type = is_bw ? 0 : 3;
+	pei->bit_depth = (u8)bit_depth;
+	pei->num_chans = 1;
+	pei->bpl = dst_bpl;
+	retval = 1;
+
+done:
+	de_free(c, ph);
+	if(!retval) {
+		de_free(c, dst);
+		dst = NULL;
+	}
+	return dst;
+}
+
+static void set_truecolor_format(struct deark_png_encode_info *pei, de_bitmap *img)
+{
+	static const u8 color_type_code[] = {0x00, 0x00, 0x04, 0x02, 0x06};
+
+	pei->num_chans = img->bytes_per_pixel;
+	pei->color_type = color_type_code[pei->num_chans];
+	pei->bit_depth = 8;
+	pei->num_pal_entries = 0;
+	pei->bpl = pei->width * pei->num_chans;
+}
+
+// Call after the color type and bit depth have been decided.
+static void set_filter(struct deark_png_encode_info *pei, de_bitmap *img)
+{
+	pei->filter = pei->c->pngfilter;
+	if(pei->filter==PNGFILTER_ADAPTIVE &&
+		(pei->color_type==3 || pei->bit_depth<8 || img->pal_hint))
+	{
+		// Like libpng, don't filter paletted or low bit depth images. The
+		// same goes for images drawn from a palette that we had to write as
+		// truecolor: Filtering tends to turn their long runs of repeated
+		// byte patterns into noise.
+		pei->filter = PNGFILTER_NONE;
+	}
+}
+
+// For small images, the PLTE and tRNS chunks can cost more than writing a
+// paletted image saves. Encode the image both ways, and keep the smaller one.
+static int do_generate_smaller_png(struct deark_png_encode_info *pei, de_bitmap *img,
+	const u8 *paletted_pixels)
+{
+	deark *c = pei->c;
+	dbuf *outf = pei->outf;
+	dbuf *pal_f = NULL;
+	dbuf *tc_f = NULL;
+	dbuf *best;
+	int retval = 0;
+
+	pal_f = dbuf_create_membuf(c, 0, 0);
+	pei->outf = pal_f;
+	if(!do_generate_png(pei, paletted_pixels)) goto done;
+
+	set_truecolor_format(pei, img);
+	set_filter(pei, img);
+	tc_f = dbuf_create_membuf(c, 0, 0);
+	pei->outf = tc_f;
+	if(!do_generate_png(pei, img->bitmap)) goto done;
+
+	best = (tc_f->len < pal_f->len) ? tc_f : pal_f;
+	dbuf_copy(best, 0, best->len, outf);
+	retval = 1;
+
+done:
+	pei->outf = outf;
+	dbuf_close(pal_f);
+	dbuf_close(tc_f);
+	return retval;
+}
+
+static int get_png_filter_from_option(deark *c, const char *s)
+{
+	static const char *names[6] = { "none", "sub", "up", "average", "paeth",
+		"adaptive" };
+	int i;
+
+	for(i=0; i<6; i++) {
+		if(!de_strcmp(s, names[i])) return i;
+	}
+	if(s[0]>='0' && s[0]<='4' && s[1]=='\0') {
+		return (int)(s[0]-'0');
+	}
+	de_warn(c, "Unknown PNG filter \"%s\"", s);
+	return PNGFILTER_ADAPTIVE;
+}
+
 int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 {
 	const char *opt_level;
+	const char *opt_filter;
 	int retval = 0;
 	struct deark_png_encode_info *pei = NULL;
+	u8 *paletted_pixels = NULL;
 
+	de_stats_begin(c, DE_STATS_PHASE_PNG);
 	pei = de_malloc(c, sizeof(struct deark_png_encode_info));
 	pei->c = c;
 
@@ -260,9 +819,15 @@ int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 	pei->width = (int)img->width;
 	pei->height = (int)img->height;
 	pei->flip = img->flipped;
-	pei->num_chans = img->bytes_per_pixel;
 	pei->include_text_chunk_software = 0;
 
+	if(img->pal_hint) {
+		paletted_pixels = make_paletted_image(pei, img);
+	}
+	if(!paletted_pixels) {
+		set_truecolor_format(pei, img);
+	}
+
 	if(!c->pngcprlevel_valid) {
 		c->pngcmprlevel = 9; // default
 		c->pngcprlevel_valid = 1;
@@ -283,6 +848,17 @@ int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 	}
 	pei->level = c->pngcmprlevel;
 
+	if(!c->pngfilter_valid) {
+		c->pngfilter = PNGFILTER_ADAPTIVE; // default
+		c->pngfilter_valid = 1;
+
+		opt_filter = de_get_ext_option(c, "png:filter");
+		if(opt_filter) {
+			c->pngfilter = get_png_filter_from_option(c, opt_filter);
+		}
+	}
+	set_filter(pei, img);
+
 	if(f->fi_copy && f->fi_copy->internal_mod_time.is_valid) {
 		pei->internal_mod_time = f->fi_copy->internal_mod_time;
 	}
@@ -297,7 +873,13 @@ int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 
 	pei->crco = de_crcobj_create(c, DE_CRCOBJ_CRC32_IEEE);
 
-	if(!do_generate_png(pei, img->bitmap)) {
+	if(paletted_pixels && img->width*img->height <= PNG_PAL_TRIAL_MAX_PIXELS) {
+		if(!do_generate_smaller_png(pei, img, paletted_pixels)) {
+			de_err(c, "PNG write failed");
+			goto done;
+		}
+	}
+	else if(!do_generate_png(pei, paletted_pixels ? paletted_pixels : img->bitmap)) {
 		de_err(c, "PNG write failed");
 		goto done;
 	}
@@ -309,5 +891,7 @@ done:
 		de_crcobj_destroy(pei->crco);
 		de_free(c, pei);
 	}
+	de_free(c, paletted_pixels);
+	de_stats_end(c, DE_STATS_PHASE_PNG);
 	return retval;
 }
@@ -82,6 +82,17 @@ typedef int (*de_module_identify_fn)(deark *c);
 
 typedef void (*de_module_help_fn)(deark *c);
 
+// A "signature" that a module can declare (with de_module_add_sig()), so that
+// format detection can quickly rule out modules that can't possibly match.
+struct deark_module_sig {
+	const char *bytes;
+	const char *ext; // Optional filename extension hint (or NULL)
+	u32 pos;
+	u8 len;
+	u8 confidence;
+	u8 confidence_if_ext; // Used instead of 'confidence' if the file has extension 'ext'
+};
+
 struct deark_module_info {
 	const char *id;
 	const char *desc;
@@ -99,6 +110,12 @@ struct deark_module_info {
 	u32 unique_id; // or 0. Rarely used.
 #define DE_MAX_MODULE_ALIASES 2
 	const char *id_alias[DE_MAX_MODULE_ALIASES];
+	// If a module has any signatures, its identify_fn is only called if at
+	// least one of them matches. A module with signatures but no identify_fn
+	// uses the confidence of the best matching signature.
+	// Signatures should not be used with DE_MODFLAG_SHAREDDETECTION.
+	int first_sig; // Index into deark::module_sig[]
+	int num_sigs;
 };
 typedef void (*de_module_getinfo_fn)(deark *c, struct deark_module_info *mi);
 
@@ -136,6 +153,8 @@ struct de_timestamp {
 	i64 ts_FILETIME; // the timestamp, in Windows FILETIME format
 };
 
+struct de_pagecache;
+
 typedef void (*de_writelistener_cb_type)(dbuf *f, void *userdata, const u8 *buf, i64 buf_len);
 typedef void (*de_dbufcustomread_type)(dbuf *f, void *userdata, u8 *buf, i64 pos, i64 len);
 typedef void (*de_dbufcustomwrite_type)(dbuf *f, void *userdata, const u8 *buf, i64 buf_len);
@@ -169,7 +188,7 @@ struct dbuf_struct {
 	struct dbuf_struct *parent_dbuf; // used for DBUF_TYPE_DBUF
 	i64 offset_into_parent_dbuf; // used for DBUF_TYPE_DBUF
 
-	u8 write_memfile_to_zip_archive;
+	u8 writing_to_zip_archive;
 	u8 writing_to_tar_archive;
 	char *name; // used for DBUF_TYPE_OFILE (utf-8)
 
@@ -188,6 +207,13 @@ struct dbuf_struct {
 	int cache_policy;
 	i64 cache_bytes_used;
 	u8 *cache; // first 'cache_bytes_used' bytes of the file
+	u8 cache_is_mmapped; // If set, 'cache' is a read-only map of the whole file
+	struct de_pagecache *pagecache; // Optional, for IFILE
+
+	// Used with -recursive, for output files. If recursion_copy is NULL,
+	// the dbuf must be a MEMBUF, and is used directly.
+	u8 recurse_on_close;
+	dbuf *recursion_copy;
 
 	// cache2 is a simple 1-byte cache, mainly to speed up de_get_bits_symbol().
 	i64 cache2_pos;
@@ -249,6 +275,10 @@ struct deark_bitmap_struct {
 	i64 bitmap_size; // bytes allocated for bitmap
 	int orig_colortype; // Optional; can be used by modules
 	int orig_bitdepth; // Optional; can be used by modules
+	// Optional palette that the image was (probably) drawn with. It's only a
+	// hint, used to write a paletted PNG file. Use de_bitmap_set_palette_hint().
+	de_color *pal_hint;
+	int pal_hint_num_entries;
 };
 typedef struct deark_bitmap_struct de_bitmap;
 
@@ -321,6 +351,47 @@ enum de_moddisp_enum {
 	DE_MODDISP_INTERNAL     // Another module is using this module
 };
 
+struct de_sig_index_struct;
+
+// Phases timed by the -stats option
+#define DE_STATS_PHASE_DETECT 0 // Format detection
+#define DE_STATS_PHASE_DCMPR  1 // Decompression codecs
+#define DE_STATS_PHASE_PNG    2 // PNG encoding
+#define DE_STATS_PHASE_OUTPUT 3 // Writing and closing output files
+#define DE_STATS_NUM_PHASES   4
+
+// Calls to a timer may be nested, in which case only the outermost call
+// is measured, so that no time is counted twice.
+struct de_stats_timer {
+	int depth;
+	i64 num_calls;
+	u64 wall_us;
+	u64 cpu_us;
+	u64 start_wall_us;
+	u64 start_cpu_us;
+};
+
+// Only allocated if -stats was used.
+struct de_stats {
+	struct de_stats_timer total;
+	struct de_stats_timer phase[DE_STATS_NUM_PHASES];
+	// Per-module timers, indexed the same as c->module_info. Times include
+	// those of any submodules.
+	int num_module_timers;
+	struct de_stats_timer *module_timers;
+	i64 bytes_read; // Bytes read from input files by fread()
+	i64 bytes_mapped; // Bytes of input files accessed via mmap()
+	i64 bytes_written; // Bytes written to output files
+	i64 cache_hits;
+	i64 cache_misses;
+	i64 membuf_cur_bytes;
+	i64 membuf_peak_bytes;
+	i64 membuf_allocs; // Number of times membuf storage was needed
+	i64 membuf_pool_hits; // ... and was supplied by the membuf pool
+	i64 membuf_pool_bytes_reused;
+	i64 dbuf_structs_reused;
+};
+
 struct deark_struct {
 	int debug_level;
 	void *userdata;
@@ -404,15 +475,33 @@ struct deark_struct {
 	de_encoding input_encoding;
 	i64 input_tz_offs_seconds;
 
+	u8 recursive_mode;
+	int recursion_depth; // 0 = processing the primary input file
+	int recursion_max_depth;
+	i64 recursion_max_file_size;
+	i64 recursion_max_total_size;
+	i64 recursion_total_size;
+
 	de_msgfn_type msgfn; // Caller's message output function
 	de_specialmsgfn_type specialmsgfn;
 	de_fatalerrorfn_type fatalerrorfn;
 	const char *dprefix;
 
+	u8 stats_req;
+	struct de_stats *stats; // NULL if -stats is not being used
+
+	// Recycled membuf storage, and dbuf objects. Created when first needed,
+	// unless the caller supplied one with de_set_membuf_pool().
+	struct de_membuf_pool *membuf_pool;
+	u8 membuf_pool_is_owned;
+
 	u8 tmpflag1;
 	u8 tmpflag2;
 	u8 pngcprlevel_valid;
 	unsigned int pngcmprlevel;
+	u8 pngfilter_valid;
+	int pngfilter;
+	u32 *crc32_table; // Built when first needed, by de_crc32_init()
 	void *zip_data;
 	void *tar_data;
 	dbuf *extrlist_dbuf;
@@ -432,6 +521,10 @@ struct deark_struct {
 
 	int num_modules;
 	struct deark_module_info *module_info; // Pointer to an array
+	int num_module_sigs;
+	int module_sig_alloc;
+	struct deark_module_sig *module_sig; // Pointer to an array
+	struct de_sig_index_struct *sig_index;
 
 #define DE_MAX_EXT_OPTIONS 16
 	int num_ext_options;
@@ -441,6 +534,8 @@ struct deark_struct {
 void de_fatalerror(deark *c);
 
 deark *de_create_internal(void);
+struct de_membuf_pool *de_membuf_pool_create_internal(void);
+void de_membuf_pool_destroy_internal(struct de_membuf_pool *pool);
 int de_run_module(deark *c, struct deark_module_info *mi, de_module_params *mparams,
 	enum de_moddisp_enum moddisp);
 int de_run_module_by_id(deark *c, const char *id, de_module_params *mparams);
@@ -450,6 +545,20 @@ int de_run_module_by_id_on_slice2(deark *c, const char *id, const char *codes,
 	dbuf *f, i64 pos, i64 len);
 int de_get_module_idx_by_id(deark *c, const char *module_id);
 struct deark_module_info *de_get_module_by_id(deark *c, const char *module_id);
+void de_module_add_sig(deark *c, struct deark_module_info *mi, i64 pos,
+	const char *bytes, size_t len, int confidence);
+void de_module_add_sig_ext(deark *c, struct deark_module_info *mi, i64 pos,
+	const char *bytes, size_t len, int confidence, const char *ext,
+	int confidence_if_ext);
+void de_build_sig_index(deark *c);
+void de_destroy_sig_index(deark *c);
+struct deark_module_info *de_detect_module_for_file(deark *c, int *errflag);
+void de_recurse_into_file(deark *c, dbuf *f, const char *name);
+
+void de_stats_begin(deark *c, UI phase);
+void de_stats_end(deark *c, UI phase);
+void de_stats_create(deark *c);
+void de_stats_report_and_destroy(deark *c);
 
 void de_strlcpy(char *dst, const char *src, size_t dstlen);
 char *de_strchr(const char *s, int c);
@@ -496,6 +605,8 @@ FILE* de_fopen_for_read(deark *c, const char *fn, i64 *len,
 FILE* de_fopen_for_write(deark *c, const char *fn,
 	char *errmsg, size_t errmsg_len, int overwrite_mode,
 	unsigned int flags);
+void *de_mmap_for_read(deark *c, FILE *fp, i64 len);
+void de_munmap(deark *c, void *m, i64 len);
 int de_fseek(FILE *fp, i64 offs, int whence);
 i64 de_ftell(FILE *fp);
 int de_fclose(FILE *fp);
@@ -545,7 +656,8 @@ void de_tar_close_file(deark *c);
 ///////////////////////////////////////////
 
 int de_zip_create_file(deark *c);
-void de_zip_add_file_to_archive(deark *c, dbuf *f);
+void de_zip_start_member_file(deark *c, dbuf *f);
+void de_zip_end_member_file(deark *c, dbuf *f);
 void de_zip_close_file(deark *c);
 
 int de_write_png(deark *c, de_bitmap *img, dbuf *f);
@@ -565,6 +677,12 @@ u64 de_getu64le_direct(const u8 *m);
 void dbuf_read(dbuf *f, u8 *buf, i64 pos, i64 len);
 i64 dbuf_standard_read(dbuf *f, u8 *buf, i64 n, i64 *fpos);
 
+// Get read-only access to a range of bytes, without copying them if possible.
+// dbuf_get_ptr returns NULL if the bytes aren't all contiguous in memory.
+// dbuf_borrow falls back to reading into 'scratch' ('len' bytes).
+const u8 *dbuf_get_ptr(dbuf *f, i64 pos, i64 len);
+const u8 *dbuf_borrow(dbuf *f, i64 pos, i64 len, u8 *scratch);
+
 u8 dbuf_getbyte(dbuf *f, i64 pos);
 i64 dbuf_geti8(dbuf *f, i64 pos);
 i64 dbuf_getu16be(dbuf *f, i64 pos);
@@ -637,6 +755,7 @@ int dbuf_read_ascii_number(dbuf *f, i64 pos, i64 fieldsize,
 	int base, i64 *value);
 
 #define DE_GETRGBFLAG_BGR 0x1 // Assume BGR order instead of RGB
+#define DE_GETRGBFLAG_ALPHA 0x2 // Row conversion only: A 4th sample is alpha
 de_color dbuf_getRGB(dbuf *f, i64 pos, unsigned int flags);
 
 // Convert and append encoded bytes from a dbuf to a ucstring.
@@ -652,7 +771,11 @@ void dbuf_read_to_ucstring_n(dbuf *f, i64 pos, i64 len, i64 max_len,
 // At least one of 'ext' or 'fi' should be non-NULL.
 #define DE_CREATEFLAG_IS_AUX   0x1
 #define DE_CREATEFLAG_OPT_IMAGE 0x2
+// The file is generated by Deark (e.g. a PNG made from a decoded bitmap),
+// rather than extracted from the input, so -recursive should not look in it.
+#define DE_CREATEFLAG_NO_RECURSE 0x4
 dbuf *dbuf_create_output_file(deark *c, const char *ext, de_finfo *fi, unsigned int createflags);
+int dbuf_output_is_skipped(dbuf *f);
 
 dbuf *dbuf_create_unmanaged_file(deark *c, const char *fname, int overwrite_mode, unsigned int flags);
 dbuf *dbuf_create_unmanaged_file_stdout(deark *c, const char *name);
@@ -746,6 +869,14 @@ int dbuf_search_byte(dbuf *f, const u8 b, i64 startpos,
 int dbuf_search(dbuf *f, const u8 *needle, i64 needle_len,
 	i64 startpos, i64 haystack_len, i64 *foundpos);
 
+struct de_search_needle {
+	const u8 *data;
+	i64 len;
+};
+int dbuf_search_multi(dbuf *f, const struct de_search_needle *needles,
+	i64 num_needles, i64 startpos, i64 haystack_len, i64 *foundpos,
+	i64 *found_idx);
+
 int dbuf_get_utf16_NULterm_len(dbuf *f, i64 pos1, i64 bytes_avail,
 	i64 *bytes_consumed);
 
@@ -784,6 +915,7 @@ struct de_bitbuf_lowlevel {
 };
 void de_bitbuf_lowelevel_add_byte(struct de_bitbuf_lowlevel *bbll, u8 n);
 u64 de_bitbuf_lowelevel_get_bits(struct de_bitbuf_lowlevel *bbll, UI nbits);
+u64 de_bitbuf_lowelevel_peek_bits(struct de_bitbuf_lowlevel *bbll, UI nbits);
 void de_bitbuf_lowelevel_empty(struct de_bitbuf_lowlevel *bbll);
 
 struct de_bitreader {
@@ -794,6 +926,8 @@ struct de_bitreader {
 	struct de_bitbuf_lowlevel bbll;
 };
 u64 de_bitreader_getbits(struct de_bitreader *bitrd, UI nbits);
+int de_bitreader_peekbits(struct de_bitreader *bitrd, UI nbits, u64 *pval);
+void de_bitreader_skipbits(struct de_bitreader *bitrd, UI nbits);
 char *de_bitreader_describe_curpos(struct de_bitreader *bitrd, char *buf, size_t buf_len);
 
 ///////////////////////////////////////////
@@ -815,6 +949,8 @@ de_bitmap *de_bitmap_create(deark *c, i64 width, i64 height, int bypp);
 
 void de_bitmap_destroy(de_bitmap *b);
 
+void de_bitmap_set_palette_hint(de_bitmap *img, const de_color *pal, i64 num_entries);
+
 #define DE_COLOR_A(x)  ((de_colorsample)(((x)>>24)&0xff))
 #define DE_COLOR_R(x)  ((de_colorsample)(((x)>>16)&0xff))
 #define DE_COLOR_G(x)  ((de_colorsample)(((x)>>8)&0xff))
@@ -851,6 +987,22 @@ void de_convert_row_bilevel(dbuf *f, i64 fpos, de_bitmap *img,
 void de_convert_image_bilevel(dbuf *f, i64 fpos, i64 rowspan,
 	de_bitmap *img, unsigned int flags);
 
+// Convert a row of packed 1/2/4/8-bit palette indices.
+void de_convert_row_paletted(dbuf *f, i64 fpos, i64 bpp, const de_color *pal,
+	de_bitmap *img, i64 rownum, unsigned int flags);
+void de_convert_row_paletted_mem(const u8 *src, i64 bpp, const de_color *pal,
+	de_bitmap *img, i64 rownum, unsigned int flags);
+
+// Convert a row of 24-bit (or 32-bit, with DE_GETRGBFLAG_ALPHA) pixels.
+void de_convert_row_rgb(dbuf *f, i64 fpos, i64 pixelspan, de_bitmap *img,
+	i64 rownum, unsigned int flags);
+void de_convert_row_rgb_mem(const u8 *src, i64 pixelspan, de_bitmap *img,
+	i64 rownum, unsigned int flags);
+
+// Set one sample of each pixel in a row. See de_bitmap_setsample().
+void de_convert_row_sample_mem(const u8 *src, i64 srcspan, de_bitmap *img,
+	i64 rownum, i64 samplenum);
+
 void de_convert_and_write_image_bilevel(dbuf *f, i64 fpos,
 	i64 w, i64 h, i64 rowspan, unsigned int cvtflags,
 	de_finfo *fi, unsigned int createflags);
@@ -1037,6 +1189,7 @@ void de_decode_base16(deark *c, dbuf *inf, i64 pos1, i64 len,
 struct de_inthashtable;
 struct de_inthashtable *de_inthashtable_create(deark *c);
 void de_inthashtable_destroy(deark *c, struct de_inthashtable *ht);
+void de_inthashtable_reserve(deark *c, struct de_inthashtable *ht, i64 num_items);
 int de_inthashtable_add_item(deark *c, struct de_inthashtable *ht, i64 key, void *value);
 int de_inthashtable_get_item(deark *c, struct de_inthashtable *ht, i64 key, void **pvalue);
 int de_inthashtable_item_exists(deark *c, struct de_inthashtable *ht, i64 key);
@@ -1194,4 +1347,5 @@ char *de_dbg_timestamp_to_string(deark *c, const struct de_timestamp *ts,
 	char *buf, size_t buf_len, unsigned int flags);
 void de_gmtime(const struct de_timestamp *ts, struct de_struct_tm *tm2);
 void de_current_time_to_timestamp(struct de_timestamp *ts);
+void de_get_perf_times(u64 *wall_us, u64 *cpu_us);
 void de_cached_current_time_to_timestamp(deark *c, struct de_timestamp *ts);
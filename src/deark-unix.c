@@ -12,6 +12,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 #include <utime.h>
 #include <errno.h>
@@ -116,6 +118,30 @@ FILE* de_fopen_for_read(deark *c, const char *fn, i64 *len,
 	return f;
 }
 
+// Map an entire file (that was opened by de_fopen_for_read) into memory,
+// read-only.
+// Returns NULL on failure, in which case the caller should use normal file I/O.
+void *de_mmap_for_read(deark *c, FILE *fp, i64 len)
+{
+	void *m;
+
+	if(len<1) return NULL;
+	if((u64)len > (u64)(size_t)(-1)) return NULL;
+
+	m = mmap(NULL, (size_t)len, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	if(m==MAP_FAILED) {
+		de_dbg2(c, "mmap failed: %s", strerror(errno));
+		return NULL;
+	}
+	return m;
+}
+
+void de_munmap(deark *c, void *m, i64 len)
+{
+	if(!m) return;
+	munmap(m, (size_t)len);
+}
+
 // flags: 0x1 = append instead of overwriting
 FILE* de_fopen_for_write(deark *c, const char *fn,
 	char *errmsg, size_t errmsg_len, int overwrite_mode,
@@ -304,6 +330,26 @@ void de_current_time_to_timestamp(struct de_timestamp *ts)
 	de_timestamp_set_subsec(ts, ((double)tv.tv_usec)/1000000.0);
 }
 
+// Used by -stats. Reports a monotonic "wall clock" time, and the CPU time
+// used by this process, both in microseconds.
+void de_get_perf_times(u64 *wall_us, u64 *cpu_us)
+{
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &ts)==0) {
+		*wall_us = (u64)ts.tv_sec*1000000 + (u64)ts.tv_nsec/1000;
+	}
+	else {
+		*wall_us = 0;
+	}
+	if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts)==0) {
+		*cpu_us = (u64)ts.tv_sec*1000000 + (u64)ts.tv_nsec/1000;
+	}
+	else {
+		*cpu_us = 0;
+	}
+}
+
 void de_exitprocess(int s)
 {
 	exit(s);
@@ -15,62 +15,8 @@
 #define DE_DEFAULT_MAX_FILE_SIZE 0x280000000LL // 10GiB
 #define DE_DEFAULT_MAX_TOTAL_OUTPUT_SIZE 0x3c0000000LL // 15GiB
 #define DE_DEFAULT_MAX_IMAGE_DIMENSION 10000
-
-// Returns the best module to use, by looking at the file contents, etc.
-static struct deark_module_info *detect_module_for_file(deark *c, int *errflag)
-{
-	int i;
-	int result;
-	int orig_errcount;
-	struct deark_module_info *best_module = NULL;
-
-	*errflag = 0;
-	if(!c->detection_data) {
-		c->detection_data = de_malloc(c, sizeof(struct de_detection_data_struct));
-	}
-
-	// This value is made available to modules' identification functions, so
-	// that they can potentially skip expensive tests that cannot possibly return
-	// a high enough confidence.
-	c->detection_data->best_confidence_so_far = 0;
-
-	orig_errcount = c->error_count;
-	for(i=0; i<c->num_modules; i++) {
-		if(c->module_info[i].identify_fn==NULL) continue;
-
-		// If autodetect is disabled for this module, and its autodetect routine
-		// doesn't do anything that may be needed by other modules, don't bother
-		// to run this module's autodetection.
-		if((c->module_info[i].flags & DE_MODFLAG_DISABLEDETECT) &&
-			!(c->module_info[i].flags & DE_MODFLAG_SHAREDDETECTION))
-		{
-			continue;
-		}
-
-		result = c->module_info[i].identify_fn(c);
-
-		if(c->error_count > orig_errcount) {
-			// Detection routines don't normally produce errors. If one does,
-			// it's probably an internal error, or other serious problem.
-			*errflag = 1;
-			return NULL;
-		}
-
-		if(c->module_info[i].flags & DE_MODFLAG_DISABLEDETECT) {
-			// Ignore results of autodetection.
-			continue;
-		}
-
-		if(result <= c->detection_data->best_confidence_so_far) continue;
-
-		// This is the best result so far.
-		c->detection_data->best_confidence_so_far = result;
-		best_module = &c->module_info[i];
-		if(c->detection_data->best_confidence_so_far>=100) break;
-	}
-
-	return best_module;
-}
+#define DE_DEFAULT_MAX_RECURSION_FILE_SIZE 0x10000000LL // 256MiB
+#define DE_DEFAULT_MAX_RECURSION_TOTAL_SIZE 0x100000000LL // 4GiB
 
 struct sort_data_struct {
 	deark *c;
@@ -219,6 +165,8 @@ int de_run(deark *c)
 	de_module_params *mparams = NULL;
 	de_ucstring *friendly_infn = NULL;
 
+	de_stats_create(c);
+
 	if(c->modhelp_req && c->input_format_req) {
 		do_modhelp(c);
 		goto done;
@@ -299,7 +247,7 @@ int de_run(deark *c)
 	if(!module_to_use) {
 		int errflag;
 
-		module_to_use = detect_module_for_file(c, &errflag);
+		module_to_use = de_detect_module_for_file(c, &errflag);
 		if(errflag) goto done;
 		module_was_autodetected = 1;
 	}
@@ -403,6 +351,30 @@ int de_run(deark *c)
 		}
 	}
 
+	if(c->recursive_mode) {
+		const char *s_opt;
+
+		if(c->output_style==DE_OUTPUTSTYLE_STDOUT) {
+			de_warn(c, "-recursive is not supported with -tostdout");
+			c->recursive_mode = 0;
+		}
+		c->recursion_max_depth = 8;
+		s_opt = de_get_ext_option(c, "recursive:maxdepth");
+		if(s_opt) {
+			c->recursion_max_depth = de_atoi(s_opt);
+		}
+		c->recursion_max_file_size = DE_DEFAULT_MAX_RECURSION_FILE_SIZE;
+		s_opt = de_get_ext_option(c, "recursive:maxfilesize");
+		if(s_opt) {
+			c->recursion_max_file_size = de_atoi64(s_opt);
+		}
+		c->recursion_max_total_size = DE_DEFAULT_MAX_RECURSION_TOTAL_SIZE;
+		s_opt = de_get_ext_option(c, "recursive:maxtotalsize");
+		if(s_opt) {
+			c->recursion_max_total_size = de_atoi64(s_opt);
+		}
+	}
+
 	if(de_get_ext_option_bool(c, "list:fileid", 0)) {
 		c->list_mode_include_file_id = 1;
 	}
@@ -473,8 +445,11 @@ void de_destroy(deark *c)
 	i64 i;
 
 	if(!c) return;
+	de_stats_begin(c, DE_STATS_PHASE_OUTPUT);
 	if(c->zip_data) { de_zip_close_file(c); }
 	if(c->tar_data) { de_tar_close_file(c); }
+	de_stats_end(c, DE_STATS_PHASE_OUTPUT);
+	if(c->stats) { de_stats_report_and_destroy(c); }
 	if(c->extrlist_dbuf) { dbuf_close(c->extrlist_dbuf); }
 	for(i=0; i<c->num_ext_options; i++) {
 		de_free(c, c->ext_option[i].name);
@@ -484,10 +459,35 @@ void de_destroy(deark *c)
 	if(c->output_archive_filename) { de_free(c, c->output_archive_filename); }
 	if(c->extrlist_filename) { de_free(c, c->extrlist_filename); }
 	if(c->detection_data) { de_free(c, c->detection_data); }
+	de_destroy_sig_index(c);
+	de_free(c, c->crc32_table);
+	de_free(c, c->module_sig);
 	de_free(c, c->module_info);
+	if(c->membuf_pool_is_owned) {
+		de_membuf_pool_destroy_internal(c->membuf_pool);
+	}
 	de_free(NULL,c);
 }
 
+struct de_membuf_pool *de_membuf_pool_create(void)
+{
+	return de_membuf_pool_create_internal();
+}
+
+void de_membuf_pool_destroy(struct de_membuf_pool *pool)
+{
+	de_membuf_pool_destroy_internal(pool);
+}
+
+void de_set_membuf_pool(deark *c, struct de_membuf_pool *pool)
+{
+	if(c->membuf_pool_is_owned) {
+		de_membuf_pool_destroy_internal(c->membuf_pool);
+	}
+	c->membuf_pool = pool;
+	c->membuf_pool_is_owned = 0;
+}
+
 void de_set_userdata(deark *c, void *x)
 {
 	c->userdata = x;
@@ -664,6 +664,12 @@ void de_set_output_archive_filename(deark *c, const char *dname, const char *fn,
 	c->output_archive_filename = make_output_filename(c, dname, fn, suffix, flags);
 }
 
+// Also process the files we extract, and the files extracted from them, etc.
+void de_set_recursive_mode(deark *c, int x)
+{
+	c->recursive_mode = x ? 1 : 0;
+}
+
 void de_set_extrlist_filename(deark *c, const char *fn)
 {
 	if(c->extrlist_filename) de_free(c, c->extrlist_filename);
@@ -749,6 +755,11 @@ void de_set_listmode(deark *c, int x)
 	c->list_mode = x?1:0;
 }
 
+void de_set_stats(deark *c, int x)
+{
+	c->stats_req = x?1:0;
+}
+
 void de_set_want_modhelp(deark *c, int x)
 {
 	c->modhelp_req = x?1:0;
@@ -904,3 +915,106 @@ void de_set_disable_moddetect(deark *c, const char *s, int invert)
 		c->onlydetectmods_string = s;
 	}
 }
+
+struct de_filelist {
+	i64 num_items;
+	i64 next_item;
+	char **items; // array[num_items] of UTF-8 strings
+};
+
+// Read a list of filenames, one per line, from the named file, or from stdin
+// if fn is NULL. Blank lines are ignored. Returns NULL on error.
+struct de_filelist *de_filelist_create(deark *c, const char *fn)
+{
+	struct de_filelist *fl = NULL;
+	FILE *fp = NULL;
+	dbuf *tmpf = NULL;
+	u8 buf[4096];
+	char errmsg[200];
+	unsigned int returned_flags = 0;
+	i64 file_len = 0;
+	i64 pos, linestart;
+	i64 num_alloc = 0;
+	int ok = 0;
+
+	if(fn) {
+		fp = de_fopen_for_read(c, fn, &file_len, errmsg, sizeof(errmsg),
+			&returned_flags);
+		if(!fp) {
+			de_err(c, "Can't read %s: %s", fn, errmsg);
+			goto done;
+		}
+	}
+	else {
+		fp = stdin;
+	}
+
+	tmpf = dbuf_create_membuf(c, 0, 0);
+	while(1) {
+		size_t n;
+
+		n = fread(buf, 1, sizeof(buf), fp);
+		if(n==0) break;
+		dbuf_write(tmpf, buf, (i64)n);
+	}
+	// Make sure the last line is terminated
+	dbuf_writebyte(tmpf, '\n');
+
+	fl = de_malloc(c, sizeof(struct de_filelist));
+	linestart = 0;
+	for(pos=0; pos<tmpf->len; pos++) {
+		i64 linelen;
+		u8 b;
+
+		b = dbuf_getbyte(tmpf, pos);
+		if(b!='\n') continue;
+
+		linelen = pos - linestart;
+		if(linelen>0 && dbuf_getbyte(tmpf, linestart+linelen-1)=='\r') {
+			linelen--;
+		}
+		if(linelen>0) {
+			if(fl->num_items >= num_alloc) {
+				i64 new_num_alloc = num_alloc ? num_alloc*2 : 64;
+
+				fl->items = de_reallocarray(c, fl->items, num_alloc, sizeof(char*),
+					new_num_alloc);
+				num_alloc = new_num_alloc;
+			}
+			fl->items[fl->num_items] = de_malloc(c, linelen+1);
+			dbuf_read(tmpf, (u8*)fl->items[fl->num_items], linestart, linelen);
+			fl->num_items++;
+		}
+		linestart = pos+1;
+	}
+	ok = 1;
+
+done:
+	if(fp && fp!=stdin) de_fclose(fp);
+	dbuf_close(tmpf);
+	if(!ok && fl) {
+		de_filelist_destroy(c, fl);
+		fl = NULL;
+	}
+	return fl;
+}
+
+// Returns NULL when there are no more items.
+// The returned string remains valid until the list is destroyed.
+const char *de_filelist_next(struct de_filelist *fl)
+{
+	if(fl->next_item >= fl->num_items) return NULL;
+	return fl->items[fl->next_item++];
+}
+
+void de_filelist_destroy(deark *c, struct de_filelist *fl)
+{
+	i64 k;
+
+	if(!fl) return;
+	for(k=0; k<fl->num_items; k++) {
+		de_free(c, fl->items[k]);
+	}
+	de_free(c, fl->items);
+	de_free(c, fl);
+}
@@ -25,6 +25,11 @@ void de_set_input_file_slice_size(deark *c, i64 n);
 
 int de_run(deark *c);
 
+struct de_filelist;
+struct de_filelist *de_filelist_create(deark *c, const char *fn);
+const char *de_filelist_next(struct de_filelist *fl);
+void de_filelist_destroy(deark *c, struct de_filelist *fl);
+
 void de_print_module_list(deark *c);
 
 void de_set_userdata(deark *c, void *x);
@@ -41,6 +46,7 @@ void de_set_extract_policy(deark *c, int x);
 void de_set_extract_level(deark *c, int x);
 
 void de_set_listmode(deark *c, int x);
+void de_set_stats(deark *c, int x);
 void de_set_want_modhelp(deark *c, int x);
 void de_set_id_mode(deark *c, int x);
 void de_set_first_output_file(deark *c, int x);
@@ -89,10 +95,19 @@ void de_set_output_archive_filename(deark *c, const char *dirname, const char *f
 	unsigned int flags);
 
 void de_set_extrlist_filename(deark *c, const char *fn);
+void de_set_recursive_mode(deark *c, int x);
 
 void de_set_disable_mods(deark *c, const char *s, int invert);
 void de_set_disable_moddetect(deark *c, const char *s, int invert);
 
+// A membuf pool can be shared by deark objects that are used one after
+// another (not simultaneously), so that memory can be reused between them.
+// It must be destroyed after all the deark objects that use it.
+struct de_membuf_pool;
+struct de_membuf_pool *de_membuf_pool_create(void);
+void de_membuf_pool_destroy(struct de_membuf_pool *pool);
+void de_set_membuf_pool(deark *c, struct de_membuf_pool *pool);
+
 struct de_platform_data;
 struct de_platform_data *de_platformdata_create(void);
 void de_platformdata_destroy(struct de_platform_data *plctx);
@@ -760,11 +760,174 @@ struct deark_module_info *de_get_module_by_id(deark *c, const char *module_id)
 	return &c->module_info[idx];
 }
 
+static void stats_timer_begin(struct de_stats_timer *t)
+{
+	t->depth++;
+	if(t->depth!=1) return;
+	t->num_calls++;
+	de_get_perf_times(&t->start_wall_us, &t->start_cpu_us);
+}
+
+static void stats_timer_end(struct de_stats_timer *t)
+{
+	u64 wall_us, cpu_us;
+
+	if(t->depth<1) return;
+	t->depth--;
+	if(t->depth!=0) return;
+	de_get_perf_times(&wall_us, &cpu_us);
+	if(wall_us > t->start_wall_us) t->wall_us += wall_us - t->start_wall_us;
+	if(cpu_us > t->start_cpu_us) t->cpu_us += cpu_us - t->start_cpu_us;
+}
+
+// Start timing a DE_STATS_PHASE_*. Does nothing unless -stats was used.
+void de_stats_begin(deark *c, UI phase)
+{
+	if(!c->stats || phase>=DE_STATS_NUM_PHASES) return;
+	stats_timer_begin(&c->stats->phase[phase]);
+}
+
+void de_stats_end(deark *c, UI phase)
+{
+	if(!c->stats || phase>=DE_STATS_NUM_PHASES) return;
+	stats_timer_end(&c->stats->phase[phase]);
+}
+
+static struct de_stats_timer *get_module_timer(deark *c, struct deark_module_info *mi)
+{
+	struct de_stats *st = c->stats;
+	i64 idx;
+
+	if(!st) return NULL;
+	if(!st->module_timers) {
+		if(c->num_modules<1) return NULL;
+		st->num_module_timers = c->num_modules;
+		st->module_timers = de_mallocarray(c, st->num_module_timers,
+			sizeof(struct de_stats_timer));
+	}
+	idx = (i64)(mi - c->module_info);
+	if(idx<0 || idx>=(i64)st->num_module_timers) return NULL;
+	return &st->module_timers[idx];
+}
+
+void de_stats_create(deark *c)
+{
+	if(!c->stats_req || c->stats) return;
+	c->stats = de_malloc(c, sizeof(struct de_stats));
+	stats_timer_begin(&c->stats->total);
+}
+
+static void stats_write_json_string(dbuf *f, const char *s)
+{
+	size_t i;
+
+	dbuf_writebyte(f, '"');
+	for(i=0; s[i]; i++) {
+		u8 ch = (u8)s[i];
+
+		if(ch=='"' || ch=='\\') {
+			dbuf_writebyte(f, '\\');
+			dbuf_writebyte(f, ch);
+		}
+		else if(ch<0x20 || ch==0x7f) {
+			dbuf_printf(f, "\\u%04x", (UI)ch);
+		}
+		else {
+			dbuf_writebyte(f, ch); // Includes UTF-8 multi-byte sequences
+		}
+	}
+	dbuf_writebyte(f, '"');
+}
+
+static void stats_write_timer(dbuf *f, const struct de_stats_timer *t)
+{
+	dbuf_printf(f, "{\"calls\":%"I64_FMT",\"wall_us\":%"U64_FMT",\"cpu_us\":%"U64_FMT"}",
+		t->num_calls, t->wall_us, t->cpu_us);
+}
+
+// Emit the -stats report (a single line of JSON) via the message callback,
+// and free the stats object.
+void de_stats_report_and_destroy(deark *c)
+{
+	static const char *phase_names[DE_STATS_NUM_PHASES] = {
+		"detect", "decompress", "png", "output" };
+	struct de_stats *st;
+	dbuf *f = NULL;
+	i64 num_accesses;
+	int i;
+	int count;
+
+	// Detach the stats object, so that our own allocations aren't counted.
+	st = c->stats;
+	if(!st) return;
+	c->stats = NULL;
+	st->total.depth = 1;
+	stats_timer_end(&st->total);
+
+	f = dbuf_create_membuf(c, 0, 0);
+	dbuf_puts(f, "{\"deark_stats\":{\"input_file\":");
+	if(c->input_filename) {
+		stats_write_json_string(f, c->input_filename);
+	}
+	else {
+		dbuf_puts(f, "null");
+	}
+	dbuf_printf(f, ",\"wall_us\":%"U64_FMT",\"cpu_us\":%"U64_FMT,
+		st->total.wall_us, st->total.cpu_us);
+
+	dbuf_puts(f, ",\"phases\":{");
+	for(i=0; i<DE_STATS_NUM_PHASES; i++) {
+		dbuf_printf(f, "%s\"%s\":", (i>0)?",":"", phase_names[i]);
+		stats_write_timer(f, &st->phase[i]);
+	}
+
+	dbuf_puts(f, "},\"modules\":{");
+	count = 0;
+	for(i=0; i<st->num_module_timers && i<c->num_modules; i++) {
+		if(st->module_timers[i].num_calls==0) continue;
+		if(count>0) dbuf_writebyte(f, ',');
+		stats_write_json_string(f, c->module_info[i].id);
+		dbuf_writebyte(f, ':');
+		stats_write_timer(f, &st->module_timers[i]);
+		count++;
+	}
+
+	num_accesses = st->cache_hits + st->cache_misses;
+	dbuf_printf(f, "},\"io\":{\"input_bytes_read\":%"I64_FMT
+		",\"input_bytes_mapped\":%"I64_FMT
+		",\"output_bytes_written\":%"I64_FMT
+		",\"files_extracted\":%d"
+		",\"cache_hits\":%"I64_FMT",\"cache_misses\":%"I64_FMT,
+		st->bytes_read, st->bytes_mapped, st->bytes_written,
+		c->num_files_extracted, st->cache_hits, st->cache_misses);
+	if(num_accesses>0) {
+		dbuf_printf(f, ",\"cache_hit_rate\":%.4f",
+			(double)st->cache_hits/(double)num_accesses);
+	}
+	else {
+		dbuf_puts(f, ",\"cache_hit_rate\":null");
+	}
+	dbuf_printf(f, "},\"memory\":{\"membuf_peak_bytes\":%"I64_FMT, st->membuf_peak_bytes);
+	dbuf_printf(f, ",\"membuf_allocs\":%"I64_FMT",\"membuf_pool_hits\":%"I64_FMT
+		",\"membuf_pool_bytes_reused\":%"I64_FMT",\"dbuf_structs_reused\":%"I64_FMT,
+		st->membuf_allocs, st->membuf_pool_hits, st->membuf_pool_bytes_reused,
+		st->dbuf_structs_reused);
+	dbuf_puts(f, "}}}\n");
+	dbuf_writebyte(f, 0);
+
+	de_puts(c, DE_MSGTYPE_MESSAGE|DE_MSGFLAG_STATS, (const char*)f->membuf_buf);
+
+	dbuf_close(f);
+	de_free(c, st->module_timers);
+	de_free(c, st);
+}
+
 int de_run_module(deark *c, struct deark_module_info *mi, de_module_params *mparams,
 	enum de_moddisp_enum moddisp)
 {
 	enum de_moddisp_enum old_moddisp;
 	struct de_detection_data_struct *old_detection_data;
+	struct de_stats_timer *mtimer = NULL;
 
 	if(!mi) return 0;
 	if(!mi->run_fn) return 0;
@@ -786,14 +949,333 @@ int de_run_module(deark *c, struct deark_module_info *mi, de_module_params *mpar
 	if(c->module_nesting_level>0 && c->debug_level>=3) {
 		de_dbg3(c, "[using %s module]", mi->id);
 	}
+	if(c->stats) {
+		mtimer = get_module_timer(c, mi);
+		if(mtimer) stats_timer_begin(mtimer);
+	}
 	c->module_nesting_level++;
 	mi->run_fn(c, mparams);
 	c->module_nesting_level--;
+	if(mtimer) stats_timer_end(mtimer);
 	c->module_disposition = old_moddisp;
 	c->detection_data = old_detection_data;
 	return 1;
 }
 
+void de_module_add_sig(deark *c, struct deark_module_info *mi, i64 pos,
+	const char *bytes, size_t len, int confidence)
+{
+	de_module_add_sig_ext(c, mi, pos, bytes, len, confidence, NULL, confidence);
+}
+
+// If the file has extension 'ext', the confidence will be confidence_if_ext.
+// A module's signatures must be added consecutively, from its getinfo function.
+void de_module_add_sig_ext(deark *c, struct deark_module_info *mi, i64 pos,
+	const char *bytes, size_t len, int confidence, const char *ext,
+	int confidence_if_ext)
+{
+	struct deark_module_sig *sig;
+
+	if(len<1 || len>255 || pos<0 || pos>0xffffffffLL) {
+		de_err(c, "Internal: Bad signature for module %s", mi->id);
+		de_fatalerror(c);
+		return;
+	}
+
+	if(c->num_module_sigs >= c->module_sig_alloc) {
+		i64 new_alloc;
+
+		new_alloc = de_max_int(64, (i64)c->module_sig_alloc*2);
+		c->module_sig = de_reallocarray(c, c->module_sig, c->module_sig_alloc,
+			sizeof(struct deark_module_sig), new_alloc);
+		c->module_sig_alloc = (int)new_alloc;
+	}
+
+	if(mi->num_sigs==0) {
+		mi->first_sig = c->num_module_sigs;
+	}
+	sig = &c->module_sig[c->num_module_sigs++];
+	mi->num_sigs++;
+	sig->bytes = bytes;
+	sig->len = (u8)len;
+	sig->pos = (u32)pos;
+	sig->confidence = (u8)confidence;
+	sig->ext = ext;
+	sig->confidence_if_ext = (u8)confidence_if_ext;
+}
+
+// Signatures that start at offset 0 are indexed by their first byte. Others
+// go in an extra bucket, which is always checked.
+#define DE_SIG_OTHER_BUCKET 256
+#define DE_SIG_HDR_SIZE     64
+
+struct de_sig_index_entry {
+	int module_idx;
+	int sig_idx; // Index into c->module_sig[]
+};
+
+struct de_sig_index_struct {
+	int bucket_start[DE_SIG_OTHER_BUCKET+2];
+	struct de_sig_index_entry *entries;
+};
+
+static int get_sig_bucket(const struct deark_module_sig *sig)
+{
+	if(sig->pos==0) return (int)(u8)sig->bytes[0];
+	return DE_SIG_OTHER_BUCKET;
+}
+
+// Called after the modules have been registered (and possibly disabled).
+void de_build_sig_index(deark *c)
+{
+	struct de_sig_index_struct *si;
+	int i, k;
+	int num_entries = 0;
+	int next[DE_SIG_OTHER_BUCKET+1];
+
+	if(c->sig_index) return;
+	si = de_malloc(c, sizeof(struct de_sig_index_struct));
+	c->sig_index = si;
+
+	// Counting sort, by bucket
+	for(i=0; i<c->num_modules; i++) {
+		const struct deark_module_info *mi = &c->module_info[i];
+
+		for(k=mi->first_sig; k<mi->first_sig+mi->num_sigs; k++) {
+			si->bucket_start[get_sig_bucket(&c->module_sig[k])+1]++;
+			num_entries++;
+		}
+	}
+	for(i=1; i<=DE_SIG_OTHER_BUCKET+1; i++) {
+		si->bucket_start[i] += si->bucket_start[i-1];
+	}
+
+	si->entries = de_mallocarray(c, de_max_int(num_entries, 1), sizeof(struct de_sig_index_entry));
+	de_memcpy(next, si->bucket_start, sizeof(next));
+
+	// Within a bucket, entries stay in module order.
+	for(i=0; i<c->num_modules; i++) {
+		const struct deark_module_info *mi = &c->module_info[i];
+
+		for(k=mi->first_sig; k<mi->first_sig+mi->num_sigs; k++) {
+			int e;
+
+			e = next[get_sig_bucket(&c->module_sig[k])]++;
+			si->entries[e].module_idx = i;
+			si->entries[e].sig_idx = k;
+		}
+	}
+}
+
+void de_destroy_sig_index(deark *c)
+{
+	if(!c->sig_index) return;
+	de_free(c, c->sig_index->entries);
+	de_free(c, c->sig_index);
+	c->sig_index = NULL;
+}
+
+static int sig_matches(deark *c, const struct deark_module_sig *sig,
+	const u8 *hdr, i64 hdr_len)
+{
+	i64 endpos;
+
+	endpos = (i64)sig->pos + (i64)sig->len;
+	if(endpos <= hdr_len) {
+		return !de_memcmp(&hdr[sig->pos], sig->bytes, (size_t)sig->len);
+	}
+	if(endpos > c->infile->len) return 0;
+	return !dbuf_memcmp(c->infile, (i64)sig->pos, sig->bytes, (size_t)sig->len);
+}
+
+static void check_sig_bucket(deark *c, int bucket, const u8 *hdr, i64 hdr_len,
+	i16 *sig_result)
+{
+	struct de_sig_index_struct *si = c->sig_index;
+	int e;
+
+	for(e=si->bucket_start[bucket]; e<si->bucket_start[bucket+1]; e++) {
+		const struct deark_module_sig *sig;
+		int conf;
+
+		sig = &c->module_sig[si->entries[e].sig_idx];
+		if(!sig_matches(c, sig, hdr, hdr_len)) continue;
+
+		conf = (int)sig->confidence;
+		if(sig->ext && de_input_file_has_ext(c, sig->ext)) {
+			conf = (int)sig->confidence_if_ext;
+		}
+		if(conf > sig_result[si->entries[e].module_idx]) {
+			sig_result[si->entries[e].module_idx] = (i16)conf;
+		}
+	}
+}
+
+// Sets sig_result[n] to the best confidence of the matching signatures of
+// module n, or to -1 if none match.
+static void evaluate_sigs(deark *c, i16 *sig_result)
+{
+	u8 hdr[DE_SIG_HDR_SIZE];
+	i64 hdr_len;
+	int i;
+
+	for(i=0; i<c->num_modules; i++) {
+		sig_result[i] = -1;
+	}
+
+	hdr_len = de_min_int(c->infile->len, DE_SIG_HDR_SIZE);
+	if(hdr_len>0) {
+		dbuf_read(c->infile, hdr, 0, hdr_len);
+		check_sig_bucket(c, (int)hdr[0], hdr, hdr_len, sig_result);
+	}
+	check_sig_bucket(c, DE_SIG_OTHER_BUCKET, hdr, hdr_len, sig_result);
+}
+
+// Returns the best module to use, by looking at the file contents, etc.
+struct deark_module_info *de_detect_module_for_file(deark *c, int *errflag)
+{
+	int i;
+	int result;
+	int orig_errcount;
+	struct deark_module_info *best_module = NULL;
+	i16 *sig_result = NULL;
+
+	*errflag = 0;
+	de_stats_begin(c, DE_STATS_PHASE_DETECT);
+	if(!c->detection_data) {
+		c->detection_data = de_malloc(c, sizeof(struct de_detection_data_struct));
+	}
+
+	// This value is made available to modules' identification functions, so
+	// that they can potentially skip expensive tests that cannot possibly return
+	// a high enough confidence.
+	c->detection_data->best_confidence_so_far = 0;
+
+	de_build_sig_index(c);
+	sig_result = de_mallocarray(c, c->num_modules, sizeof(i16));
+	evaluate_sigs(c, sig_result);
+
+	orig_errcount = c->error_count;
+	for(i=0; i<c->num_modules; i++) {
+		struct deark_module_info *mi = &c->module_info[i];
+
+		if(mi->num_sigs>0) {
+			// None of this module's signatures match, so its identify_fn
+			// could not return a nonzero confidence.
+			if(sig_result[i]<0) continue;
+		}
+		else if(mi->identify_fn==NULL) {
+			continue;
+		}
+
+		// If autodetect is disabled for this module, and its autodetect routine
+		// doesn't do anything that may be needed by other modules, don't bother
+		// to run this module's autodetection.
+		if((mi->flags & DE_MODFLAG_DISABLEDETECT) &&
+			!(mi->flags & DE_MODFLAG_SHAREDDETECTION))
+		{
+			continue;
+		}
+
+		if(mi->identify_fn) {
+			result = mi->identify_fn(c);
+		}
+		else {
+			result = (int)sig_result[i];
+		}
+
+		if(c->error_count > orig_errcount) {
+			// Detection routines don't normally produce errors. If one does,
+			// it's probably an internal error, or other serious problem.
+			*errflag = 1;
+			best_module = NULL;
+			goto done;
+		}
+
+		if(mi->flags & DE_MODFLAG_DISABLEDETECT) {
+			// Ignore results of autodetection.
+			continue;
+		}
+
+		if(result <= c->detection_data->best_confidence_so_far) continue;
+
+		// This is the best result so far.
+		c->detection_data->best_confidence_so_far = result;
+		best_module = mi;
+		if(c->detection_data->best_confidence_so_far>=100) break;
+	}
+
+done:
+	de_free(c, sig_result);
+	de_stats_end(c, DE_STATS_PHASE_DETECT);
+	return best_module;
+}
+
+// Used with -recursive. Runs the appropriate module (if any) on a file that
+// was just extracted. f contains the file's data, and name is its output
+// filename, which will be used as the base name of any files extracted from
+// it.
+void de_recurse_into_file(deark *c, dbuf *f, const char *name)
+{
+	struct deark_module_info *mi = NULL;
+	dbuf *old_infile;
+	const char *old_input_filename;
+	char *old_base_output_filename;
+	int old_suppress_detection_by_filename;
+	int old_file_count;
+	struct de_detection_data_struct *old_detection_data;
+	int errflag = 0;
+
+	if(f->len<1) return;
+	if(c->module_nesting_level >= DE_MAX_SUBMODULE_NESTING_LEVEL) {
+		de_dbg(c, "not recursing into %s: nesting level too deep", name);
+		return;
+	}
+
+	old_infile = c->infile;
+	old_input_filename = c->input_filename;
+	old_base_output_filename = c->base_output_filename;
+	old_suppress_detection_by_filename = c->suppress_detection_by_filename;
+	old_file_count = c->file_count;
+	old_detection_data = c->detection_data;
+
+	c->infile = f;
+	c->input_filename = name;
+	c->base_output_filename = de_strdup(c, name);
+	c->suppress_detection_by_filename = 0;
+	c->file_count = 0;
+	c->detection_data = NULL;
+	c->recursion_depth++;
+
+	mi = de_detect_module_for_file(c, &errflag);
+	if(errflag) mi = NULL;
+	// Skip modules that won't extract anything, such as the one that only
+	// identifies unsupported formats.
+	if(mi && ((mi->flags & (DE_MODFLAG_NOEXTRACT|DE_MODFLAG_SECURITYWARNING)) ||
+		mi->unique_id==1))
+	{
+		mi = NULL;
+	}
+
+	if(mi) {
+		de_info(c, "Module: %s (for %s)", mi->id, name);
+		de_run_module(c, mi, NULL, DE_MODDISP_AUTODETECT);
+	}
+	else {
+		de_dbg(c, "not recursing into %s: format not recognized", name);
+	}
+
+	c->recursion_depth--;
+	de_free(c, c->detection_data);
+	de_free(c, c->base_output_filename);
+	c->infile = old_infile;
+	c->input_filename = old_input_filename;
+	c->base_output_filename = old_base_output_filename;
+	c->suppress_detection_by_filename = old_suppress_detection_by_filename;
+	c->file_count = old_file_count;
+	c->detection_data = old_detection_data;
+}
+
 int de_run_module_by_id(deark *c, const char *id, de_module_params *mparams)
 {
 	struct deark_module_info *module_to_use;
@@ -1612,99 +2094,135 @@ void de_copy_bits(const u8 *src, i64 srcbitnum,
 	}
 }
 
-// A very simple hash table implementation, with int64 keys.
+// A simple hash table implementation, with int64 keys.
+// Uses open addressing with linear probing. The capacity is always a power
+// of 2, and the table grows as needed.
 
-#define DE_INTHASHTABLE_NBUCKETS 71
+#define DE_INTHASHTABLE_MIN_CAPACITY 16
 
 struct de_inthashtable_item {
 	i64 key;
 	void *value;
-	struct de_inthashtable_item *next; // Next item in linked list
-};
-
-struct de_inthashtable_bucket {
-	struct de_inthashtable_item *first_item;
+	u8 in_use;
 };
 
 struct de_inthashtable {
-	struct de_inthashtable_bucket buckets[DE_INTHASHTABLE_NBUCKETS];
+	i64 num_items;
+	i64 capacity; // 0, or a power of 2
+	struct de_inthashtable_item *items;
+	i64 scan_pos; // Where de_inthashtable_remove_any_item() starts looking
 };
 
-static struct de_inthashtable_bucket *inthashtable_find_bucket(struct de_inthashtable *ht,
-	i64 key)
+// Mix all the bits of the key (the splitmix64 finalizer), so that keys that
+// are multiples of a sector or node size don't all land in the same place.
+static i64 inthashtable_hash(struct de_inthashtable *ht, i64 key)
 {
-	i64 bkt_num;
+	u64 x = (u64)key;
 
-	if(key>=0) bkt_num = key%DE_INTHASHTABLE_NBUCKETS;
-	else bkt_num = (-key)%DE_INTHASHTABLE_NBUCKETS;
-
-	return &ht->buckets[bkt_num];
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return (i64)(x & (u64)(ht->capacity-1));
 }
 
-struct de_inthashtable *de_inthashtable_create(deark *c)
+// Returns the index of the item, or -1 if it does not exist.
+static i64 inthashtable_find_slot(struct de_inthashtable *ht, i64 key)
 {
-	return de_mallocarray(c, DE_INTHASHTABLE_NBUCKETS, sizeof(struct de_inthashtable));
-}
+	i64 i;
 
-static void inthashtable_destroy_item(deark *c, struct de_inthashtable_item *item)
-{
-	de_free(c, item);
+	if(!ht || ht->num_items==0) return -1;
+	i = inthashtable_hash(ht, key);
+	while(ht->items[i].in_use) {
+		if(ht->items[i].key==key) return i;
+		i = (i+1) & (ht->capacity-1);
+	}
+	return -1;
 }
 
-static void inthashtable_destroy_items_in_bucket(deark *c, struct de_inthashtable_bucket *bkt)
+// Unconditionally adds an item (does not prevent duplicates).
+// There must be room for it.
+static void inthashtable_insert_noresize(struct de_inthashtable *ht, i64 key, void *value)
 {
-	struct de_inthashtable_item *next_item;
+	i64 i;
 
-	while(bkt->first_item) {
-		next_item = bkt->first_item->next;
-		inthashtable_destroy_item(c, bkt->first_item);
-		bkt->first_item = next_item;
+	i = inthashtable_hash(ht, key);
+	while(ht->items[i].in_use) {
+		i = (i+1) & (ht->capacity-1);
 	}
+	ht->items[i].key = key;
+	ht->items[i].value = value;
+	ht->items[i].in_use = 1;
+	ht->num_items++;
 }
 
-void de_inthashtable_destroy(deark *c, struct de_inthashtable *ht)
+static void inthashtable_set_capacity(deark *c, struct de_inthashtable *ht, i64 new_capacity)
 {
+	struct de_inthashtable_item *old_items;
+	i64 old_capacity;
 	i64 i;
 
-	if(!ht) return;
-	for(i=0; i<DE_INTHASHTABLE_NBUCKETS; i++) {
-		if(ht->buckets[i].first_item)
-			inthashtable_destroy_items_in_bucket(c, &ht->buckets[i]);
+	old_items = ht->items;
+	old_capacity = ht->capacity;
+
+	ht->items = de_mallocarray(c, new_capacity, sizeof(struct de_inthashtable_item));
+	ht->capacity = new_capacity;
+	ht->num_items = 0;
+	ht->scan_pos = 0;
+
+	for(i=0; i<old_capacity; i++) {
+		if(old_items[i].in_use) {
+			inthashtable_insert_noresize(ht, old_items[i].key, old_items[i].value);
+		}
 	}
-	de_free(c, ht);
+	de_free(c, old_items);
 }
 
-// Returns NULL if item does not exist in the given bucket
-static struct de_inthashtable_item *inthashtable_find_item_in_bucket(struct de_inthashtable *ht,
-	struct de_inthashtable_bucket *bkt, i64 key)
+// Make sure there is room for at least num_items items (in total), without
+// the table having to grow. Use this to avoid repeated rehashing, when the
+// number of items is known in advance.
+void de_inthashtable_reserve(deark *c, struct de_inthashtable *ht, i64 num_items)
 {
-	struct de_inthashtable_item *p;
+	i64 new_capacity;
 
-	p = bkt->first_item;
-	while(p && (p->key != key)) {
-		p = p->next;
+	if(ht->capacity>0) {
+		new_capacity = ht->capacity;
+	}
+	else {
+		new_capacity = DE_INTHASHTABLE_MIN_CAPACITY;
+	}
+
+	// Keep the load factor at or below 3/4.
+	while(num_items > (new_capacity/4)*3) {
+		new_capacity *= 2;
+	}
+
+	if(new_capacity != ht->capacity) {
+		inthashtable_set_capacity(c, ht, new_capacity);
 	}
-	return p;
 }
 
-// Returns NULL if item does not exist
-static struct de_inthashtable_item *inthashtable_find_item(struct de_inthashtable *ht, i64 key)
+struct de_inthashtable *de_inthashtable_create(deark *c)
 {
-	struct de_inthashtable_bucket *bkt;
+	return de_malloc(c, sizeof(struct de_inthashtable));
+}
 
-	if(!ht) return NULL;
-	bkt = inthashtable_find_bucket(ht, key);
-	return inthashtable_find_item_in_bucket(ht, bkt, key);
+void de_inthashtable_destroy(deark *c, struct de_inthashtable *ht)
+{
+	if(!ht) return;
+	de_free(c, ht->items);
+	de_free(c, ht);
 }
 
 // If key does not exist, sets *pvalue to NULL and returns 0.
 int de_inthashtable_get_item(deark *c, struct de_inthashtable *ht, i64 key, void **pvalue)
 {
-	struct de_inthashtable_item *item;
+	i64 i;
 
-	item = inthashtable_find_item(ht, key);
-	if(item) {
-		*pvalue = item->value;
+	i = inthashtable_find_slot(ht, key);
+	if(i>=0) {
+		*pvalue = ht->items[i].value;
 		return 1;
 	}
 	*pvalue = NULL;
@@ -1713,64 +2231,87 @@ int de_inthashtable_get_item(deark *c, struct de_inthashtable *ht, i64 key, void
 
 int de_inthashtable_item_exists(deark *c, struct de_inthashtable *ht, i64 key)
 {
-	return (inthashtable_find_item(ht, key) != NULL);
-}
-
-// Unconditionally adds an item to the given bucket (does not prevent duplicates)
-static void inthashtable_add_item_to_bucket(struct de_inthashtable *ht,
-	struct de_inthashtable_bucket *bkt, struct de_inthashtable_item *new_item)
-{
-	new_item->next = bkt->first_item;
-	bkt->first_item = new_item;
+	return (inthashtable_find_slot(ht, key) >= 0);
 }
 
 // Returns 1 if the key has been newly-added,
 // or 0 if the key already existed.
 int de_inthashtable_add_item(deark *c, struct de_inthashtable *ht, i64 key, void *value)
 {
-	struct de_inthashtable_bucket *bkt;
-	struct de_inthashtable_item *new_item;
-
-	bkt = inthashtable_find_bucket(ht, key);
-	if(inthashtable_find_item_in_bucket(ht, bkt, key)) {
+	if(inthashtable_find_slot(ht, key) >= 0) {
 		// Item already exist. Don't add it again.
 		// TODO: This may eventually need to be changed to modify the existing item,
 		// or delete-then-add the new item, instead of doing nothing.
 		return 0;
 	}
 
-	new_item = de_malloc(c, sizeof(struct de_inthashtable_item));
-	new_item->key = key;
-	new_item->value = value;
-	inthashtable_add_item_to_bucket(ht, bkt, new_item);
+	de_inthashtable_reserve(c, ht, ht->num_items+1);
+	inthashtable_insert_noresize(ht, key, value);
 	return 1;
 }
 
+// Delete the item at index i. Items later in the same run are moved back as
+// needed, so that no lookup will stop early at the emptied slot.
+static void inthashtable_delete_slot(struct de_inthashtable *ht, i64 i)
+{
+	i64 mask = ht->capacity-1;
+	i64 j;
+
+	j = i;
+	while(1) {
+		i64 home;
+
+		j = (j+1) & mask;
+		if(!ht->items[j].in_use) break;
+		home = inthashtable_hash(ht, ht->items[j].key);
+		// If the item's home slot is cyclically in (i, j], it must stay put.
+		if(((j-home) & mask) < ((j-i) & mask)) continue;
+		ht->items[i] = ht->items[j];
+		i = j;
+	}
+
+	ht->items[i].in_use = 0;
+	ht->items[i].value = NULL;
+	ht->num_items--;
+}
+
+// If the key exists, removes it, sets *pvalue to its value, and returns 1.
+// Otherwise sets *pvalue to NULL and returns 0.
 int de_inthashtable_remove_item(deark *c, struct de_inthashtable *ht, i64 key, void **pvalue)
 {
-	// TODO
-	return 0;
+	i64 i;
+
+	i = inthashtable_find_slot(ht, key);
+	if(i<0) {
+		if(pvalue) *pvalue = NULL;
+		return 0;
+	}
+	if(pvalue) *pvalue = ht->items[i].value;
+	inthashtable_delete_slot(ht, i);
+	return 1;
 }
 
 // Select one item arbitrarily, return its key and value, and delete it from the
 // hashtable.
 int de_inthashtable_remove_any_item(deark *c, struct de_inthashtable *ht, i64 *pkey, void **pvalue)
 {
-	i64 i;
+	i64 k;
 
-	for(i=0; i<DE_INTHASHTABLE_NBUCKETS; i++) {
-		struct de_inthashtable_item *item;
+	// Resume where the previous call left off, so that emptying the table
+	// this way takes linear time.
+	for(k=0; ht->num_items>0 && k<ht->capacity; k++) {
+		i64 i;
 
-		item = ht->buckets[i].first_item;
-		if(!item) continue;
+		i = (ht->scan_pos + k) & (ht->capacity-1);
+		if(!ht->items[i].in_use) continue;
 
 		// Found an item. Copy it, for the caller.
-		if(pkey) *pkey = item->key;
-		if(pvalue) *pvalue = item->value;
+		if(pkey) *pkey = ht->items[i].key;
+		if(pvalue) *pvalue = ht->items[i].value;
 
 		// Delete our copy of it.
-		ht->buckets[i].first_item = item->next;
-		inthashtable_destroy_item(c, item);
+		inthashtable_delete_slot(ht, i);
+		ht->scan_pos = i;
 		return 1;
 	}
 
@@ -1788,47 +2329,74 @@ struct de_crcobj {
 	unsigned int crctype;
 	deark *c;
 	u16 *table16;
+	const u32 *table32; // Owned by the deark object, not by us
 };
 
 #define DE_CRC32_INIT 0
 
-// crc32_calc() is based on public domain code by Jon Mayo, downloaded
-// from <http://orangetide.com/code/crc.c>.
-// It includes minor changes for Deark. I disclaim any copyright on these
-// minor changes. -JS
-// Note: I have found several other seemingly-independent implementations
-// of the same algorithm, such as the one by Karl Malbrain, used in miniz.
-// I don't know its origin.
-static u32 crc32_calc(const u8 *ptr, size_t cnt, u32 crc)
-{
-	static const u32 crc32_tab[16] = {
-		0x00000000U, 0x1db71064U, 0x3b6e20c8U, 0x26d930acU,
-		0x76dc4190U, 0x6b6b51f4U, 0x4db26158U, 0x5005713cU,
-		0xedb88320U, 0xf00f9344U, 0xd6d6a3e8U, 0xcb61b38cU,
-		0x9b64c2b0U, 0x86d3d2d4U, 0xa00ae278U, 0xbdbdf21cU
-	};
-
-	if(cnt==0) return crc;
-	crc = ~crc;
-	while(cnt--) {
-		crc = (crc >> 4) ^ crc32_tab[(crc & 0xf) ^ (*ptr & 0xf)];
-		crc = (crc >> 4) ^ crc32_tab[(crc & 0xf) ^ (*ptr++ >> 4)];
+// CRC-32 uses the "slicing-by-8" method, which processes 8 bytes per
+// iteration, using 8 lookup tables of 256 entries each.
+// table32[0] is the usual byte-at-a-time table. table32[k] gives the effect
+// of a byte followed by k zero bytes.
+// The tables are built only once per deark object, and shared by all CRC-32
+// objects.
+static void de_crc32_init(struct de_crcobj *crco)
+{
+	deark *c = crco->c;
+	u32 i, k;
+	u32 *t;
+
+	if(c->crc32_table) {
+		crco->table32 = c->crc32_table;
+		return;
 	}
-	return ~crc;
-}
 
-// For a one-shot CRC calculations, or the first part of a multi-part
-// calculation.
-// buf can be NULL (in which case buf_len should be 0, but is ignored)
-static u32 de_crc32(const void *buf, i64 buf_len)
-{
-	if(!buf) return DE_CRC32_INIT;
-	return (u32)crc32_calc((const u8*)buf, (size_t)buf_len, DE_CRC32_INIT);
+	t = de_mallocarray(c, 8*256, sizeof(u32));
+	c->crc32_table = t;
+	crco->table32 = t;
+	for(i=0; i<256; i++) {
+		u32 v = i;
+
+		for(k=0; k<8; k++) {
+			v = (v & 1) ? ((v>>1) ^ 0xedb88320U) : (v>>1);
+		}
+		t[i] = v;
+	}
+	for(i=0; i<256; i++) {
+		for(k=1; k<8; k++) {
+			t[k*256+i] = (t[(k-1)*256+i] >> 8) ^ t[t[(k-1)*256+i] & 0xff];
+		}
+	}
 }
 
-static u32 de_crc32_continue(u32 prev_crc, const void *buf, i64 buf_len)
+static void de_crc32_continue(struct de_crcobj *crco, const u8 *ptr, i64 buf_len)
 {
-	return (u32)crc32_calc((const u8*)buf, (size_t)buf_len, prev_crc);
+	const u32 *t = crco->table32;
+	u32 crc;
+	size_t cnt = (size_t)buf_len;
+
+	if(!t) return;
+	crc = ~crco->val;
+
+	while(cnt>=8) {
+		u32 lo, hi;
+
+		lo = crc ^ ((u32)ptr[0] | ((u32)ptr[1]<<8) | ((u32)ptr[2]<<16) |
+			((u32)ptr[3]<<24));
+		hi = (u32)ptr[4] | ((u32)ptr[5]<<8) | ((u32)ptr[6]<<16) |
+			((u32)ptr[7]<<24);
+		crc = t[7*256 + (lo & 0xff)] ^ t[6*256 + ((lo>>8) & 0xff)] ^
+			t[5*256 + ((lo>>16) & 0xff)] ^ t[4*256 + (lo>>24)] ^
+			t[3*256 + (hi & 0xff)] ^ t[2*256 + ((hi>>8) & 0xff)] ^
+			t[1*256 + ((hi>>16) & 0xff)] ^ t[hi>>24];
+		ptr += 8;
+		cnt -= 8;
+	}
+
+	while(cnt--) {
+		crc = (crc >> 8) ^ t[(crc ^ *ptr++) & 0xff];
+	}
+	crco->val = ~crc;
 }
 
 // This is the CRC-16 algorithm used in MacBinary.
@@ -1898,6 +2466,9 @@ struct de_crcobj *de_crcobj_create(deark *c, unsigned int flags)
 	crco->crctype = flags;
 
 	switch(crco->crctype) {
+	case DE_CRCOBJ_CRC32_IEEE:
+		de_crc32_init(crco);
+		break;
 	case DE_CRCOBJ_CRC16_CCITT:
 		de_crc16ccitt_init(crco);
 		break;
@@ -1926,7 +2497,7 @@ void de_crcobj_reset(struct de_crcobj *crco)
 
 	switch(crco->crctype) {
 	case DE_CRCOBJ_CRC32_IEEE:
-		crco->val = de_crc32(NULL, 0);
+		crco->val = DE_CRC32_INIT;
 		break;
 	}
 }
@@ -1942,7 +2513,7 @@ void de_crcobj_addbuf(struct de_crcobj *crco, const u8 *buf, i64 buf_len)
 
 	switch(crco->crctype) {
 	case DE_CRCOBJ_CRC32_IEEE:
-		crco->val = de_crc32_continue(crco->val, buf, buf_len);
+		de_crc32_continue(crco, buf, buf_len);
 		break;
 	case DE_CRCOBJ_CRC16_CCITT:
 		de_crc16ccitt_continue(crco, buf, buf_len);
@@ -1955,11 +2526,14 @@ void de_crcobj_addbuf(struct de_crcobj *crco, const u8 *buf, i64 buf_len)
 
 void de_crcobj_addzeroes(struct de_crcobj *crco, i64 len)
 {
-	i64 i;
-	const u8 z = 0;
+	static const u8 z[256] = { 0 };
+	i64 nremaining = len;
+
+	while(nremaining>0) {
+		i64 n = de_min_int(nremaining, (i64)sizeof(z));
 
-	for(i=0; i<len; i++) {
-		de_crcobj_addbuf(crco, &z, 1);
+		de_crcobj_addbuf(crco, z, n);
+		nremaining -= n;
 	}
 }
 
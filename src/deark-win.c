@@ -12,6 +12,7 @@
 
 #include <windows.h>
 
+#include <io.h> // for _get_osfhandle
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -230,6 +231,36 @@ FILE* de_fopen_for_read(deark *c, const char *fn, i64 *len,
 	return f;
 }
 
+// Map an entire file (that was opened by de_fopen_for_read) into memory,
+// read-only.
+// Returns NULL on failure, in which case the caller should use normal file I/O.
+void *de_mmap_for_read(deark *c, FILE *fp, i64 len)
+{
+	HANDLE fh;
+	HANDLE mh;
+	void *m;
+
+	if(len<1) return NULL;
+	if((u64)len > (u64)(SIZE_T)(-1)) return NULL;
+
+	fh = (HANDLE)_get_osfhandle(_fileno(fp));
+	if(fh==INVALID_HANDLE_VALUE) return NULL;
+
+	mh = CreateFileMappingW(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!mh) return NULL;
+
+	m = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, (SIZE_T)len);
+	// The view keeps the mapping object alive, so we don't need this handle.
+	CloseHandle(mh);
+	return m;
+}
+
+void de_munmap(deark *c, void *m, i64 len)
+{
+	if(!m) return;
+	UnmapViewOfFile(m);
+}
+
 // flags: 0x1 = append instead of overwriting
 FILE* de_fopen_for_write(deark *c, const char *fn,
 	char *errmsg, size_t errmsg_len, int overwrite_mode,
@@ -487,6 +518,28 @@ void de_current_time_to_timestamp(struct de_timestamp *ts)
 	de_FILETIME_to_timestamp(ft, ts, 0x1);
 }
 
+// Used by -stats. Reports a monotonic "wall clock" time, and the CPU time
+// used by this process, both in microseconds.
+void de_get_perf_times(u64 *wall_us, u64 *cpu_us)
+{
+	LARGE_INTEGER count, freq;
+	FILETIME t_create, t_exit, t_kernel, t_user;
+
+	*wall_us = 0;
+	*cpu_us = 0;
+	if(QueryPerformanceFrequency(&freq) && QueryPerformanceCounter(&count) &&
+		freq.QuadPart>0)
+	{
+		*wall_us = (u64)(count.QuadPart / freq.QuadPart) * 1000000 +
+			(u64)(count.QuadPart % freq.QuadPart) * 1000000 / (u64)freq.QuadPart;
+	}
+	if(GetProcessTimes(GetCurrentProcess(), &t_create, &t_exit, &t_kernel, &t_user)) {
+		// FILETIME units are 100ns
+		*cpu_us = ((((u64)t_kernel.dwHighDateTime)<<32 | t_kernel.dwLowDateTime) +
+			(((u64)t_user.dwHighDateTime)<<32 | t_user.dwLowDateTime)) / 10;
+	}
+}
+
 void de_exitprocess(int s)
 {
 	exit(s);
@@ -24,6 +24,13 @@
 #define CODE_PK56 0x06054b50U
 #define CODE_PK66 0x06064b50U
 #define CODE_PK67 0x07064b50U
+#define CODE_PK78 0x08074b50U
+
+// Member files up to this size are compressed all at once, when they are
+// closed. Larger ones are compressed and written as the data arrives.
+#define ZIPW_MAX_BUFFERED_MEMBER_SIZE 65536
+// Amount of data to test-compress, to decide whether to bother compressing
+#define ZIPW_SAMPLE_SIZE 16384
 
 struct zipw_md {
 	struct de_timestamp modtime;
@@ -49,6 +56,42 @@ struct zipw_ctx {
 	dbuf *outf;
 	dbuf *cdir; // central directory
 	struct de_crcobj *crc32o;
+	struct zipw_member *streaming_member; // The member being written to outf, if any
+	struct zipw_member *deferred_head; // Completed members waiting to be written
+	struct zipw_member *deferred_tail;
+};
+
+// State of a member file that is currently open for writing.
+struct zipw_member {
+	struct zipw_ctx *zzz;
+	struct zipw_md *md;
+	char *name;
+	unsigned int level;
+	u8 streaming;
+	u8 failed;
+	u8 spill_to_mem; // Set if we couldn't create a temporary file
+	dbuf *buffered; // Used until the member switches to streaming mode
+	// If another member is being streamed when this one outgrows its buffer,
+	// the excess data goes to a temporary file.
+	FILE *spillfp;
+	// Fields used in streaming mode:
+	u8 stored; // Data is written uncompressed, instead of with Deflate
+	i64 ldir_offset;
+	i64 cmpr_start;
+	i64 uncmpr_len;
+	struct de_crcobj *crco;
+	struct fmtutil_tdefl_ctx *tdctx;
+	struct zipw_member *next; // Next in list of deferred members
+};
+
+struct zipw_hdrinfo {
+	unsigned int ver_needed;
+	unsigned int bit_flags;
+	unsigned int cmpr_method;
+	u32 crc;
+	i64 cmpr_len;
+	i64 uncmpr_len;
+	i64 ldir_offset;
 };
 
 static int is_valid_32bit_unix_time(i64 ut)
@@ -239,6 +282,13 @@ done:
 	return retval;
 }
 
+static struct fmtutil_tdefl_ctx *zipw_create_deflater(deark *c, dbuf *cmpr_data,
+	unsigned int level)
+{
+	return fmtutil_tdefl_create(c, cmpr_data,
+		fmtutil_tdefl_create_comp_flags_from_zip_params(level, -15, MZ_DEFAULT_STRATEGY));
+}
+
 static int zipw_deflate(deark *c, struct zipw_ctx *zzz, dbuf *uncmpr_data,
 	dbuf *cmpr_data, unsigned int level)
 {
@@ -246,8 +296,7 @@ static int zipw_deflate(deark *c, struct zipw_ctx *zzz, dbuf *uncmpr_data,
 	int ret;
 	struct fmtutil_tdefl_ctx *tdctx = NULL;
 
-	tdctx = fmtutil_tdefl_create(c, cmpr_data,
-		fmtutil_tdefl_create_comp_flags_from_zip_params(level, -15, MZ_DEFAULT_STRATEGY));
+	tdctx = zipw_create_deflater(c, cmpr_data, level);
 	ret = dbuf_buffered_read(uncmpr_data, 0, uncmpr_data->len, my_deflate_cbfn, (void*)tdctx);
 	if(!ret) goto done;
 	retval = 1;
@@ -257,19 +306,104 @@ done:
 	return retval;
 }
 
-static void zipw_add_memberfile(deark *c, struct zipw_ctx *zzz, struct zipw_md *md,
-	dbuf *f, const char *name, unsigned int level_and_flags)
+// Report whether the start of f doesn't seem to be compressible.
+static int zipw_looks_incompressible(deark *c, dbuf *f)
 {
-	i64 ldir_offset;
+	u8 *buf = NULL;
+	i64 sample_len;
+	int retval = 0;
+
+	sample_len = de_min_int(f->len, ZIPW_SAMPLE_SIZE);
+	if(sample_len < ZIPW_SAMPLE_SIZE/4) goto done;
+
+	buf = de_malloc(c, sample_len);
+	dbuf_read(f, buf, 0, sample_len);
+	retval = fmtutil_tdefl_looks_incompressible(c, buf, sample_len);
+
+done:
+	de_free(c, buf);
+	return retval;
+}
+
+static unsigned int zipw_level_to_bit_flags(unsigned int level)
+{
+	// This is the logic used by Info-Zip
+	if(level<=2) return 4;
+	if(level>=8) return 2;
+	return 0;
+}
+
+static void zipw_write_local_header(struct zipw_member *mb, const struct zipw_hdrinfo *hi,
+	dbuf *outf)
+{
+	struct zipw_md *md = mb->md;
 	i64 fnlen;
-	u32 crc;
+
+	dbuf_writeu32le(outf, CODE_PK34);
+	dbuf_writeu16le(outf, hi->ver_needed);
+	dbuf_writeu16le(outf, hi->bit_flags);
+	dbuf_writeu16le(outf, hi->cmpr_method);
+	dbuf_writeu16le(outf, md->modtime_dostime);
+	dbuf_writeu16le(outf, md->modtime_dosdate);
+	dbuf_writeu32le(outf, hi->crc);
+	dbuf_writeu32le(outf, hi->cmpr_len);
+	dbuf_writeu32le(outf, hi->uncmpr_len);
+	fnlen = de_strlen(mb->name);
+	dbuf_writeu16le(outf, fnlen);
+	dbuf_writeu16le(outf, md->eflocal->len);
+	dbuf_write(outf, (const u8*)mb->name, fnlen);
+	dbuf_copy(md->eflocal, 0, md->eflocal->len, outf);
+}
+
+static void zipw_write_central_header(struct zipw_member *mb, const struct zipw_hdrinfo *hi,
+	dbuf *cdir)
+{
+	struct zipw_md *md = mb->md;
+	i64 fnlen;
+	unsigned int ext_attributes;
+
+	dbuf_writeu32le(cdir, CODE_PK12);
+	dbuf_writeu16le(cdir, ZIPENC_VER_MADE_BY);
+	dbuf_writeu16le(cdir, hi->ver_needed);
+	dbuf_writeu16le(cdir, hi->bit_flags);
+	dbuf_writeu16le(cdir, hi->cmpr_method);
+	dbuf_writeu16le(cdir, md->modtime_dostime);
+	dbuf_writeu16le(cdir, md->modtime_dosdate);
+	dbuf_writeu32le(cdir, hi->crc);
+	dbuf_writeu32le(cdir, hi->cmpr_len);
+	dbuf_writeu32le(cdir, hi->uncmpr_len);
+	fnlen = de_strlen(mb->name);
+	dbuf_writeu16le(cdir, fnlen);
+	dbuf_writeu16le(cdir, md->efcentral->len); // eflen
+	dbuf_writeu16le(cdir, 0); // file comment len
+	dbuf_writeu16le(cdir, 0); // disk number start
+	dbuf_writeu16le(cdir, 0); // int attrib
+
+	// Set the Unix (etc.) file attributes to "-rw-r--r--" or
+	// "-rwxr-xr-x", etc.
+	if(md->is_directory)
+		ext_attributes = (0040755U << 16) | 0x10;
+	else if(md->is_executable)
+		ext_attributes = (0100755U << 16);
+	else
+		ext_attributes = (0100644U << 16);
+
+	dbuf_writeu32le(cdir, (i64)ext_attributes); // ext attrib
+	dbuf_writeu32le(cdir, hi->ldir_offset);
+	dbuf_write(cdir, (const u8*)mb->name, fnlen);
+	dbuf_copy(md->efcentral, 0, md->efcentral->len, cdir);
+}
+
+// Write a member file whose contents are all in mb->buffered.
+static void zipw_add_buffered_member(deark *c, struct zipw_ctx *zzz, struct zipw_member *mb)
+{
+	dbuf *f = mb->buffered;
 	int try_compression = 0;
 	int using_compression = 0;
 	dbuf *cmpr_data = NULL;
-	i64 cmpr_len;
-	unsigned int bit_flags = 0;
-	unsigned int ext_attributes;
-	unsigned int ver_needed;
+	struct zipw_hdrinfo hi;
+
+	de_zeromem(&hi, sizeof(struct zipw_hdrinfo));
 
 	// Just a sanity check; we'll run into some other limit long before this
 	if(zzz->membercount >= 0x7fffffff) {
@@ -279,41 +413,34 @@ static void zipw_add_memberfile(deark *c, struct zipw_ctx *zzz, struct zipw_md *
 
 	de_crcobj_reset(zzz->crc32o);
 	de_crcobj_addslice(zzz->crc32o, f, 0, f->len);
-	crc = de_crcobj_getval(zzz->crc32o);
+	hi.crc = de_crcobj_getval(zzz->crc32o);
 
-	ldir_offset = zzz->outf->len;
-	if(ldir_offset > 0xffffffffLL) {
+	hi.ldir_offset = zzz->outf->len;
+	if(hi.ldir_offset > 0xffffffffLL) {
 		de_err(c, "Maximum ZIP file size exceeded");
 		goto done;
 	}
-	if(f->len > 0xffffffffLL) {
-		de_err(c, "Maximum ZIP member file size exceeded");
-		goto done;
-	}
-	cmpr_len = f->len; // default
+	hi.uncmpr_len = f->len;
+	hi.cmpr_len = f->len; // default
 
-	if(f->len>5 && !md->is_directory) {
+	if(f->len>5 && !mb->md->is_directory && mb->level>0) {
 		try_compression = 1;
 	}
 
-	if(try_compression) {
-		unsigned int level;
+	if(try_compression && zipw_looks_incompressible(c, f)) {
+		de_dbg2(c, "not compressing %s: appears to be incompressible", mb->name);
+		try_compression = 0;
+	}
 
+	if(try_compression) {
 		cmpr_data = dbuf_create_membuf(c, 0, 0);
 
-		if ((int)level_and_flags < 0)
-			level_and_flags = MZ_DEFAULT_LEVEL;
-		level = level_and_flags & 0xF;
-
-		zipw_deflate(c, zzz, f, cmpr_data, level);
+		zipw_deflate(c, zzz, f, cmpr_data, mb->level);
 
 		if(cmpr_data->len < f->len) {
 			using_compression = 1;
-			cmpr_len = cmpr_data->len;
-
-			// This is the logic used by Info-Zip
-			if(level<=2) bit_flags |= 4;
-			else if(level>=8) bit_flags |= 2;
+			hi.cmpr_len = cmpr_data->len;
+			hi.bit_flags |= zipw_level_to_bit_flags(mb->level);
 		}
 		else { // No savings - Discard compressed data
 			dbuf_close(cmpr_data);
@@ -321,104 +448,308 @@ static void zipw_add_memberfile(deark *c, struct zipw_ctx *zzz, struct zipw_md *
 		}
 	}
 
-	bit_flags |= 0x0800; // Use UTF-8 filenames
+	hi.bit_flags |= 0x0800; // Use UTF-8 filenames
+	hi.cmpr_method = using_compression ? 8 : 0;
 
-	dbuf_writeu32le(zzz->cdir, CODE_PK12);
-	dbuf_writeu32le(zzz->outf, CODE_PK34);
-	dbuf_writeu16le(zzz->cdir, ZIPENC_VER_MADE_BY);
+	if(using_compression) hi.ver_needed = 20;
+	else if(mb->md->is_directory) hi.ver_needed = 20;
+	else hi.ver_needed = 10;
 
-	if(using_compression) ver_needed = 20;
-	else if(md->is_directory) ver_needed = 20;
-	else ver_needed = 10;
+	zipw_write_local_header(mb, &hi, zzz->outf);
+	zipw_write_central_header(mb, &hi, zzz->cdir);
 
-	dbuf_writeu16le(zzz->cdir, ver_needed);
-	dbuf_writeu16le(zzz->outf, ver_needed);
+	if(using_compression) {
+		if(cmpr_data) {
+			dbuf_copy(cmpr_data, 0, cmpr_data->len, zzz->outf);
+		}
+	}
+	else {
+		dbuf_copy(f, 0, f->len, zzz->outf);
+	}
 
-	dbuf_writeu16le(zzz->cdir, bit_flags);
-	dbuf_writeu16le(zzz->outf, bit_flags);
+	zzz->membercount++;
 
-	dbuf_writeu16le(zzz->cdir, using_compression?8:0); // cmpr method
-	dbuf_writeu16le(zzz->outf, using_compression?8:0);
+done:
+	if(cmpr_data) dbuf_close(cmpr_data);
+}
 
-	dbuf_writeu16le(zzz->cdir, md->modtime_dostime);
-	dbuf_writeu16le(zzz->outf, md->modtime_dostime);
-	dbuf_writeu16le(zzz->cdir, md->modtime_dosdate);
-	dbuf_writeu16le(zzz->outf, md->modtime_dosdate);
+static void zipw_stream_data(struct zipw_member *mb, const u8 *buf, i64 buf_len)
+{
+	enum fmtutil_tdefl_status ret;
 
-	dbuf_writeu32le(zzz->cdir, crc); // crc
-	dbuf_writeu32le(zzz->outf, crc);
+	if(mb->failed) return;
+	mb->uncmpr_len += buf_len;
+	if(mb->uncmpr_len > 0xffffffffLL) {
+		// We don't write Zip64 extended information for member files, so
+		// give up on this one. Its partial data stays in the archive, but
+		// the central directory won't refer to it.
+		de_err(mb->zzz->c, "%s: Maximum ZIP member file size exceeded", mb->name);
+		mb->failed = 1;
+		return;
+	}
+	de_crcobj_addbuf(mb->crco, buf, buf_len);
+	if(mb->stored) {
+		dbuf_write(mb->zzz->outf, buf, buf_len);
+		return;
+	}
+	ret = fmtutil_tdefl_compress_buffer(mb->tdctx, buf, (size_t)buf_len,
+		FMTUTIL_TDEFL_NO_FLUSH);
+	if(ret != FMTUTIL_TDEFL_STATUS_OKAY) {
+		de_err(mb->zzz->c, "Deflate compression error");
+		mb->failed = 1;
+	}
+}
 
-	dbuf_writeu32le(zzz->cdir, cmpr_len); // cmpr size
-	dbuf_writeu32le(zzz->outf, cmpr_len);
-	dbuf_writeu32le(zzz->cdir, f->len); // uncmpr size
-	dbuf_writeu32le(zzz->outf, f->len);
+static int zipw_stream_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
+	i64 buf_len)
+{
+	struct zipw_member *mb = (struct zipw_member*)brctx->userdata;
 
-	fnlen = de_strlen(name);
-	dbuf_writeu16le(zzz->cdir, fnlen);
-	dbuf_writeu16le(zzz->outf, fnlen);
+	zipw_stream_data(mb, buf, buf_len);
+	return !mb->failed;
+}
 
-	dbuf_writeu16le(zzz->cdir, md->efcentral->len); // eflen
-	dbuf_writeu16le(zzz->outf, md->eflocal->len);
+static void zipw_spill_data(deark *c, struct zipw_member *mb, const u8 *buf, i64 buf_len)
+{
+	if(!mb->spillfp && !mb->spill_to_mem) {
+		mb->spillfp = tmpfile();
+		if(mb->spillfp) {
+			de_dbg2(c, "buffering %s in a temporary file", mb->name);
+		}
+		else {
+			de_warn(c, "Failed to create temporary file; buffering %s in memory",
+				mb->name);
+			mb->spill_to_mem = 1;
+		}
+	}
 
-	dbuf_writeu16le(zzz->cdir, 0); // file comment len
-	dbuf_writeu16le(zzz->cdir, 0); // disk number start
+	if(!mb->spillfp) {
+		dbuf_write(mb->buffered, buf, buf_len);
+		return;
+	}
 
-	dbuf_writeu16le(zzz->cdir, 0); // int attrib
+	if(fwrite(buf, 1, (size_t)buf_len, mb->spillfp) != (size_t)buf_len) {
+		de_err(c, "Failed to write temporary file");
+		mb->failed = 1;
+	}
+}
 
-	// Set the Unix (etc.) file attributes to "-rw-r--r--" or
-	// "-rwxr-xr-x", etc.
-	if(md->is_directory)
-		ext_attributes = (0040755U << 16) | 0x10;
-	else if(md->is_executable)
-		ext_attributes = (0100755U << 16);
-	else
-		ext_attributes = (0100644U << 16);
+// Send the contents of the member's temporary file to the archive, then
+// get rid of the file.
+static void zipw_stream_spilled_data(deark *c, struct zipw_member *mb)
+{
+	u8 *buf;
+	size_t n;
+
+	buf = de_malloc(c, 65536);
+	rewind(mb->spillfp);
+	while(!mb->failed) {
+		n = fread(buf, 1, 65536, mb->spillfp);
+		if(n==0) break;
+		zipw_stream_data(mb, buf, (i64)n);
+	}
+	if(!mb->failed && ferror(mb->spillfp)) {
+		de_err(c, "Failed to read temporary file");
+		mb->failed = 1;
+	}
+	de_free(c, buf);
+	fclose(mb->spillfp);
+	mb->spillfp = NULL;
+}
 
-	dbuf_writeu32le(zzz->cdir, (i64)ext_attributes); // ext attrib
+static void zipw_set_streaming_hdrinfo(struct zipw_member *mb, struct zipw_hdrinfo *hi)
+{
+	hi->bit_flags = 0x0800 | 0x0008; // UTF-8 filenames, data descriptor
+	if(mb->stored) {
+		hi->ver_needed = 10;
+		hi->cmpr_method = 0;
+	}
+	else {
+		hi->ver_needed = 20;
+		hi->cmpr_method = 8;
+		hi->bit_flags |= zipw_level_to_bit_flags(mb->level);
+	}
+}
 
-	dbuf_writeu32le(zzz->cdir, ldir_offset);
+// Switch a member file from buffered mode to streaming mode: Write a local
+// header that defers the CRC and sizes to a data descriptor, and compress
+// whatever has been buffered so far.
+static void zipw_start_streaming(deark *c, struct zipw_ctx *zzz, struct zipw_member *mb)
+{
+	struct zipw_hdrinfo hi;
 
-	dbuf_write(zzz->cdir, (const u8*)name, fnlen);
-	dbuf_write(zzz->outf, (const u8*)name, fnlen);
+	de_zeromem(&hi, sizeof(struct zipw_hdrinfo));
+	mb->ldir_offset = zzz->outf->len;
+	if(zzz->membercount >= 0x7fffffff) {
+		de_err(c, "Maximum number of ZIP member files exceeded");
+		mb->failed = 1;
+		goto done;
+	}
+	if(mb->ldir_offset > 0xffffffffLL) {
+		de_err(c, "Maximum ZIP file size exceeded");
+		mb->failed = 1;
+		goto done;
+	}
 
-	dbuf_copy(md->efcentral, 0, md->efcentral->len, zzz->cdir);
-	dbuf_copy(md->eflocal, 0, md->eflocal->len, zzz->outf);
+	mb->streaming = 1;
+	zzz->streaming_member = mb;
 
-	if(using_compression) {
-		if(cmpr_data) {
-			dbuf_copy(cmpr_data, 0, cmpr_data->len, zzz->outf);
+	// In streaming mode, we have to decide on the compression method before
+	// seeing all the data. If the first part doesn't seem to be compressible,
+	// store the whole file.
+	if(mb->level==0) {
+		mb->stored = 1;
+	}
+	else if(zipw_looks_incompressible(c, mb->buffered)) {
+		de_dbg2(c, "not compressing %s: appears to be incompressible", mb->name);
+		mb->stored = 1;
+	}
+
+	zipw_set_streaming_hdrinfo(mb, &hi);
+	zipw_write_local_header(mb, &hi, zzz->outf);
+
+	mb->cmpr_start = zzz->outf->len;
+	mb->crco = de_crcobj_create(c, DE_CRCOBJ_CRC32_IEEE);
+	if(!mb->stored) {
+		mb->tdctx = zipw_create_deflater(c, zzz->outf, mb->level);
+	}
+
+	dbuf_buffered_read(mb->buffered, 0, mb->buffered->len, zipw_stream_cbfn, (void*)mb);
+	if(mb->spillfp) {
+		zipw_stream_spilled_data(c, mb);
+	}
+
+done:
+	dbuf_close(mb->buffered);
+	mb->buffered = NULL;
+}
+
+static void zipw_finish_streaming(deark *c, struct zipw_ctx *zzz, struct zipw_member *mb)
+{
+	struct zipw_hdrinfo hi;
+
+	de_zeromem(&hi, sizeof(struct zipw_hdrinfo));
+	if(mb->tdctx) {
+		if(fmtutil_tdefl_compress_buffer(mb->tdctx, NULL, 0, FMTUTIL_TDEFL_FINISH) !=
+			FMTUTIL_TDEFL_STATUS_DONE)
+		{
+			de_err(c, "Deflate compression error");
+			return;
 		}
 	}
-	else {
-		dbuf_copy(f, 0, f->len, zzz->outf);
+
+	zipw_set_streaming_hdrinfo(mb, &hi);
+	hi.crc = de_crcobj_getval(mb->crco);
+	hi.cmpr_len = zzz->outf->len - mb->cmpr_start;
+	hi.uncmpr_len = mb->uncmpr_len;
+	hi.ldir_offset = mb->ldir_offset;
+	if(hi.cmpr_len > 0xffffffffLL) {
+		// The sizes wouldn't fit in the data descriptor or central directory.
+		// Leave the member out, rather than write a corrupt archive.
+		de_err(c, "%s: Maximum ZIP member file size exceeded", mb->name);
+		return;
 	}
 
+	// Data descriptor
+	dbuf_writeu32le(zzz->outf, CODE_PK78);
+	dbuf_writeu32le(zzz->outf, hi.crc);
+	dbuf_writeu32le(zzz->outf, hi.cmpr_len);
+	dbuf_writeu32le(zzz->outf, hi.uncmpr_len);
+
+	zipw_write_central_header(mb, &hi, zzz->cdir);
 	zzz->membercount++;
+}
 
-done:
-	if(cmpr_data) dbuf_close(cmpr_data);
+static void zipw_destroy_member(deark *c, struct zipw_member *mb)
+{
+	if(!mb) return;
+	if(mb->md) {
+		dbuf_close(mb->md->eflocal);
+		dbuf_close(mb->md->efcentral);
+		de_free(c, mb->md);
+	}
+	dbuf_close(mb->buffered);
+	if(mb->spillfp) fclose(mb->spillfp);
+	fmtutil_tdefl_destroy(mb->tdctx);
+	de_crcobj_destroy(mb->crco);
+	de_free(c, mb->name);
+	de_free(c, mb);
 }
 
-void de_zip_add_file_to_archive(deark *c, dbuf *f)
+// Write a completed member file that is not being streamed.
+static void zipw_add_member(deark *c, struct zipw_ctx *zzz, struct zipw_member *mb)
 {
-	struct zipw_ctx *zzz;
-	struct zipw_md *md = NULL;
-	int write_ntfs_times = 0;
-	int write_UT_time = 0;
+	if(mb->spillfp) {
+		// Too big to compress all at once
+		zipw_start_streaming(c, zzz, mb);
+		if(!mb->failed) {
+			zipw_finish_streaming(c, zzz, mb);
+		}
+		zzz->streaming_member = NULL;
+	}
+	else {
+		zipw_add_buffered_member(c, zzz, mb);
+	}
+}
 
-	md = de_malloc(c, sizeof(struct zipw_md));
+// Write out member files that were completed while another member was
+// being streamed.
+static void zipw_flush_deferred_members(deark *c, struct zipw_ctx *zzz)
+{
+	struct zipw_member *mb;
 
-	if(!c->zip_data) {
-		// ZIP file hasn't been created yet
-		if(!de_zip_create_file(c)) {
-			de_fatalerror(c);
-			goto done;
+	while(zzz->deferred_head) {
+		mb = zzz->deferred_head;
+		zzz->deferred_head = mb->next;
+		zipw_add_member(c, zzz, mb);
+		zipw_destroy_member(c, mb);
+	}
+	zzz->deferred_tail = NULL;
+}
+
+static void zipw_member_write_cb(dbuf *f, void *userdata, const u8 *buf, i64 buf_len)
+{
+	struct zipw_member *mb = (struct zipw_member*)userdata;
+	struct zipw_ctx *zzz = mb->zzz;
+	i64 amt_to_buffer;
+
+	if(mb->failed) return;
+
+	if(!mb->streaming) {
+		if(mb->buffered->len + buf_len <= ZIPW_MAX_BUFFERED_MEMBER_SIZE ||
+			mb->md->is_directory || (mb->spill_to_mem && zzz->streaming_member))
+		{
+			dbuf_write(mb->buffered, buf, buf_len);
+			return;
+		}
+
+		// Fill the buffer first, so that there's a good sample of the data
+		// to look at.
+		amt_to_buffer = ZIPW_MAX_BUFFERED_MEMBER_SIZE - mb->buffered->len;
+		if(amt_to_buffer>0) {
+			dbuf_write(mb->buffered, buf, amt_to_buffer);
+			buf += amt_to_buffer;
+			buf_len -= amt_to_buffer;
 		}
+
+		if(zzz->streaming_member) {
+			// Some other member is being written to the archive right now,
+			// so this one has to wait.
+			zipw_spill_data(f->c, mb, buf, buf_len);
+			return;
+		}
+
+		zipw_start_streaming(f->c, zzz, mb);
+		if(mb->failed) return;
 	}
 
-	zzz = (struct zipw_ctx*)c->zip_data;
+	zipw_stream_data(mb, buf, buf_len);
+}
 
-	de_dbg(c, "adding to zip: name=%s len=%"I64_FMT, f->name, f->len);
+static void zipw_prepare_md(deark *c, dbuf *f, struct zipw_md *md)
+{
+	int write_ntfs_times = 0;
+	int write_UT_time = 0;
 
 	if(f->fi_copy && f->fi_copy->is_directory) {
 		md->is_directory = 1;
@@ -502,30 +833,90 @@ void de_zip_add_file_to_archive(deark *c, dbuf *f)
 		do_ntfs_times(c, md, md->eflocal, 0);
 		do_ntfs_times(c, md, md->efcentral, 1);
 	}
+}
+
+// Called when a managed output file that goes in the ZIP archive is created.
+// The file's data is buffered in memory until it gets large, after which it
+// is compressed and written to the archive as it arrives.
+void de_zip_start_member_file(deark *c, dbuf *f)
+{
+	struct zipw_ctx *zzz;
+	struct zipw_member *mb = NULL;
+
+	if(!c->zip_data) {
+		// ZIP file hasn't been created yet
+		if(!de_zip_create_file(c)) {
+			de_fatalerror(c);
+			return;
+		}
+	}
+
+	zzz = (struct zipw_ctx*)c->zip_data;
 
-	if(md->is_directory) {
+	mb = de_malloc(c, sizeof(struct zipw_member));
+	mb->zzz = zzz;
+	mb->md = de_malloc(c, sizeof(struct zipw_md));
+	zipw_prepare_md(c, f, mb->md);
+
+	if(mb->md->is_directory) {
 		size_t nlen;
-		char *name2;
 
 		// Append a "/" to the name
 		nlen = de_strlen(f->name);
-		name2 = de_malloc(c, (i64)nlen+2);
-		de_snprintf(name2, nlen+2, "%s/", f->name);
+		mb->name = de_malloc(c, (i64)nlen+2);
+		de_snprintf(mb->name, nlen+2, "%s/", f->name);
+		mb->level = MZ_NO_COMPRESSION;
+		// A directory entry is not expected to have any data associated
+		// with it (besides the files it contains).
+		mb->buffered = dbuf_create_membuf(c, 16, 0);
+	}
+	else {
+		mb->name = de_strdup(c, f->name);
+		mb->level = zzz->cmprlevel;
+		mb->buffered = dbuf_create_membuf(c, 0, 0);
+	}
+
+	f->userdata_for_customwrite = (void*)mb;
+	f->customwrite_fn = zipw_member_write_cb;
+}
+
+void de_zip_end_member_file(deark *c, dbuf *f)
+{
+	struct zipw_member *mb = (struct zipw_member*)f->userdata_for_customwrite;
+	struct zipw_ctx *zzz;
 
-		zipw_add_memberfile(c, zzz, md, f, name2, MZ_NO_COMPRESSION);
+	if(!mb) return;
+	zzz = mb->zzz;
+	f->userdata_for_customwrite = NULL;
 
-		de_free(c, name2);
+	de_dbg(c, "adding to zip: name=%s len=%"I64_FMT, f->name, f->len);
+
+	if(mb->streaming) {
+		if(!mb->failed) {
+			zipw_finish_streaming(c, zzz, mb);
+		}
+		zzz->streaming_member = NULL;
+		zipw_flush_deferred_members(c, zzz);
+	}
+	else if(mb->failed) {
+		;
+	}
+	else if(zzz->streaming_member) {
+		// Some other member is being written right now. Write this one later.
+		if(zzz->deferred_tail) {
+			zzz->deferred_tail->next = mb;
+		}
+		else {
+			zzz->deferred_head = mb;
+		}
+		zzz->deferred_tail = mb;
+		mb = NULL;
 	}
 	else {
-		zipw_add_memberfile(c, zzz, md, f, f->name, zzz->cmprlevel);
+		zipw_add_member(c, zzz, mb);
 	}
 
-done:
-	if(md) {
-		dbuf_close(md->eflocal);
-		dbuf_close(md->efcentral);
-		de_free(c, md);
-	}
+	zipw_destroy_member(c, mb);
 }
 
 static int copy_to_FILE_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
@@ -640,6 +1031,9 @@ void de_zip_close_file(deark *c)
 
 	zzz = (struct zipw_ctx*)c->zip_data;
 
+	if(!zzz->streaming_member) {
+		zipw_flush_deferred_members(c, zzz);
+	}
 	zipw_finalize(c, zzz);
 
 	if(c->archive_to_stdout && zzz->outf && zzz->outf->btype==DBUF_TYPE_MEMBUF) {
@@ -649,6 +1043,11 @@ void de_zip_close_file(deark *c)
 	dbuf_close(zzz->cdir);
 	dbuf_close(zzz->outf);
 	de_crcobj_destroy(zzz->crc32o);
+	while(zzz->deferred_head) {
+		struct zipw_member *mb = zzz->deferred_head;
+		zzz->deferred_head = mb->next;
+		zipw_destroy_member(c, mb);
+	}
 
 	de_free(c, zzz);
 	c->zip_data = NULL;
@@ -117,6 +117,9 @@ void de_snprintf(char *buf, size_t buflen, const char *fmt, ...)
 #define DE_MSGTYPE_ERROR   2U
 #define DE_MSGTYPE_DEBUG   3U
 // The low bits of 'flags' are the message type.
+// DE_MSGFLAG_STATS may be combined with DE_MSGTYPE_MESSAGE, to identify the
+// JSON-formatted report requested by de_set_stats().
+#define DE_MSGFLAG_STATS   0x100U
 typedef void (*de_msgfn_type)(deark *c, unsigned int flags, const char *s);
 
 #define DE_MSGCODE_HL      0x1000U
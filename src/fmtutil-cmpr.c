@@ -85,7 +85,9 @@ struct de_dfilter_ctx *de_dfilter_create(deark *c,
 	dfctx->dcmpro = dcmpro;
 
 	if(codec_init_fn) {
+		de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 		codec_init_fn(dfctx, codec_private_params);
+		de_stats_end(c, DE_STATS_PHASE_DCMPR);
 	}
 	// TODO: How should we handle failure to initialize a codec?
 
@@ -96,14 +98,18 @@ void de_dfilter_addbuf(struct de_dfilter_ctx *dfctx,
 	const u8 *buf, i64 buf_len)
 {
 	if(dfctx->codec_addbuf_fn && (buf_len>0)) {
+		de_stats_begin(dfctx->c, DE_STATS_PHASE_DCMPR);
 		dfctx->codec_addbuf_fn(dfctx, buf, buf_len);
+		de_stats_end(dfctx->c, DE_STATS_PHASE_DCMPR);
 	}
 }
 
 void de_dfilter_finish(struct de_dfilter_ctx *dfctx)
 {
 	if(dfctx->codec_finish_fn) {
+		de_stats_begin(dfctx->c, DE_STATS_PHASE_DCMPR);
 		dfctx->codec_finish_fn(dfctx);
+		de_stats_end(dfctx->c, DE_STATS_PHASE_DCMPR);
 	}
 }
 
@@ -138,12 +144,16 @@ void de_dfilter_decompress_oneshot(deark *c,
 {
 	struct de_dfilter_ctx *dfctx = NULL;
 
+	// Timing the whole thing, not just the codec calls, means that the time
+	// spent reading the compressed data is also counted.
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	dfctx = de_dfilter_create(c, codec_init_fn, codec_private_params,
 		dcmpro, dres);
 	dbuf_buffered_read(dcmpri->f, dcmpri->pos, dcmpri->len,
 		my_dfilter_oneshot_buffered_read_cbfn, (void*)dfctx);
 	de_dfilter_finish(dfctx);
 	de_dfilter_destroy(dfctx);
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
 
 // Trivial "decompression" of uncompressed data.
@@ -153,6 +163,7 @@ void fmtutil_decompress_uncompressed(deark *c, struct de_dfilter_in_params *dcmp
 	i64 len;
 	i64 nbytes_avail;
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	nbytes_avail = de_min_int(dcmpri->len, dcmpri->f->len - dcmpri->pos);
 
 	if(dcmpro->len_known) {
@@ -168,27 +179,132 @@ void fmtutil_decompress_uncompressed(deark *c, struct de_dfilter_in_params *dcmp
 	dbuf_copy(dcmpri->f, dcmpri->pos, len, dcmpro->f);
 	dres->bytes_consumed = len;
 	dres->bytes_consumed_valid = 1;
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
 
-void fmtutil_decompress_packbits_ex(deark *c, struct de_dfilter_in_params *dcmpri,
-	struct de_dfilter_out_params *dcmpro, struct de_dfilter_results *dres)
+// The PackBits engine. Decodes from src (src_len bytes) to dst, and returns
+// the number of bytes written to dst. *psrc_used is set to the number of
+// bytes consumed.
+// nbytes_per_unit is 1 for standard PackBits, 2 for PackBits16.
+// It stops at the first code that is not entirely contained in src, or when
+// dst_stop bytes have been written. The last code may write past dst_stop,
+// but never past dst_cap; if it doesn't fit, its output is truncated.
+static i64 packbits_decode_span(const u8 *src, i64 src_len, u8 *dst,
+	i64 dst_stop, i64 dst_cap, UI nbytes_per_unit, i64 *psrc_used)
 {
-	i64 pos;
-	u8 b, b2;
+	i64 srcpos = 0;
+	i64 dstpos = 0;
+
+	while(dstpos<dst_stop && srcpos<src_len) {
+		u8 b = src[srcpos];
+		i64 nbytes;
+
+		if(b>128) { // A compressed run
+			if(srcpos+1+(i64)nbytes_per_unit > src_len) break;
+			nbytes = (257 - (i64)b) * (i64)nbytes_per_unit;
+			if(nbytes > dst_cap-dstpos) nbytes = dst_cap-dstpos;
+			if(nbytes_per_unit==1) {
+				de_memset(&dst[dstpos], src[srcpos+1], (size_t)nbytes);
+			}
+			else {
+				i64 k;
+
+				for(k=0; k<nbytes; k++) {
+					dst[dstpos+k] = src[srcpos+1+(k&1)];
+				}
+			}
+			srcpos += 1+(i64)nbytes_per_unit;
+			dstpos += nbytes;
+		}
+		else if(b<128) { // An uncompressed run
+			i64 nbytes_in;
+
+			nbytes_in = (1 + (i64)b) * (i64)nbytes_per_unit;
+			if(srcpos+1+nbytes_in > src_len) break;
+			nbytes = nbytes_in;
+			if(nbytes > dst_cap-dstpos) nbytes = dst_cap-dstpos;
+			de_memcpy(&dst[dstpos], &src[srcpos+1], (size_t)nbytes);
+			srcpos += 1+nbytes_in;
+			dstpos += nbytes;
+		}
+		else { // b==128. No-op.
+			// TODO: Some (but not most) ILBM specs say that code 128 is used to
+			// mark the end of compressed data, so maybe there should be options to
+			// tell us what to do when code 128 is encountered.
+			srcpos++;
+		}
+	}
+
+	*psrc_used = srcpos;
+	return dstpos;
+}
+
+#define PACKBITS_INBUF_SIZE 4096
+#define PACKBITS_OUTBUF_SIZE 4096
+// Enough extra room for the output of one code.
+#define PACKBITS_OUTBUF_SLACK 256
+
+// Decompress one code, the slow way. Used for codes that are not entirely
+// contained in the file, or in the compressed data segment.
+static void packbits_decode_one_code_slow(dbuf *f, i64 *ppos, dbuf *unc_pixels,
+	UI nbytes_per_unit)
+{
+	u8 b, b1, b2;
 	i64 count;
+	i64 k;
+
+	b = dbuf_getbyte_p(f, ppos);
+	if(b>128) { // A compressed run
+		count = 257 - (i64)b;
+		if(nbytes_per_unit==1) {
+			b1 = dbuf_getbyte_p(f, ppos);
+			dbuf_write_run(unc_pixels, b1, count);
+		}
+		else {
+			b1 = dbuf_getbyte_p(f, ppos);
+			b2 = dbuf_getbyte_p(f, ppos);
+			for(k=0; k<count; k++) {
+				dbuf_writebyte(unc_pixels, b1);
+				dbuf_writebyte(unc_pixels, b2);
+			}
+		}
+	}
+	else if(b<128) { // An uncompressed run
+		count = (1 + (i64)b) * (i64)nbytes_per_unit;
+		dbuf_copy(f, *ppos, count, unc_pixels);
+		*ppos += count;
+	}
+}
+
+static void decompress_packbits_internal(deark *c, struct de_dfilter_in_params *dcmpri,
+	struct de_dfilter_out_params *dcmpro, struct de_dfilter_results *dres,
+	UI nbytes_per_unit)
+{
+	i64 pos;
 	i64 endpos;
+	i64 fast_endpos;
 	i64 outf_len_limit = 0;
 	dbuf *f = dcmpri->f;
 	dbuf *unc_pixels = dcmpro->f;
+	u8 inbuf[PACKBITS_INBUF_SIZE];
+	u8 outbuf[PACKBITS_OUTBUF_SIZE+PACKBITS_OUTBUF_SLACK];
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	pos = dcmpri->pos;
 	endpos = dcmpri->pos + dcmpri->len;
+	fast_endpos = de_min_int(endpos, f->len);
 
 	if(dcmpro->len_known) {
 		outf_len_limit = unc_pixels->len + dcmpro->expected_len;
 	}
 
 	while(1) {
+		i64 dst_stop;
+		i64 src_len;
+		i64 src_used = 0;
+		i64 nbytes_out;
+		const u8 *src;
+
 		if(dcmpro->len_known && unc_pixels->len >= outf_len_limit) {
 			break; // Decompressed the requested amount of dst data.
 		}
@@ -196,26 +312,37 @@ void fmtutil_decompress_packbits_ex(deark *c, struct de_dfilter_in_params *dcmpr
 		if(pos>=endpos) {
 			break; // Reached the end of source data
 		}
-		b = dbuf_getbyte(f, pos++);
 
-		if(b>128) { // A compressed run
-			count = 257 - (i64)b;
-			b2 = dbuf_getbyte(f, pos++);
-			dbuf_write_run(unc_pixels, b2, count);
+		// Decode as many whole codes as we can from a span of the input.
+		src_len = de_min_int(fast_endpos-pos, PACKBITS_INBUF_SIZE);
+		if(src_len>0) {
+			dst_stop = PACKBITS_OUTBUF_SIZE;
+			if(dcmpro->len_known && outf_len_limit-unc_pixels->len < dst_stop) {
+				dst_stop = outf_len_limit-unc_pixels->len;
+			}
+
+			src = dbuf_borrow(f, pos, src_len, inbuf);
+			nbytes_out = packbits_decode_span(src, src_len, outbuf, dst_stop,
+				(i64)sizeof(outbuf), nbytes_per_unit, &src_used);
+			dbuf_write(unc_pixels, outbuf, nbytes_out);
+			pos += src_used;
 		}
-		else if(b<128) { // An uncompressed run
-			count = 1 + (i64)b;
-			dbuf_copy(f, pos, count, unc_pixels);
-			pos += count;
+
+		if(src_used==0) {
+			// The next code is truncated.
+			packbits_decode_one_code_slow(f, &pos, unc_pixels, nbytes_per_unit);
 		}
-		// Else b==128. No-op.
-		// TODO: Some (but not most) ILBM specs say that code 128 is used to
-		// mark the end of compressed data, so maybe there should be options to
-		// tell us what to do when code 128 is encountered.
 	}
 
 	dres->bytes_consumed = pos - dcmpri->pos;
 	dres->bytes_consumed_valid = 1;
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
+}
+
+void fmtutil_decompress_packbits_ex(deark *c, struct de_dfilter_in_params *dcmpri,
+	struct de_dfilter_out_params *dcmpro, struct de_dfilter_results *dres)
+{
+	decompress_packbits_internal(c, dcmpri, dcmpro, dres, 1);
 }
 
 // Returns 0 on failure (currently impossible).
@@ -247,55 +374,11 @@ int fmtutil_decompress_packbits(dbuf *f, i64 pos1, i64 len,
 	return 1;
 }
 
-// A 16-bit variant of de_fmtutil_uncompress_packbits().
+// A 16-bit variant of fmtutil_decompress_packbits_ex().
 void fmtutil_decompress_packbits16_ex(deark *c, struct de_dfilter_in_params *dcmpri,
 	struct de_dfilter_out_params *dcmpro, struct de_dfilter_results *dres)
 {
-	i64 pos;
-	u8 b, b1, b2;
-	i64 k;
-	i64 count;
-	i64 endpos;
-	i64 outf_len_limit = 0;
-	dbuf *f = dcmpri->f;
-	dbuf *unc_pixels = dcmpro->f;
-
-	pos = dcmpri->pos;
-	endpos = dcmpri->pos + dcmpri->len;
-
-	if(dcmpro->len_known) {
-		outf_len_limit = unc_pixels->len + dcmpro->expected_len;
-	}
-
-	while(1) {
-		if(dcmpro->len_known && unc_pixels->len >= outf_len_limit) {
-			break; // Decompressed the requested amount of dst data.
-		}
-
-		if(pos>=endpos) {
-			break; // Reached the end of source data
-		}
-		b = dbuf_getbyte(f, pos++);
-
-		if(b>128) { // A compressed run
-			count = 257 - (i64)b;
-			b1 = dbuf_getbyte(f, pos++);
-			b2 = dbuf_getbyte(f, pos++);
-			for(k=0; k<count; k++) {
-				dbuf_writebyte(unc_pixels, b1);
-				dbuf_writebyte(unc_pixels, b2);
-			}
-		}
-		else if(b<128) { // An uncompressed run
-			count = 1 + (i64)b;
-			dbuf_copy(f, pos, count*2, unc_pixels);
-			pos += count*2;
-		}
-		// Else b==128. No-op.
-	}
-
-	dres->bytes_consumed = pos - dcmpri->pos;
-	dres->bytes_consumed_valid = 1;
+	decompress_packbits_internal(c, dcmpri, dcmpro, dres, 2);
 }
 
 int fmtutil_decompress_packbits16(dbuf *f, i64 pos1, i64 len,
@@ -326,6 +409,40 @@ int fmtutil_decompress_packbits16(dbuf *f, i64 pos1, i64 len,
 	return 1;
 }
 
+// Decompress PackBits data directly to memory, e.g. one row of an image.
+// Decoding stops when dst_len bytes have been written, or at the end of the
+// compressed data, or at a code that is truncated by the end of the data.
+// Returns the number of bytes written to dst. The caller should not assume
+// any other bytes in dst have been changed.
+i64 fmtutil_decompress_packbits_to_mem(dbuf *f, i64 pos1, i64 len,
+	u8 *dst, i64 dst_len, UI nbytes_per_unit)
+{
+	deark *c = f->c;
+	i64 pos = pos1;
+	i64 endpos;
+	i64 dstpos = 0;
+	u8 inbuf[PACKBITS_INBUF_SIZE];
+
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
+	endpos = de_min_int(pos1+len, f->len);
+
+	while(dstpos<dst_len && pos<endpos) {
+		i64 src_len;
+		i64 src_used = 0;
+		const u8 *src;
+
+		src_len = de_min_int(endpos-pos, PACKBITS_INBUF_SIZE);
+		src = dbuf_borrow(f, pos, src_len, inbuf);
+		dstpos += packbits_decode_span(src, src_len, &dst[dstpos], dst_len-dstpos,
+			dst_len-dstpos, nbytes_per_unit, &src_used);
+		if(src_used==0) break;
+		pos += src_used;
+	}
+
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
+	return dstpos;
+}
+
 void fmtutil_decompress_rle90_ex(deark *c, struct de_dfilter_in_params *dcmpri,
 	struct de_dfilter_out_params *dcmpro, struct de_dfilter_results *dres,
 	unsigned int flags)
@@ -344,9 +461,12 @@ struct rle90ctx {
 static void my_rle90_codec_addbuf(struct de_dfilter_ctx *dfctx,
 	const u8 *buf, i64 buf_len)
 {
-	int i;
+	i64 i;
 	u8 b;
 	struct rle90ctx *rctx = (struct rle90ctx*)dfctx->codec_private;
+	// Output is collected here, and written in batches.
+	u8 outbuf[4096];
+	i64 outbuf_used = 0;
 
 	if(!rctx) return;
 
@@ -358,12 +478,18 @@ static void my_rle90_codec_addbuf(struct de_dfilter_ctx *dfctx,
 			break;
 		}
 
+		// Make sure there's room for the longest possible run.
+		if(outbuf_used > (i64)sizeof(outbuf)-256) {
+			dbuf_write(dfctx->dcmpro->f, outbuf, outbuf_used);
+			outbuf_used = 0;
+		}
+
 		b = buf[i];
 		rctx->total_nbytes_processed++;
 
 		if(rctx->countcode_pending && b==0) {
 			// Not RLE, just an escaped 0x90 byte.
-			dbuf_writebyte(dfctx->dcmpro->f, 0x90);
+			outbuf[outbuf_used++] = 0x90;
 			rctx->nbytes_written++;
 			rctx->last_output_byte = 0x90;
 			rctx->countcode_pending = 0;
@@ -379,8 +505,11 @@ static void my_rle90_codec_addbuf(struct de_dfilter_ctx *dfctx,
 			{
 				count = dfctx->dcmpro->expected_len - rctx->nbytes_written;
 			}
-			dbuf_write_run(dfctx->dcmpro->f, rctx->last_output_byte, count);
-			rctx->nbytes_written += count;
+			if(count>0) {
+				de_memset(&outbuf[outbuf_used], rctx->last_output_byte, (size_t)count);
+				outbuf_used += count;
+				rctx->nbytes_written += count;
+			}
 
 			rctx->countcode_pending = 0;
 		}
@@ -388,11 +517,15 @@ static void my_rle90_codec_addbuf(struct de_dfilter_ctx *dfctx,
 			rctx->countcode_pending = 1;
 		}
 		else {
-			dbuf_writebyte(dfctx->dcmpro->f, b);
+			outbuf[outbuf_used++] = b;
 			rctx->nbytes_written++;
 			rctx->last_output_byte = b;
 		}
 	}
+
+	if(outbuf_used>0) {
+		dbuf_write(dfctx->dcmpro->f, outbuf, outbuf_used);
+	}
 }
 
 static void my_rle90_codec_finish(struct de_dfilter_ctx *dfctx)
@@ -428,29 +561,169 @@ void dfilter_rle90_codec(struct de_dfilter_ctx *dfctx, void *codec_private_param
 	dfctx->codec_destroy_fn = my_rle90_codec_destroy;
 }
 
-struct szdd_ctx {
+struct packbits_codec_ctx {
+	struct de_packbits_params pbp;
+	i64 nbytes_consumed;
 	i64 nbytes_written;
-	int stop_flag;
-	struct de_dfilter_out_params *dcmpro;
-	struct de_lz77buffer *ringbuf;
+	// A code that was split across calls to addbuf.
+	i64 partial_len;
+	u8 partial[1+128*2];
+	u8 *rowbuf;
+	i64 rowbuf_used;
+	i64 rownum;
 };
 
-static void szdd_lz77buf_writebytecb(struct de_lz77buffer *rb, const u8 n)
+static i64 packbits_code_len(u8 b, UI nbytes_per_unit)
+{
+	if(b>128) return 1+(i64)nbytes_per_unit;
+	if(b<128) return 1+(1+(i64)b)*(i64)nbytes_per_unit;
+	return 1;
+}
+
+static void packbits_codec_emit(struct de_dfilter_ctx *dfctx, const u8 *buf, i64 len)
 {
-	struct szdd_ctx *sctx = (struct szdd_ctx*)rb->userdata;
+	struct packbits_codec_ctx *pctx = (struct packbits_codec_ctx*)dfctx->codec_private;
+
+	if(dfctx->dcmpro->len_known) {
+		if(pctx->nbytes_written+len >= dfctx->dcmpro->expected_len) {
+			len = dfctx->dcmpro->expected_len - pctx->nbytes_written;
+			dfctx->finished_flag = 1;
+		}
+	}
+	if(len<=0) return;
+	pctx->nbytes_written += len;
+
+	if(!pctx->pbp.row_cb) {
+		dbuf_write(dfctx->dcmpro->f, buf, len);
+		return;
+	}
 
-	if(sctx->stop_flag) return;
-	if(sctx->dcmpro->len_known) {
-		if(sctx->nbytes_written >= sctx->dcmpro->expected_len) {
-			sctx->stop_flag = 1;
-			return;
+	while(len>0) {
+		i64 n;
+
+		n = de_min_int(len, pctx->pbp.row_size - pctx->rowbuf_used);
+		de_memcpy(&pctx->rowbuf[pctx->rowbuf_used], buf, (size_t)n);
+		pctx->rowbuf_used += n;
+		buf += n;
+		len -= n;
+		if(pctx->rowbuf_used >= pctx->pbp.row_size) {
+			pctx->pbp.row_cb(dfctx, pctx->pbp.userdata, pctx->rownum, pctx->rowbuf);
+			pctx->rownum++;
+			pctx->rowbuf_used = 0;
 		}
 	}
+}
+
+static void my_packbits_codec_addbuf(struct de_dfilter_ctx *dfctx,
+	const u8 *buf, i64 buf_len)
+{
+	struct packbits_codec_ctx *pctx = (struct packbits_codec_ctx*)dfctx->codec_private;
+	UI nbytes_per_unit;
+	u8 outbuf[PACKBITS_OUTBUF_SIZE+PACKBITS_OUTBUF_SLACK];
+	i64 nbytes_out;
+	i64 src_used;
+
+	if(!pctx) return;
+	nbytes_per_unit = pctx->pbp.nbytes_per_unit;
+
+	// Finish any code left over from the previous call.
+	while(pctx->partial_len>0 && buf_len>0 && !dfctx->finished_flag) {
+		i64 code_len;
+		i64 n;
+
+		code_len = packbits_code_len(pctx->partial[0], nbytes_per_unit);
+		n = de_min_int(code_len - pctx->partial_len, buf_len);
+		de_memcpy(&pctx->partial[pctx->partial_len], buf, (size_t)n);
+		pctx->partial_len += n;
+		buf += n;
+		buf_len -= n;
+		if(pctx->partial_len < code_len) break;
+
+		nbytes_out = packbits_decode_span(pctx->partial, pctx->partial_len, outbuf,
+			PACKBITS_OUTBUF_SIZE, (i64)sizeof(outbuf), nbytes_per_unit, &src_used);
+		pctx->nbytes_consumed += pctx->partial_len;
+		pctx->partial_len = 0;
+		packbits_codec_emit(dfctx, outbuf, nbytes_out);
+	}
 
-	dbuf_writebyte(sctx->dcmpro->f, n);
-	sctx->nbytes_written++;
+	while(buf_len>0 && !dfctx->finished_flag) {
+		nbytes_out = packbits_decode_span(buf, buf_len, outbuf,
+			PACKBITS_OUTBUF_SIZE, (i64)sizeof(outbuf), nbytes_per_unit, &src_used);
+		if(src_used==0) {
+			// An incomplete code. Save it for next time.
+			de_memcpy(pctx->partial, buf, (size_t)buf_len);
+			pctx->partial_len = buf_len;
+			break;
+		}
+		pctx->nbytes_consumed += src_used;
+		buf += src_used;
+		buf_len -= src_used;
+		packbits_codec_emit(dfctx, outbuf, nbytes_out);
+	}
 }
 
+static void my_packbits_codec_finish(struct de_dfilter_ctx *dfctx)
+{
+	struct packbits_codec_ctx *pctx = (struct packbits_codec_ctx*)dfctx->codec_private;
+
+	if(!pctx) return;
+
+	// Deliver the last row, even if incomplete.
+	if(pctx->pbp.row_cb && pctx->rowbuf_used>0) {
+		de_zeromem(&pctx->rowbuf[pctx->rowbuf_used],
+			(size_t)(pctx->pbp.row_size - pctx->rowbuf_used));
+		pctx->pbp.row_cb(dfctx, pctx->pbp.userdata, pctx->rownum, pctx->rowbuf);
+		pctx->rownum++;
+		pctx->rowbuf_used = 0;
+	}
+
+	dfctx->dres->bytes_consumed = pctx->nbytes_consumed + pctx->partial_len;
+	dfctx->dres->bytes_consumed_valid = 1;
+}
+
+static void my_packbits_codec_destroy(struct de_dfilter_ctx *dfctx)
+{
+	struct packbits_codec_ctx *pctx = (struct packbits_codec_ctx*)dfctx->codec_private;
+
+	if(pctx) {
+		de_free(dfctx->c, pctx->rowbuf);
+		de_free(dfctx->c, pctx);
+	}
+	dfctx->codec_private = NULL;
+}
+
+// A "pushable" PackBits or PackBits16 decoder.
+// codec_private_params: struct de_packbits_params, or NULL for standard
+// PackBits written to dcmpro->f.
+// Unlike fmtutil_decompress_packbits_ex(), the output is truncated to exactly
+// dcmpro->expected_len bytes, if that is known.
+void dfilter_packbits_codec(struct de_dfilter_ctx *dfctx, void *codec_private_params)
+{
+	struct packbits_codec_ctx *pctx = NULL;
+	struct de_packbits_params *pbp = (struct de_packbits_params*)codec_private_params;
+
+	pctx = de_malloc(dfctx->c, sizeof(struct packbits_codec_ctx));
+	if(pbp) {
+		pctx->pbp = *pbp;
+	}
+	if(pctx->pbp.nbytes_per_unit!=2) {
+		pctx->pbp.nbytes_per_unit = 1;
+	}
+	if(pctx->pbp.row_cb) {
+		if(pctx->pbp.row_size<1) pctx->pbp.row_size = 1;
+		pctx->rowbuf = de_malloc(dfctx->c, pctx->pbp.row_size);
+	}
+	dfctx->codec_private = (void*)pctx;
+	dfctx->codec_addbuf_fn = my_packbits_codec_addbuf;
+	dfctx->codec_finish_fn = my_packbits_codec_finish;
+	dfctx->codec_destroy_fn = my_packbits_codec_destroy;
+}
+
+struct szdd_ctx {
+	struct de_dfilter_out_params *dcmpro;
+	struct de_lz77buffer *ringbuf;
+};
+
 static void szdd_init_window_default(struct de_lz77buffer *ringbuf)
 {
 	de_lz77buffer_clear(ringbuf, 0x20);
@@ -491,11 +764,12 @@ void fmtutil_decompress_szdd(deark *c, struct de_dfilter_in_params *dcmpri,
 	i64 endpos = dcmpri->pos + dcmpri->len;
 	struct szdd_ctx *sctx = NULL;
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	sctx = de_malloc(c, sizeof(struct szdd_ctx));
 	sctx->dcmpro = dcmpro;
 	sctx->ringbuf = de_lz77buffer_create(c, 4096);
-	sctx->ringbuf->writebyte_cb = szdd_lz77buf_writebytecb;
-	sctx->ringbuf->userdata = (void*)sctx;
+	de_lz77buffer_set_output(sctx->ringbuf, dcmpro->f, dcmpro->len_known,
+		dcmpro->expected_len);
 
 	if(flags & 0x1) {
 		szdd_init_window_lz5(sctx->ringbuf);
@@ -518,7 +792,7 @@ void fmtutil_decompress_szdd(deark *c, struct de_dfilter_in_params *dcmpri,
 				if(pos+1 > endpos) goto unc_done;
 				b = dbuf_getbyte(dcmpri->f, pos++);
 				de_lz77buffer_add_literal_byte(sctx->ringbuf, b);
-				if(sctx->stop_flag) goto unc_done;
+				if(de_lz77buffer_output_overflowed(sctx->ringbuf)) goto unc_done;
 			}
 			else { // match
 				UI x0, x1;
@@ -531,7 +805,7 @@ void fmtutil_decompress_szdd(deark *c, struct de_dfilter_in_params *dcmpri,
 				matchpos = ((x1 & 0xf0) << 4) | x0;
 				matchlen = (x1 & 0x0f) + 3;
 				de_lz77buffer_copy_from_hist(sctx->ringbuf, matchpos, matchlen);
-				if(sctx->stop_flag) goto unc_done;
+				if(de_lz77buffer_output_overflowed(sctx->ringbuf)) goto unc_done;
 			}
 		}
 	}
@@ -540,36 +814,20 @@ unc_done:
 	dres->bytes_consumed_valid = 1;
 	dres->bytes_consumed = pos - dcmpri->pos;
 	if(sctx) {
+		de_lz77buffer_flush(sctx->ringbuf);
 		de_lz77buffer_destroy(c, sctx->ringbuf);
 		de_free(c, sctx);
 	}
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
 
 //======================= hlp_lz77 =======================
 
 struct hlplz77ctx {
-	i64 nbytes_written;
-	int stop_flag;
 	struct de_dfilter_out_params *dcmpro;
 	struct de_lz77buffer *ringbuf;
 };
 
-static void hlplz77_lz77buf_writebytecb(struct de_lz77buffer *rb, const u8 n)
-{
-	struct hlplz77ctx *sctx = (struct hlplz77ctx*)rb->userdata;
-
-	if(sctx->stop_flag) return;
-	if(sctx->dcmpro->len_known) {
-		if(sctx->nbytes_written >= sctx->dcmpro->expected_len) {
-			sctx->stop_flag = 1;
-			return;
-		}
-	}
-
-	dbuf_writebyte(sctx->dcmpro->f, n);
-	sctx->nbytes_written++;
-}
-
 // This is very similar to the mscompress SZDD algorithm, but
 // gratuitously different.
 void fmtutil_hlp_lz77_codectype1(deark *c, struct de_dfilter_in_params *dcmpri,
@@ -580,11 +838,12 @@ void fmtutil_hlp_lz77_codectype1(deark *c, struct de_dfilter_in_params *dcmpri,
 	i64 endpos = dcmpri->pos + dcmpri->len;
 	struct hlplz77ctx *sctx = NULL;
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	sctx = de_malloc(c, sizeof(struct hlplz77ctx));
 	sctx->dcmpro = dcmpro;
 	sctx->ringbuf = de_lz77buffer_create(c, 4096);
-	sctx->ringbuf->writebyte_cb = hlplz77_lz77buf_writebytecb;
-	sctx->ringbuf->userdata = (void*)sctx;
+	de_lz77buffer_set_output(sctx->ringbuf, dcmpro->f, dcmpro->len_known,
+		dcmpro->expected_len);
 	de_lz77buffer_clear(sctx->ringbuf, 0x20);
 
 	while(1) {
@@ -601,7 +860,7 @@ void fmtutil_hlp_lz77_codectype1(deark *c, struct de_dfilter_in_params *dcmpri,
 				if(pos+1 > endpos) goto unc_done;
 				b = dbuf_getbyte(dcmpri->f, pos++);
 				de_lz77buffer_add_literal_byte(sctx->ringbuf, b);
-				if(sctx->stop_flag) goto unc_done;
+				if(de_lz77buffer_output_overflowed(sctx->ringbuf)) goto unc_done;
 			}
 			else { // match
 				UI x;
@@ -613,7 +872,7 @@ void fmtutil_hlp_lz77_codectype1(deark *c, struct de_dfilter_in_params *dcmpri,
 				matchlen = (x>>12) + 3;
 				matchpos = sctx->ringbuf->curpos - ((x & 0x0fff)+1);
 				de_lz77buffer_copy_from_hist(sctx->ringbuf, matchpos, matchlen);
-				if(sctx->stop_flag) goto unc_done;
+				if(de_lz77buffer_output_overflowed(sctx->ringbuf)) goto unc_done;
 			}
 		}
 	}
@@ -622,9 +881,11 @@ unc_done:
 	dres->bytes_consumed_valid = 1;
 	dres->bytes_consumed = pos - dcmpri->pos;
 	if(sctx) {
+		de_lz77buffer_flush(sctx->ringbuf);
 		de_lz77buffer_destroy(c, sctx->ringbuf);
 		de_free(c, sctx);
 	}
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
 
 //========================================================
@@ -663,6 +924,7 @@ void de_dfilter_decompress_two_layer(deark *c, struct de_dcmpr_two_layer_params
 	struct my_2layer_userdata u;
 	struct de_dfilter_ctx *dfctx_codec2 = NULL;
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	de_dfilter_init_objects(c, NULL, &dcmpro_codec1, NULL);
 	de_dfilter_init_objects(c, NULL, NULL, &dres_codec2);
 	de_zeromem(&u, sizeof(struct my_2layer_userdata));
@@ -710,6 +972,7 @@ void de_dfilter_decompress_two_layer(deark *c, struct de_dcmpr_two_layer_params
 done:
 	de_dfilter_destroy(dfctx_codec2);
 	dbuf_close(outf_codec1);
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
 
 // TODO: Retire this function.
@@ -750,23 +1013,117 @@ void de_lz77buffer_destroy(deark *c, struct de_lz77buffer *rb)
 	de_free(c, rb);
 }
 
+// Call this to have output written directly to outf, instead of calling
+// writebyte_cb for each byte. At most max_len bytes will be written, if
+// max_len_known is set.
+// The caller must call de_lz77buffer_flush() when done.
+void de_lz77buffer_set_output(struct de_lz77buffer *rb, dbuf *outf,
+	u8 max_len_known, i64 max_len)
+{
+	// If the object is being reused, finish writing to the old output.
+	de_lz77buffer_flush(rb);
+	rb->nbytes_produced = 0;
+	rb->nbytes_flushed = 0;
+	rb->outf = outf;
+	rb->max_len_known = max_len_known;
+	rb->max_len = max_len;
+}
+
+// Write any pending output bytes to outf.
+void de_lz77buffer_flush(struct de_lz77buffer *rb)
+{
+	i64 n;
+	UI startpos;
+	UI n1;
+
+	if(!rb || !rb->outf || rb->npending==0) return;
+
+	n = (i64)rb->npending;
+	if(rb->max_len_known) {
+		if(rb->nbytes_flushed >= rb->max_len) {
+			n = 0;
+		}
+		else if(rb->nbytes_flushed+n > rb->max_len) {
+			n = rb->max_len - rb->nbytes_flushed;
+		}
+	}
+
+	// The pending bytes may wrap around the end of the buffer.
+	startpos = (rb->curpos - rb->npending) & rb->mask;
+	n1 = (UI)de_min_int(n, (i64)(rb->bufsize - startpos));
+	dbuf_write(rb->outf, &rb->buf[startpos], (i64)n1);
+	if(n > (i64)n1) {
+		dbuf_write(rb->outf, rb->buf, n-(i64)n1);
+	}
+
+	rb->nbytes_flushed += (i64)rb->npending;
+	rb->npending = 0;
+}
+
 // Set all bytes to the same value, and reset the current position to 0.
 void de_lz77buffer_clear(struct de_lz77buffer *rb, UI val)
 {
+	de_lz77buffer_flush(rb);
 	de_memset(rb->buf, val, rb->bufsize);
 	rb->curpos = 0;
 }
 
 void de_lz77buffer_set_curpos(struct de_lz77buffer *rb, UI newpos)
 {
+	de_lz77buffer_flush(rb);
 	rb->curpos = newpos & rb->mask;
 }
 
 void de_lz77buffer_add_literal_byte(struct de_lz77buffer *rb, u8 b)
 {
-	rb->writebyte_cb(rb, b);
+	if(!rb->outf) {
+		rb->writebyte_cb(rb, b);
+		rb->buf[rb->curpos] = b;
+		rb->curpos = (rb->curpos+1) & rb->mask;
+		return;
+	}
+
 	rb->buf[rb->curpos] = b;
 	rb->curpos = (rb->curpos+1) & rb->mask;
+	rb->nbytes_produced++;
+	rb->npending++;
+	// Never let the pending bytes fill more than half the buffer.
+	if(rb->npending >= rb->bufsize/2) {
+		de_lz77buffer_flush(rb);
+	}
+}
+
+// Copy n bytes within the buffer, from srcpos to dstpos, where neither range
+// wraps around. Overlapping is allowed, and works the way LZ77 requires:
+// if the source is just behind the destination, the pattern repeats.
+static void lz77buffer_copy_segment(u8 *buf, UI srcpos, UI dstpos, UI n)
+{
+	UI dist;
+
+	if(srcpos >= dstpos) {
+		// Any bytes we overwrite have already been read.
+		de_memmove(&buf[dstpos], &buf[srcpos], (size_t)n);
+		return;
+	}
+
+	dist = dstpos - srcpos;
+	if(dist >= n) {
+		de_memcpy(&buf[dstpos], &buf[srcpos], (size_t)n);
+	}
+	else if(dist==1) {
+		de_memset(&buf[dstpos], buf[srcpos], (size_t)n);
+	}
+	else {
+		// Replicate the pattern, doubling the amount we can copy each time.
+		while(n>0) {
+			UI amt = (dist < n) ? dist : n;
+
+			de_memcpy(&buf[dstpos], &buf[srcpos], (size_t)amt);
+			dstpos += amt;
+			n -= amt;
+			dist += amt;
+		}
+	}
 }
 
 void de_lz77buffer_copy_from_hist(struct de_lz77buffer *rb,
@@ -776,8 +1133,35 @@ void de_lz77buffer_copy_from_hist(struct de_lz77buffer *rb,
 	UI i;
 
 	frompos = startpos & rb->mask;
-	for(i=0; i<count; i++) {
-		de_lz77buffer_add_literal_byte(rb, rb->buf[frompos]);
-		frompos = (frompos+1) & rb->mask;
+
+	if(!rb->outf) {
+		for(i=0; i<count; i++) {
+			de_lz77buffer_add_literal_byte(rb, rb->buf[frompos]);
+			frompos = (frompos+1) & rb->mask;
+		}
+		return;
+	}
+
+	while(count>0) {
+		UI n;
+
+		if(rb->npending >= rb->bufsize/2) {
+			de_lz77buffer_flush(rb);
+		}
+
+		// Copy as much as we can without wrapping around, or letting the
+		// pending bytes fill more than half the buffer.
+		n = count;
+		if(n > rb->bufsize/2 - rb->npending) n = rb->bufsize/2 - rb->npending;
+		if(n > rb->bufsize - frompos) n = rb->bufsize - frompos;
+		if(n > rb->bufsize - rb->curpos) n = rb->bufsize - rb->curpos;
+
+		lz77buffer_copy_segment(rb->buf, frompos, rb->curpos, n);
+
+		frompos = (frompos+n) & rb->mask;
+		rb->curpos = (rb->curpos+n) & rb->mask;
+		rb->npending += n;
+		rb->nbytes_produced += (i64)n;
+		count -= n;
 	}
 }
@@ -11,6 +11,8 @@
 #define NODE_REF_TYPE u32
 #define MAX_TREE_DEPTH 56
 #define MAX_MAX_NODES  66000
+// Max number of bits to decode with a single table lookup
+#define FAST_TABLE_MAX_BITS 10
 
 struct huffman_nval_pointer_data {
 	NODE_REF_TYPE noderef;
@@ -38,6 +40,15 @@ struct huffman_lengths_arr_item {
 	UI len;
 };
 
+struct huffman_fast_entry {
+#define FASTSTATUS_INVALID 0 // Not a valid code, or not known
+#define FASTSTATUS_VALUE   1 // A complete code
+#define FASTSTATUS_POINTER 2 // A prefix of a longer code
+	u8 status;
+	u8 nbits; // Number of bits to consume
+	union huffman_nval_data d;
+};
+
 struct huffman_cursor {
 	NODE_REF_TYPE curr_noderef;
 };
@@ -61,6 +72,13 @@ struct fmtutil_huffman_tree {
 	i64 lengths_arr_numalloc;
 	i64 lengths_arr_numused;
 	struct huffman_lengths_arr_item *lengths_arr; // array[lengths_arr_numalloc]
+
+	// Lookup table used by fmtutil_huffman_read_next_value(), indexed by the
+	// next fast_nbits bits of input (in the order used by the bitreader).
+	// Built on demand; fast_table is NULL if it needs to be (re)built.
+	UI fast_nbits;
+	u8 fast_is_lsb;
+	struct huffman_fast_entry *fast_table; // array[1<<fast_nbits]
 };
 
 // Ensure that at least n nodes are allocated (0 through n-1)
@@ -138,6 +156,12 @@ int fmtutil_huffman_add_code(deark *c, struct fmtutil_huffman_tree *ht,
 
 	if(code_nbits>MAX_TREE_DEPTH) goto done;
 
+	// Any lookup table is now out of date.
+	if(ht->fast_table) {
+		de_free(c, ht->fast_table);
+		ht->fast_table = NULL;
+	}
+
 	if(code_nbits<1) {
 		ht->value_of_null_code = val;
 		ht->has_null_code = 1;
@@ -231,6 +255,69 @@ done:
 	return retval;
 }
 
+// Make a table that, for each possible sequence of the next fast_nbits
+// bits, tells us the code it starts with, or the node to continue from if
+// the code is longer than that.
+static void huffman_make_fast_table(deark *c, struct fmtutil_huffman_tree *ht,
+	u8 is_lsb)
+{
+	UI nbits;
+	UI idx;
+	UI num_entries;
+
+	if(ht->fast_table) {
+		de_free(c, ht->fast_table);
+		ht->fast_table = NULL;
+	}
+
+	nbits = ht->max_bits;
+	if(nbits>FAST_TABLE_MAX_BITS) nbits = FAST_TABLE_MAX_BITS;
+	if(nbits<1) return;
+	num_entries = 1U<<nbits;
+
+	ht->fast_nbits = nbits;
+	ht->fast_is_lsb = is_lsb;
+	ht->fast_table = de_mallocarray(c, num_entries, sizeof(struct huffman_fast_entry));
+
+	for(idx=0; idx<num_entries; idx++) {
+		struct huffman_fast_entry *fe = &ht->fast_table[idx];
+		NODE_REF_TYPE curr_noderef = 0;
+		UI k;
+
+		for(k=0; k<nbits; k++) {
+			UI child_idx;
+			struct huffman_node *nd;
+
+			if(curr_noderef >= ht->nodes_alloc) break;
+			if(curr_noderef >= ht->next_avail_node) break;
+			nd = &ht->nodes[curr_noderef];
+
+			if(is_lsb) {
+				child_idx = (idx>>k) & 0x1;
+			}
+			else {
+				child_idx = (idx>>(nbits-1-k)) & 0x1;
+			}
+
+			if(nd->child_status[child_idx]==CHILDSTATUS_VALUE) {
+				fe->status = FASTSTATUS_VALUE;
+				fe->nbits = (u8)(k+1);
+				fe->d.hnvd.value = nd->child[child_idx].hnvd.value;
+				break;
+			}
+			if(nd->child_status[child_idx]!=CHILDSTATUS_POINTER) {
+				break;
+			}
+			curr_noderef = nd->child[child_idx].hnpd.noderef;
+			if(k==nbits-1) {
+				fe->status = FASTSTATUS_POINTER;
+				fe->nbits = (u8)nbits;
+				fe->d.hnpd.noderef = curr_noderef;
+			}
+		}
+	}
+}
+
 // Read the next Huffman code from a bitreader, and decode it.
 // *pval will always be written to. On error, it will be set to 0.
 // pnbits returns the number of bits read. Can be NULL.
@@ -252,6 +339,36 @@ int fmtutil_huffman_read_next_value(struct fmtutil_huffman_tree *ht,
 		goto done;
 	}
 
+	// Fast path: Decode as many bits as we can with a table lookup.
+	if(ht->cursor.curr_noderef==0 && ht->max_bits>0) {
+		u64 n;
+
+		if(!ht->fast_table || ht->fast_is_lsb!=bitrd->bbll.is_lsb) {
+			huffman_make_fast_table(bitrd->f->c, ht, bitrd->bbll.is_lsb);
+		}
+
+		// (Near the end of the data, there may not be enough bits left to
+		// do this. The slow path will handle it.)
+		if(ht->fast_table && de_bitreader_peekbits(bitrd, ht->fast_nbits, &n)) {
+			const struct huffman_fast_entry *fe = &ht->fast_table[n];
+
+			if(fe->status==FASTSTATUS_VALUE) {
+				de_bitreader_skipbits(bitrd, fe->nbits);
+				bitcount = (int)fe->nbits;
+				*pval = fe->d.hnvd.value;
+				retval = 1;
+				goto done;
+			}
+			else if(fe->status==FASTSTATUS_POINTER) {
+				// A long code. Continue bit-by-bit.
+				de_bitreader_skipbits(bitrd, fe->nbits);
+				bitcount = (int)fe->nbits;
+				ht->cursor.curr_noderef = fe->d.hnpd.noderef;
+			}
+			// Else let the slow path report the error.
+		}
+	}
+
 	while(1) {
 		int ret;
 		u8 b;
@@ -456,6 +573,7 @@ void fmtutil_huffman_destroy_tree(deark *c, struct fmtutil_huffman_tree *ht)
 {
 	if(!ht) return;
 	de_free(c, ht->lengths_arr);
+	de_free(c, ht->fast_table);
 	de_free(c, ht);
 }
 
@@ -642,6 +760,7 @@ void fmtutil_huff_squeeze_codectype1(deark *c, struct de_dfilter_in_params *dcmp
 	struct squeeze_ctx *sqctx = NULL;
 	int ok = 0;
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	sqctx = de_malloc(c, sizeof(struct squeeze_ctx));
 	sqctx->c = c;
 	sqctx->modname = "unsqueeze";
@@ -659,6 +778,7 @@ void fmtutil_huff_squeeze_codectype1(deark *c, struct de_dfilter_in_params *dcmp
 	if(!squeeze_read_codes(c, sqctx)) goto done;
 
 	dres->bytes_consumed = sqctx->bitrd.curpos - dcmpri->pos;
+	dres->bytes_consumed -= sqctx->bitrd.bbll.nbits_in_bitbuf / 8;
 	if(dres->bytes_consumed > dcmpri->len) {
 		dres->bytes_consumed = dcmpri->len;
 	}
@@ -674,4 +794,5 @@ done:
 		fmtutil_huffman_destroy_tree(c, sqctx->ht);
 		de_free(c, sqctx);
 	}
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
@@ -19,7 +19,6 @@ struct lzh_ctx {
 	struct de_dfilter_results *dres;
 	const char *modname;
 
-	i64 nbytes_written;
 	int err_flag;
 
 	// bitrd.eof_flag: Always set if err_flag is set.
@@ -421,27 +420,6 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int lzh_have_enough_output(struct lzh_ctx *cctx)
-{
-	if(cctx->dcmpro->len_known) {
-		if(cctx->nbytes_written >= cctx->dcmpro->expected_len) {
-			return 1;
-		}
-	}
-	return 0;
-}
-
-static void lha5like_lz77buf_writebytecb(struct de_lz77buffer *rb, u8 n)
-{
-	struct lzh_ctx *cctx = (struct lzh_ctx*)rb->userdata;
-
-	if(lzh_have_enough_output(cctx)) {
-		return;
-	}
-	dbuf_writebyte(cctx->dcmpro->f, n);
-	cctx->nbytes_written++;
-}
-
 static void decompress_lha_lh5like(struct lzh_ctx *cctx, struct de_lzh_params *lzhp)
 {
 	int blk_idx = 0;
@@ -461,8 +439,8 @@ static void decompress_lha_lh5like(struct lzh_ctx *cctx, struct de_lzh_params *l
 	cctx->stop_on_zero_codes_block = lzhp->stop_on_zero_codes_block;
 
 	cctx->ringbuf = de_lz77buffer_create(cctx->c, rb_size);
-	cctx->ringbuf->userdata = (void*)cctx;
-	cctx->ringbuf->writebyte_cb = lha5like_lz77buf_writebytecb;
+	de_lz77buffer_set_output(cctx->ringbuf, cctx->dcmpro->f,
+		cctx->dcmpro->len_known, cctx->dcmpro->expected_len);
 	if(lzhp->use_history_fill_val) {
 		if(lzhp->history_fill_val!=0x00) {
 			de_lz77buffer_clear(cctx->ringbuf, lzhp->history_fill_val);
@@ -474,7 +452,7 @@ static void decompress_lha_lh5like(struct lzh_ctx *cctx, struct de_lzh_params *l
 
 	while(1) {
 		if(cctx->bitrd.eof_flag) break;
-		if(lzh_have_enough_output(cctx)) break;
+		if(de_lz77buffer_have_enough_output(cctx->ringbuf)) break;
 
 		lh5x_do_lzh_block(cctx, blk_idx);
 		blk_idx++;
@@ -487,6 +465,7 @@ void fmtutil_decompress_lzh(deark *c, struct de_dfilter_in_params *dcmpri,
 {
 	struct lzh_ctx *cctx = NULL;
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	cctx = de_malloc(c, sizeof(struct lzh_ctx));
 	cctx->modname = "unlzh";
 	cctx->c = c;
@@ -526,9 +505,11 @@ done:
 		fmtutil_huffman_destroy_tree(c, cctx->codelengths_tree.ht);
 		fmtutil_huffman_destroy_tree(c, cctx->codes_tree.ht);
 		fmtutil_huffman_destroy_tree(c, cctx->offsets_tree.ht);
+		de_lz77buffer_flush(cctx->ringbuf);
 		de_lz77buffer_destroy(c, cctx->ringbuf);
 		de_free(c, cctx);
 	}
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
 
 void fmtutil_lzh_codectype1(deark *c, struct de_dfilter_in_params *dcmpri,
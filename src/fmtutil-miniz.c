@@ -38,6 +38,7 @@ void fmtutil_inflate_codectype1(deark *c, struct de_dfilter_in_params *dcmpri,
 	int stream_open_flag = 0;
 	static const char *modname = "inflate";
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	dres->bytes_consumed = 0;
 	if(dcmpri->len<0) {
 		de_dfilter_set_errorf(c, dres, modname, "Internal error");
@@ -157,6 +158,7 @@ done:
 	}
 	de_free(c, inbuf);
 	de_free(c, outbuf);
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
 
 // flags:
@@ -284,3 +286,33 @@ unsigned int fmtutil_tdefl_create_comp_flags_from_zip_params(int level, int wind
 	return (unsigned int)tdefl_create_comp_flags_from_zip_params(level, window_bits,
 		strategy);
 }
+
+// Deflate a sample of some data quickly, and report whether it failed to get
+// meaningfully smaller. If so, it's very likely that compressing all of it at
+// a high level would be a waste of time. Many of the files we write (PNG
+// images, nested archives, etc.) are already compressed, and some images are
+// too noisy to compress.
+int fmtutil_tdefl_looks_incompressible(deark *c, const u8 *buf, i64 len)
+{
+	dbuf *tmpf = NULL;
+	struct fmtutil_tdefl_ctx *tdctx = NULL;
+	int retval = 0;
+
+	// A custom dbuf with no write function just counts the bytes.
+	tmpf = dbuf_create_custom_dbuf(c, 0, 0);
+	tdctx = fmtutil_tdefl_create(c, tmpf,
+		(int)fmtutil_tdefl_create_comp_flags_from_zip_params(1, -15, 0));
+	if(fmtutil_tdefl_compress_buffer(tdctx, buf, (size_t)len, FMTUTIL_TDEFL_FINISH) !=
+		FMTUTIL_TDEFL_STATUS_DONE)
+	{
+		goto done;
+	}
+	if(tmpf->len >= len - len/32) {
+		retval = 1;
+	}
+
+done:
+	fmtutil_tdefl_destroy(tdctx);
+	dbuf_close(tmpf);
+	return retval;
+}
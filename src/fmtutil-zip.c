@@ -104,6 +104,7 @@ void fmtutil_decompress_zip_reduce(deark *c, struct de_dfilter_in_params *dcmpri
 	struct ozXX_udatatype uctx;
 	static const char *modname = "unreduce";
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	if(!dcmpro->len_known) goto done;
 
 	de_zeromem(&uctx, sizeof(struct ozXX_udatatype));
@@ -139,6 +140,7 @@ done:
 	if(retval==0 && !dres->errcode) {
 		de_dfilter_set_generic_error(c, dres, modname);
 	}
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
 
 static void zipexpl_huft_dump1(struct ozXX_udatatype *zu, struct ui6a_huft *t, unsigned int idx)
@@ -237,6 +239,7 @@ void fmtutil_decompress_zip_implode(deark *c, struct de_dfilter_in_params *dcmpr
 	int retval = 0;
 	static const char *modname = "unimplode";
 
+	de_stats_begin(c, DE_STATS_PHASE_DCMPR);
 	de_zeromem(&zu, sizeof(struct ozXX_udatatype));
 	if(!dcmpro->len_known) goto done;
 
@@ -274,4 +277,5 @@ done:
 	if(!retval && !dres->errcode) {
 		de_dfilter_set_generic_error(c, dres, modname);
 	}
+	de_stats_end(c, DE_STATS_PHASE_DCMPR);
 }
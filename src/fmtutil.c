@@ -653,6 +653,83 @@ static u8 scale_15_to_255(u8 x)
 	return x*17;
 }
 
+// Transpose an 8x8 bit matrix. On input, byte #p (counting from the least
+// significant byte) holds 8 pixels' bits for plane p, most significant bit
+// first. On output, byte #(7-k) holds the 8 plane bits of pixel k, with plane
+// 0 in the least significant bit.
+static u64 transpose_8x8_bits(u64 x)
+{
+	u64 t;
+
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x = x ^ t ^ (t << 28);
+	return x;
+}
+
+// Convert a row of planar pixels to one byte per pixel (e.g. palette indices).
+// The bit for plane p goes to bit p of the output byte.
+//
+// src: The first byte of plane 0.
+// nplanes: 1 to 8. To handle more planes, call this again for each group of
+//   8 planes, offsetting src by plane_stride*8.
+// plane_stride: Distance from a byte of one plane, to the corresponding byte of
+//   the next plane.
+// The bytes of a plane are in units of unit_size bytes (each holding
+//   unit_size*8 pixels, most significant bit first), with units starting
+//   every unit_stride bytes. For data that is not interleaved at the word
+//   level, set unit_size and unit_stride to the number of bytes per plane
+//   per row.
+// dst: Receives npixels bytes, dst_stride bytes apart.
+void fmtutil_planar_to_chunky(const u8 *src, i64 npixels, UI nplanes,
+	i64 plane_stride, i64 unit_size, i64 unit_stride, u8 *dst, i64 dst_stride)
+{
+	i64 nbytes_per_plane;
+	i64 k;
+	i64 unitpos = 0; // Offset of the current unit
+	i64 posinunit = 0;
+	UI p;
+
+	if(nplanes<1 || nplanes>8 || unit_size<1) return;
+	nbytes_per_plane = (npixels+7)/8;
+
+	for(k=0; k<nbytes_per_plane; k++) {
+		const u8 *s;
+		u64 x = 0;
+		i64 npixels_this_byte;
+		i64 i;
+
+		s = &src[unitpos + posinunit];
+		for(p=0; p<nplanes; p++) {
+			x |= (u64)s[p*plane_stride] << (8*p);
+		}
+		if(nplanes>1) {
+			x = transpose_8x8_bits(x);
+		}
+
+		npixels_this_byte = de_min_int(npixels - k*8, 8);
+		if(nplanes==1) {
+			for(i=0; i<npixels_this_byte; i++) {
+				dst[(k*8+i)*dst_stride] = (u8)((x >> (7-i)) & 1);
+			}
+		}
+		else {
+			for(i=0; i<npixels_this_byte; i++) {
+				dst[(k*8+i)*dst_stride] = (u8)(x >> (8*(7-i)));
+			}
+		}
+
+		posinunit++;
+		if(posinunit>=unit_size) {
+			posinunit = 0;
+			unitpos += unit_stride;
+		}
+	}
+}
+
 void fmtutil_read_atari_palette(deark *c, dbuf *f, i64 pos,
 	de_color *dstpal, i64 ncolors_to_read, i64 ncolors_used, unsigned int flags)
 {
@@ -789,12 +866,11 @@ static unsigned int spectrum512_FindIndex(i64 x, unsigned int c)
 static int decode_atari_image_paletted(deark *c, struct atari_img_decode_data *adata)
 {
 	i64 i, j;
-	i64 plane;
 	i64 rowspan;
-	u8 b;
-	u32 v;
 	i64 planespan;
 	i64 ncolors;
+	u8 *rowbuf_src = NULL;
+	u8 *rowbuf_idx = NULL;
 
 	planespan = 2*((adata->w+15)/16);
 	rowspan = planespan*adata->bpp;
@@ -803,49 +879,47 @@ static int decode_atari_image_paletted(deark *c, struct atari_img_decode_data *a
 	else
 		ncolors = ((i64)1)<<adata->bpp;
 
+	rowbuf_src = de_malloc(c, rowspan);
+	rowbuf_idx = de_malloc(c, adata->w);
+
 	for(j=0; j<adata->h; j++) {
-		for(i=0; i<adata->w; i++) {
-			v = 0;
-
-			for(plane=0; plane<adata->bpp; plane++) {
-				if(adata->was_compressed==0) {
-					// TODO: Simplify this.
-					if(adata->bpp==1) {
-						b = de_get_bits_symbol(adata->unc_pixels, 1, j*rowspan, i);
-					}
-					else if(adata->bpp==2) {
-						b = de_get_bits_symbol(adata->unc_pixels, 1,
-							j*rowspan + 2*plane + (i/16)*2, i);
-					}
-					else if(adata->bpp==4) {
-						b = de_get_bits_symbol(adata->unc_pixels, 1,
-							j*rowspan + 2*plane + (i/2-(i/2)%16)+8*((i%32)/16), i%16);
-					}
-					else if(adata->bpp==8) {
-						b = de_get_bits_symbol(adata->unc_pixels, 1,
-							j*rowspan + 2*plane + (i-i%16), i%16);
-					}
-					else {
-						b = 0;
-					}
-				}
-				else {
-					b = de_get_bits_symbol(adata->unc_pixels, 1, j*rowspan + plane*planespan, i);
-				}
-				if(b) v |= 1<<plane;
-			}
+		const u8 *src;
+
+		src = dbuf_borrow(adata->unc_pixels, j*rowspan, rowspan, rowbuf_src);
+		if(adata->was_compressed==0) {
+			// The planes are interleaved in 16-bit words.
+			fmtutil_planar_to_chunky(src, adata->w, (UI)adata->bpp, 2, 2, 2*adata->bpp,
+				rowbuf_idx, 1);
+		}
+		else {
+			fmtutil_planar_to_chunky(src, adata->w, (UI)adata->bpp, planespan,
+				planespan, planespan, rowbuf_idx, 1);
+		}
+
+		if(adata->is_spectrum512) {
+			for(i=0; i<adata->w; i++) {
+				u32 v;
 
-			if(adata->is_spectrum512) {
-				v = spectrum512_FindIndex(i, v);
+				v = spectrum512_FindIndex(i, (UI)rowbuf_idx[i]);
 				if(j>0) {
 					v += (unsigned int)(48*(j));
 				}
+				if(v>=(unsigned int)ncolors) v=(unsigned int)(ncolors-1);
+				de_bitmap_setpixel_rgb(adata->img, i, j, adata->pal[v]);
 			}
-			if(v>=(unsigned int)ncolors) v=(unsigned int)(ncolors-1);
+			continue;
+		}
 
-			de_bitmap_setpixel_rgb(adata->img, i, j, adata->pal[v]);
+		if(ncolors<256) {
+			for(i=0; i<adata->w; i++) {
+				if(rowbuf_idx[i]>=ncolors) rowbuf_idx[i] = (u8)(ncolors-1);
+			}
 		}
+		de_convert_row_paletted_mem(rowbuf_idx, 8, adata->pal, adata->img, j, 0);
 	}
+
+	de_free(c, rowbuf_src);
+	de_free(c, rowbuf_idx);
 	return 1;
 }
 
@@ -1323,6 +1397,411 @@ const char *fmtutil_get_windows_cb_data_type_name(unsigned int ty)
 	return name;
 }
 
+// Find the length of the JPEG or JPEG-LS file starting at pos1, by walking
+// its markers until the EOI marker.
+// Returns 0 if it doesn't look like a complete JPEG file.
+int fmtutil_find_jpeg_len(deark *c, dbuf *f, i64 pos1, i64 len,
+	i64 *pjpeg_len, u8 *pis_jpegls)
+{
+	u8 b0, b1;
+	i64 pos;
+	i64 seg_size;
+	int in_scan = 0;
+	int found_sof = 0;
+	int found_scan = 0;
+
+	*pjpeg_len = 0;
+	*pis_jpegls = 0;
+	pos = pos1;
+
+	while(1) {
+		if(pos>=pos1+len)
+			break;
+		b0 = dbuf_getbyte(f, pos);
+
+		if(b0!=0xff) {
+			// Skip ahead to the next 0xff byte.
+			if(!dbuf_search_byte(f, 0xff, pos, pos1+len-pos, &pos)) break;
+			continue;
+		}
+
+		// Peek at the next byte (after this 0xff byte).
+		b1 = dbuf_getbyte(f, pos+1);
+
+		if(b1==0xff) {
+			// A "fill byte", not a marker.
+			pos++;
+			continue;
+		}
+		else if(b1==0x00 || (*pis_jpegls && b1<0x80 && in_scan)) {
+			// An escape sequence, not a marker.
+			pos+=2;
+			continue;
+		}
+		else if(b1==0xd9) { // EOI. That's what we're looking for.
+			if(!found_sof || !found_scan) return 0;
+			pos+=2;
+			*pjpeg_len = pos-pos1;
+			return 1;
+		}
+		else if(b1==0xf7) {
+			de_dbg(c, "Looks like a JPEG-LS file.");
+			found_sof = 1;
+			*pis_jpegls = 1;
+		}
+		else if(b1>=0xc0 && b1<=0xcf && b1!=0xc4 && b1!=0xc8 && b1!=0xcc) {
+			found_sof = 1;
+		}
+
+		if(b1==0xda) { // SOS - Start of scan
+			if(!found_sof) return 0;
+			found_scan = 1;
+			in_scan = 1;
+		}
+		else if(b1>=0xd0 && b1<=0xd7) {
+			// RSTn markers don't change the in_scan state.
+			;
+		}
+		else {
+			in_scan = 0;
+		}
+
+		if((b1>=0xd0 && b1<=0xda) || b1==0x01) {
+			// Markers that have no content.
+			pos+=2;
+			continue;
+		}
+
+		// Everything else should be a marker segment, with a length field.
+		seg_size = dbuf_getu16be(f, pos+2);
+		if(seg_size<2) break; // bogus size
+
+		pos += seg_size+2;
+	}
+
+	return 0;
+}
+
+// Find the length of the PNG, MNG, or JNG file starting at pos1, by walking
+// its chunks until the IEND (or MEND) chunk.
+// Returns 0 if it doesn't look like a complete file.
+int fmtutil_find_png_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 *ppng_len)
+{
+	i64 endpos = pos1+len;
+	i64 chunkpos = pos1+8;
+	i64 num_chunks = 0;
+
+	*ppng_len = 0;
+
+	while(1) {
+		i64 chunk_dlen;
+		u8 id[4];
+		u32 chunk_id;
+		UI k;
+
+		if(chunkpos+12 > endpos) return 0;
+		chunk_dlen = dbuf_getu32be(f, chunkpos);
+		if(chunk_dlen > 0x7fffffff) return 0;
+		dbuf_read(f, id, chunkpos+4, 4);
+		for(k=0; k<4; k++) {
+			if(!((id[k]>='A' && id[k]<='Z') || (id[k]>='a' && id[k]<='z'))) return 0;
+		}
+		chunk_id = (u32)de_getu32be_direct(id);
+		// The first chunk must be IHDR, MHDR, or JHDR.
+		if(num_chunks==0 && (id[1]!='H' || id[2]!='D' || id[3]!='R')) return 0;
+
+		chunkpos += 12+chunk_dlen;
+		if(chunkpos > endpos) return 0;
+		num_chunks++;
+		if(chunk_id==0x49454e44U || chunk_id==0x4d454e44U) break; // IEND, MEND
+	}
+
+	*ppng_len = chunkpos-pos1;
+	return 1;
+}
+
+// Skip over a sequence of GIF data sub-blocks.
+static int gif_skip_subblocks(dbuf *f, i64 endpos, i64 *ppos)
+{
+	while(1) {
+		i64 n;
+
+		if(*ppos >= endpos) return 0;
+		n = (i64)dbuf_getbyte_p(f, ppos);
+		if(n==0) break;
+		*ppos += n;
+	}
+	return 1;
+}
+
+// Find the length of the GIF file starting at pos1, by walking its blocks
+// until the trailer.
+// Returns 0 if it doesn't look like a complete GIF file with an image.
+int fmtutil_find_gif_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 *pgif_len)
+{
+	i64 endpos = pos1+len;
+	i64 pos = pos1+6;
+	i64 num_images = 0;
+	u8 flags;
+
+	*pgif_len = 0;
+
+	// Logical screen descriptor, and global color table
+	flags = dbuf_getbyte(f, pos+4);
+	pos += 7;
+	if(flags & 0x80) {
+		pos += 3*((i64)1<<((flags&0x07)+1));
+	}
+
+	while(1) {
+		u8 blktype;
+
+		if(pos >= endpos) return 0;
+		blktype = dbuf_getbyte_p(f, &pos);
+
+		if(blktype==0x3b) { // Trailer
+			break;
+		}
+		else if(blktype==0x21) { // Extension
+			pos++; // Extension label
+			if(!gif_skip_subblocks(f, endpos, &pos)) return 0;
+		}
+		else if(blktype==0x2c) { // Image descriptor
+			flags = dbuf_getbyte(f, pos+8);
+			pos += 9;
+			if(flags & 0x80) {
+				pos += 3*((i64)1<<((flags&0x07)+1));
+			}
+			pos++; // LZW minimum code size
+			if(!gif_skip_subblocks(f, endpos, &pos)) return 0;
+			num_images++;
+		}
+		else {
+			return 0;
+		}
+	}
+
+	if(num_images<1) return 0;
+	*pgif_len = pos-pos1;
+	return 1;
+}
+
+// Find the length of the BMP file starting at pos1, from its file header,
+// after checking that the headers are valid and consistent with it.
+// Returns 0 if it doesn't look like a complete BMP file.
+int fmtutil_find_bmp_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 *pbmp_len)
+{
+	struct de_bmpinfo bi;
+	i64 file_size;
+	i64 infohdrsize;
+	int ret;
+
+	*pbmp_len = 0;
+
+	// Rule out most false positives, before doing anything expensive.
+	infohdrsize = dbuf_getu32le(f, pos1+14);
+	if(infohdrsize!=12 && infohdrsize!=16 && infohdrsize!=40 && infohdrsize!=52 &&
+		infohdrsize!=56 && infohdrsize!=64 && infohdrsize!=108 && infohdrsize!=124)
+	{
+		return 0;
+	}
+	file_size = dbuf_getu32le(f, pos1+2);
+	if(file_size < 14+infohdrsize) return 0;
+	if(file_size > len) return 0;
+
+	de_dbg_indent(c, 1);
+	ret = fmtutil_get_bmpinfo(c, f, &bi, pos1, file_size, DE_BMPINFO_HAS_FILEHEADER);
+	de_dbg_indent(c, -1);
+	if(!ret) return 0;
+	if(bi.bitsoffset < 14+infohdrsize || bi.bitsoffset >= file_size) return 0;
+	if((bi.compression_field==0 || bi.compression_field==3) &&
+		bi.bitsoffset+bi.foreground_size > file_size)
+	{
+		return 0;
+	}
+
+	*pbmp_len = file_size;
+	return 1;
+}
+
+static int is_iff_id_byte(u8 b)
+{
+	return (b>='A' && b<='Z') || (b>='a' && b<='z') || (b>='0' && b<='9') ||
+		b==' ';
+}
+
+// Find the length of the IFF ("FORM") or RIFF file starting at pos1, from the
+// size of its top-level chunk. is_le selects RIFF.
+// On success, the form type is returned in *pformtype.
+// Returns 0 if it doesn't look like a complete file.
+int fmtutil_find_iff_len(deark *c, dbuf *f, i64 pos1, i64 len, int is_le,
+	i64 *pfile_len, struct de_fourcc *pformtype)
+{
+	i64 dlen;
+	UI k;
+
+	*pfile_len = 0;
+	dlen = dbuf_getu32x(f, pos1+4, is_le);
+	if(dlen<4 || 8+dlen > len) return 0;
+
+	dbuf_read_fourcc(f, pos1+8, pformtype, 4, 0);
+	for(k=0; k<4; k++) {
+		if(!is_iff_id_byte(pformtype->bytes[k])) return 0;
+	}
+
+	*pfile_len = 8+dlen;
+	return 1;
+}
+
+// Find the length of the ZIP file starting at pos1 (with a local file header),
+// by finding the end-of-central-directory record that belongs to it.
+// eocd_pos is the position of the first EOCD signature at or after pos1, or
+// -1 to search for it. Since that could belong to a ZIP file stored inside
+// this one, a few more are tried.
+// Zip64 is not supported.
+// Returns 0 if it doesn't look like a complete ZIP file.
+int fmtutil_find_zip_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 eocd_pos,
+	i64 *pzip_len)
+{
+	i64 endpos = pos1+len;
+	i64 cdir_size, cdir_offset;
+	i64 comment_len;
+	UI num_tries;
+
+	*pzip_len = 0;
+
+	for(num_tries=0; ; num_tries++) {
+		if(num_tries>=8) return 0;
+		if(num_tries>0 || eocd_pos<0) {
+			i64 startpos = (eocd_pos<0) ? pos1 : eocd_pos+4;
+
+			if(!dbuf_search(f, (const u8*)"PK\x05\x06", 4, startpos,
+				endpos-startpos, &eocd_pos))
+			{
+				return 0;
+			}
+		}
+
+		// Multi-disk archives are not supported.
+		if(dbuf_getu16le(f, eocd_pos+4)!=0 || dbuf_getu16le(f, eocd_pos+6)!=0) continue;
+		cdir_size = dbuf_getu32le(f, eocd_pos+12);
+		cdir_offset = dbuf_getu32le(f, eocd_pos+16);
+
+		// The central directory offset is relative to the start of the ZIP
+		// file, and the central directory must end where the EOCD record
+		// begins.
+		if(pos1+cdir_offset+cdir_size != eocd_pos) continue;
+		if(cdir_size>0 && dbuf_memcmp(f, pos1+cdir_offset, "PK\x01\x02", 4)) {
+			continue;
+		}
+		break;
+	}
+
+	comment_len = dbuf_getu16le(f, eocd_pos+20);
+	if(eocd_pos+22+comment_len > endpos) return 0;
+	*pzip_len = eocd_pos+22+comment_len-pos1;
+	return 1;
+}
+
+// Update *pmax_sec_id with the FAT sector at fat_sec_id, and the sectors it
+// marks as in use.
+static int cfb_scan_fat_sector(dbuf *f, i64 pos1, i64 endpos, i64 sec_size,
+	i64 fat_sec_idx, i64 fat_sec_id, u8 *buf, i64 *pmax_sec_id)
+{
+	i64 entries_per_sec = sec_size/4;
+	i64 k;
+
+	if(fat_sec_id<0) return 0;
+	if(pos1+(fat_sec_id+2)*sec_size > endpos) return 0;
+	if(fat_sec_id > *pmax_sec_id) *pmax_sec_id = fat_sec_id;
+
+	dbuf_read(f, buf, pos1+(fat_sec_id+1)*sec_size, sec_size);
+	for(k=entries_per_sec-1; k>=0; k--) {
+		if(de_getu32le_direct(&buf[k*4]) != 0xffffffffU) { // Not a free sector
+			if(fat_sec_idx*entries_per_sec+k > *pmax_sec_id) {
+				*pmax_sec_id = fat_sec_idx*entries_per_sec+k;
+			}
+			break;
+		}
+	}
+	return 1;
+}
+
+// Find the length of the OLE Compound File (CFB) starting at pos1.
+// The length is not stored anywhere, so we figure out the highest-numbered
+// sector that is in use, according to the FAT.
+// Returns 0 if it doesn't look like a complete CFB file.
+int fmtutil_find_cfb_len(deark *c, dbuf *f, i64 pos1, i64 len, i64 *pcfb_len)
+{
+	i64 endpos = pos1+len;
+	i64 sec_size;
+	i64 num_fat_secs;
+	i64 num_difat_secs;
+	i64 difat_sec_id;
+	i64 max_sec_id = -1;
+	i64 fat_sec_idx = 0;
+	i64 k;
+	u8 *buf = NULL;
+	u8 *difat = NULL;
+	int retval = 0;
+
+	*pcfb_len = 0;
+	if(dbuf_getu16le(f, pos1+28) != 0xfffe) goto done; // Byte order
+	k = dbuf_getu16le(f, pos1+30); // Sector shift
+	if(k!=9 && k!=12) goto done;
+	sec_size = (i64)1<<k;
+
+	num_fat_secs = dbuf_getu32le(f, pos1+44);
+	difat_sec_id = dbuf_geti32le(f, pos1+68);
+	num_difat_secs = dbuf_getu32le(f, pos1+72);
+	if(num_fat_secs<1 || num_fat_secs>1000000) goto done;
+	if(num_difat_secs>10000) goto done;
+
+	buf = de_malloc(c, sec_size);
+	difat = de_malloc(c, sec_size);
+
+	// The first 109 FAT sector IDs are in the header.
+	for(k=0; k<109 && fat_sec_idx<num_fat_secs; k++) {
+		if(!cfb_scan_fat_sector(f, pos1, endpos, sec_size, fat_sec_idx,
+			dbuf_geti32le(f, pos1+76+4*k), buf, &max_sec_id))
+		{
+			goto done;
+		}
+		fat_sec_idx++;
+	}
+
+	// The rest are in the DIFAT sectors, whose last entry links to the next
+	// DIFAT sector.
+	for(; num_difat_secs>0 && fat_sec_idx<num_fat_secs; num_difat_secs--) {
+		if(difat_sec_id<0) goto done;
+		if(pos1+(difat_sec_id+2)*sec_size > endpos) goto done;
+		if(difat_sec_id > max_sec_id) max_sec_id = difat_sec_id;
+
+		dbuf_read(f, difat, pos1+(difat_sec_id+1)*sec_size, sec_size);
+		for(k=0; k<sec_size/4-1 && fat_sec_idx<num_fat_secs; k++) {
+			if(!cfb_scan_fat_sector(f, pos1, endpos, sec_size, fat_sec_idx,
+				(i64)(i32)de_getu32le_direct(&difat[k*4]), buf, &max_sec_id))
+			{
+				goto done;
+			}
+			fat_sec_idx++;
+		}
+		difat_sec_id = (i64)(i32)de_getu32le_direct(&difat[sec_size-4]);
+	}
+
+	if(fat_sec_idx<num_fat_secs) goto done;
+	if(max_sec_id<0) goto done;
+	if((max_sec_id+2)*sec_size > len) goto done;
+
+	*pcfb_len = (max_sec_id+2)*sec_size;
+	retval = 1;
+
+done:
+	de_free(c, buf);
+	de_free(c, difat);
+	return retval;
+}
+
 // Search for the ZIP "end of central directory" object.
 // Also useful for detecting hybrid ZIP files, such as self-extracting EXE.
 int fmtutil_find_zip_eocd(deark *c, dbuf *f, i64 *foundpos)